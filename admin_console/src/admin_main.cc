@@ -212,6 +212,52 @@ void toggle_component_handler(const HttpRequest &req, HttpResponse &res)
     res.set_header("Location", "/admin/dashboard");
 }
 
+/*
+Handles tablet split requests. Sends SPLT command to the source KVS primary, which migrates the range starting at key to the target's group.
+*/
+void tablet_split_handler(const HttpRequest &req, HttpResponse &res)
+{
+    // Extract form parameters (source server, split key and target server) from the HTTP request body
+    unordered_map<string, string> formParams;
+    vector<string> params = Utils::split(req.body_as_string(), "&");
+    for (const auto &param : params)
+    {
+        size_t equalPos = param.find('=');
+        if (equalPos != string::npos)
+        {
+            formParams[param.substr(0, equalPos)] = param.substr(equalPos + 1);
+        }
+    }
+    string servername = formParams["server"];
+    string split_key = formParams["key"];
+    string targetname = formParams["target"];
+
+    if (kvs_servers.find(servername) == kvs_servers.end() || kvs_servers.find(targetname) == kvs_servers.end() || split_key.size() != 1)
+    {
+        logger.log("Invalid tablet split request - " + servername + " " + split_key + " " + targetname, LOGGER_ERROR);
+    }
+    else
+    {
+        // target is addressed by its group port (admin port - 3000)
+        int port = kvs_servers[servername];
+        string msg = "SPLT " + split_key + " " + to_string(kvs_servers[targetname] - 3000) + "\r\n";
+        int fd = FeUtils::open_socket("127.0.0.1", port);
+        ssize_t bytes_sent = send(fd, msg.c_str(), msg.size(), 0);
+        if (bytes_sent < 0)
+        {
+            logger.log("SPLT command could not be sent to KVS server at port " + to_string(port), LOGGER_ERROR);
+        }
+        else
+        {
+            logger.log("SPLT command sent to " + servername + " at port " + to_string(port), LOGGER_INFO);
+        }
+        close(fd);
+    }
+
+    res.set_code(303); // OK
+    res.set_header("Location", "/admin/dashboard");
+}
+
 void dashboard_handler(const HttpRequest &req, HttpResponse &res)
 {
     logger.log("In dashboard handler", LOGGER_DEBUG);
@@ -327,6 +373,20 @@ void dashboard_handler(const HttpRequest &req, HttpResponse &res)
     page += "</div>";
     page += "</div>";
 
+    // Tablet split form - migrates keys starting at split key from a primary to the target's group
+    string server_options = "";
+    for (const auto &server : kvs_servers)
+    {
+        server_options += "<option value='" + server.first + "'>" + server.first + "</option>";
+    }
+    page += "<div class='mt-4'><h2>Split Tablet</h2>";
+    page += "<form class='row g-2' method='POST' action='/admin/tablet/split'>";
+    page += "<div class='col'><select class='form-select' name='server'>" + server_options + "</select></div>";
+    page += "<div class='col'><input class='form-control' type='text' name='key' maxlength='1' placeholder='Split key'></div>";
+    page += "<div class='col'><select class='form-select' name='target'>" + server_options + "</select></div>";
+    page += "<div class='col'><button class='btn btn-primary' type='submit'>Migrate</button></div>";
+    page += "</form></div>";
+
     // Paginated Table
     page += "<div class='mt-4'><h2>Tablets in Memory</h2>";
     page += "<div class='btn-group d-flex justify-content-center'> <h6 class='align-self-center'>Select Server: \t \t \t</h6>";
@@ -1183,6 +1243,7 @@ int main()
     HttpServer::post("/admin/table/getrows", table_select_kvs_handler);    // handles table requests for a specific kvs server
     HttpServer::post("/admin/table/rowvalues", table_select_row_handler);  // handles table requests to get the row values for a kvs
     HttpServer::post("/admin/table/colvalues", table_select_col_handler);  // handles table requests to get value for given column
+    HttpServer::post("/admin/tablet/split", tablet_split_handler);         // handles tablet split requests for a kvs primary
 
     // @todo add redirect to LB
     HttpServer::get("*", redirect_handler);
@@ -13,7 +13,12 @@
 #include <vector>
 #include <memory>
 #include <queue>
+#include <deque>
+#include <set>
+#include <condition_variable>
+#include <csignal>
 #include "tablet.h"
+#include "op_trace.h"
 #include "kvs_client.h"
 #include "../../utils/include/utils.h"
 #include "../utils/include/be_utils.h"
@@ -28,11 +33,17 @@ public:
     static const int coord_port; // coordinator's port
     static const std::string IP; // IP address
 
+    // tablet resizing thresholds (evaluated by primary at each checkpoint)
+    static const size_t tablet_split_rows;  // tablet is split when it holds more rows than this
+    static const size_t tablet_split_bytes; // tablet is split when it holds more bytes than this
+    static const size_t tablet_merge_rows;  // adjacent tablets are merged when they hold fewer rows than this combined
+    static const size_t tablet_merge_bytes; // adjacent tablets are merged when they hold fewer bytes than this combined
+
     // fields (provided at startup to run server)
     static int client_port; // port server accepts client connections on - provided at startup
     static int group_port;  // port server accepts intergroup communication on (calculated from client port)
     static int admin_port;  // port server accepts admin communication on (calculated from client port)
-    static int num_tablets; // number of static tablets on this server - provided at startup
+    static int num_tablets; // initial number of tablets on this server (tablets are split/merged at checkpoints) - provided at startup
 
     // fields (provided by coordinator)
     static std::string range_start;                 // start of key range managed by this backend server - provided by coordinator
@@ -60,18 +71,76 @@ public:
     static std::mutex group_server_connections_lock;
 
     // remote-write related fields
-    static uint32_t seq_num;        // write operation sequence number (used by both primary to sequence an operation, used by secondary to track operations)
-    static std::mutex seq_num_lock; // lock to save sequence number for use by 2PC
+    static uint32_t seq_num;                    // write operation sequence number (used by both primary to sequence an operation, used by secondary to track operations)
+    static std::mutex seq_num_lock;             // lock to save sequence number for use by 2PC
+    static std::atomic<int> pending_operations; // writes accepted by primary whose END log has not been written yet (checkpointing/migration wait for these to drain)
+    static bool quorum_mode;                    // primary commits once a majority of the group votes yes, instead of waiting for every secondary - provided at startup
+    static size_t group_size;                   // servers configured in this replica group (largest membership reported by coordinator) - quorum majorities are computed over it
+    static const int failover_wait_ms;          // time a server waits for the coordinator to name a new primary before failing a write it couldn't forward
+
+    // forwarded write deduplication fields
+    static const size_t request_history_size;                                     // committed forwarded writes remembered by each server (a write resent after failover is well within it)
+    static std::atomic<uint64_t> next_request_num;                                // number of next write this server forwards to the primary (starts at boot time, so ids aren't reused after a restart)
+    static std::unordered_map<std::string, std::vector<char>> committed_requests; // request id -> response for forwarded writes committed in this group
+    static std::deque<std::string> committed_request_order;                       // request ids in commit order (oldest is forgotten first)
+    static std::mutex committed_requests_lock;                                    // lock for committed requests
+
+    // read fencing fields
+    static const int read_fence_timeout_ms;              // time a server waits to apply a client's min sequence number before redirecting the read to the primary
+    static uint32_t committed_seq_num;                   // every operation up to this sequence number has finished on this server since the last checkpoint
+    static std::set<uint32_t> committed_ahead;           // operations finished past a gap in committed_seq_num (committed position only advances contiguously)
+    static std::mutex committed_seq_num_lock;            // lock for committed sequence number (and last checkpoint, which it is paired with)
+    static std::condition_variable committed_seq_num_cv; // notifies reads waiting for a sequence number to be committed
 
     // checkpointing fields
     static std::atomic<bool> is_checkpointing; // tracks if the server is currently checkpointing (atomic since primary thread can read, but checkpointing thread can write)
     static uint32_t checkpoint_version;        // checkpoint version used by checkpointing thread to update version before initiating checkpoint procedure
     static uint32_t last_checkpoint;           // last version number of checkpoint received during checkpoint
 
+    // tablet migration fields
+    static std::shared_timed_mutex server_tablets_lock;          // read-write lock for server tablets and tablet ranges (tablets are added/removed by migrations)
+    static std::atomic<bool> is_migrating;                       // tracks if the primary is finalizing a migration (atomic since primary threads read it to reject writes)
+    static std::string migration_start;                          // first key of range being migrated off this server (empty if no migration is in progress)
+    static std::string migration_end;                            // last key of range being migrated off this server
+    static std::unordered_set<std::string> migration_dirty_rows; // rows written while the migrating range was being streamed to the target group
+    static std::mutex migration_lock;                            // lock for migration range and dirty rows
+
     // methods
 public:
     static void run();                                                     // run server (server does NOT run on initialization, server instance must explicitly call this method)
-    static std::shared_ptr<Tablet> retrieve_data_tablet(std::string &row); // retrieve tablet containing data for thread to read from
+    static std::shared_ptr<Tablet> retrieve_data_tablet(std::string &row); // retrieve tablet containing data for thread to read from (nullptr if row is not on this server)
+    static bool owns_row(const std::string &row);                          // checks if row falls in the range of a tablet on this server
+
+    // public tablet migration methods
+    static void track_migration_write(std::string &command, std::string &row, std::vector<char> &inputs); // track rows written in the range being migrated
+    static int install_tablet(std::shared_ptr<Tablet> tablet);                                            // add migrated tablet to server and persist it
+    static int drop_tablet_range(const std::string &split_key);                                           // remove range starting at split_key from the tablet containing it
+    static int persist_tablet(std::shared_ptr<Tablet> tablet);                                            // rewrite tablet's checkpoint at the last checkpoint version and clear its log
+
+    // public tablet resizing methods
+    static std::vector<std::string> compute_tablet_layout();                                            // split large tablets and merge small adjacent tablets (used by primary before checkpointing)
+    static std::unordered_set<std::string> apply_tablet_layout(const std::vector<std::string> &layout); // repartition tablets into layout. Returns ranges that no longer exist.
+    static std::vector<char> serialize_tablet_layout(const std::vector<std::string> &layout);           // convert list of ranges into [start][end]... stream
+    static std::vector<std::string> parse_tablet_layout(const std::vector<char> &stream);               // convert [start][end]... stream into list of ranges
+    static int write_tablet_metadata(uint32_t version);                                                 // persist tablet ranges for checkpoint version
+    static int read_tablet_metadata(uint32_t version, std::vector<std::string> &layout);                // read tablet ranges persisted for checkpoint version. Returns -1 if there are none.
+
+    // public read fencing methods
+    static void record_commit(uint32_t operation_seq_num);                         // track operation finished (committed or aborted) on this server and wake reads waiting for it
+    static void restore_committed_seq_num(uint32_t operation_seq_num);             // every operation up to sequence number has been applied (after recovery replays logs)
+    static void reset_committed_seq_num(uint32_t version);                         // reset committed sequence number after checkpoint version is written
+    static std::string committed_position(uint32_t operation_seq_num);             // position of operation returned to clients - CP#:SEQ#
+    static bool wait_for_position(const std::string &min_position, int timeout_ms); // wait until position has been committed on this server. Returns false on timeout.
+    static std::string current_position();                                          // position of the last operation committed on this server - CP#:SEQ# (reported to coordinator with each heartbeat)
+
+    // public failover methods
+    static bool wait_for_new_primary(int failed_port, int timeout_ms); // wait until coordinator names a primary other than failed_port. Returns false on timeout.
+    static void resync_with_primary();                                 // rebuild state from primary after this secondary failed to apply a committed operation
+
+    // public forwarded write deduplication methods
+    static std::string new_request_id();                                                          // id of a write this server forwards to the primary (kept when the write is resent)
+    static void record_request(const std::string &request_id, const std::vector<char> &response); // remember response of a forwarded write committed in this group
+    static bool find_request(const std::string &request_id, std::vector<char> &response);        // look up response of a forwarded write. Returns false if it wasn't committed.
 
     // public group server communication methods
     static std::unordered_map<int, int> open_connection_with_secondary_servers();                       // opens connection with each secondary. Returns list of fds for each connection.
@@ -99,6 +168,11 @@ private:
     static void accept_and_handle_admin_comm(int admin_sock_fd); // open connection with admin port and read messages
     static void admin_kill();                                    // handles kill command from admin console
     static void admin_live();                                    // handles live command from admin console
+    static void admin_split(std::string split_key, int target_port); // migrates range of tablet starting at split_key to primary of another group
+
+    // Tablet migration methods
+    static int send_migration_message(int port, std::vector<char> &msg); // send migration message to server and wait for +OK
+    static void abort_migration(const std::string &split_key, int target_port); // drop partially migrated range on target and resume writes
 
     // Checkpointing methods
     static void dispatch_checkpointing_thread(); // dispatch thread to checkpoint server tablets
@@ -4,6 +4,7 @@
 #include <poll.h>
 #include <string>
 #include <memory>
+#include <functional>
 #include <sys/socket.h> // recv
 #include <unistd.h>     // close
 #include "../utils/include/be_utils.h"
@@ -27,11 +28,15 @@ public:
 
     void read_from_client(); // read data from client
 
+    // read handlers (static, since the primary also serves reads redirected from secondaries)
+    static std::vector<char> getr(std::vector<char> &inputs); // get row from tablet
+    static std::vector<char> getv(std::vector<char> &inputs); // get value from tablet
+    static std::vector<char> getp(std::vector<char> &inputs); // get part of value from tablet
+
 private:
+    static std::vector<char> read_owned_row(std::string &row, const std::function<std::vector<char>(Tablet &)> &read); // read row, unless it isn't managed by this server
     void handle_command(std::vector<char> &client_stream);                     // read first 4 bytes from client stream and call corresponding command handler
     std::vector<char> geta();                                                  // get all rows from all tablets on server
-    std::vector<char> getr(std::vector<char> &inputs);                         // get row from tablet
-    std::vector<char> getv(std::vector<char> &inputs);                         // get value from tablet
     std::vector<char> forward_operation_to_primary(std::vector<char> &inputs); // forward non-read operations received from client to primary
     void send_response(std::vector<char> &response_msg);                       // send response to client
 };
@@ -15,11 +15,12 @@ class KVSGroupServer
 private:
     int group_server_fd;   // fd to communicate with group server
     int group_server_port; // Port that group server is sending data from
+    bool holds_row_lock;   // tracks if this secondary acquired the row lock for the operation it last prepared (PREP and CMMT/ABRT arrive on the same connection)
 
     // methods
 public:
     // group server initialized with an associated file descriptor and group server's port
-    KVSGroupServer(int group_server_fd, int group_server_port) : group_server_fd(group_server_fd), group_server_port(group_server_port){};
+    KVSGroupServer(int group_server_fd, int group_server_port) : group_server_fd(group_server_fd), group_server_port(group_server_port), holds_row_lock(false){};
     // disable default constructor - KVSGroupServer should only be created with an associated fd and port
     KVSGroupServer() = delete;
 
@@ -36,12 +37,19 @@ private:
     // recovery methods
     void assist_with_recovery(std::vector<char> &inputs); // help server with recovery by sending checkpoint + logs
 
+    // tablet migration methods
+    void migrate(std::string &command, std::vector<char> &inputs); // handle MIGR/MIGD/MIGF message sent while a tablet range moves between groups
+
     // 2PC primary coordination methods
-    void execute_two_phase_commit(std::vector<char> &inputs); // coordinates 2PC for client that requested a write operation
+    void execute_two_phase_commit(std::vector<char> &inputs, const std::string &request_id); // coordinates 2PC for client that requested a write operation (request_id is empty if the write wasn't forwarded with one)
     int construct_and_send_prepare(uint32_t operation_seq_num, std::string &command, std::string &row, std::unordered_map<int, int> &secondary_servers);
     bool handle_secondary_votes(uint32_t operation_seq_num, std::unordered_map<int, int> &secondary_servers); // handle vote (secy/secn) from secondary
-    std::vector<char> construct_and_send_commit(uint32_t operation_seq_num, std::string &command, std::string &row, std::vector<char> &inputs, std::unordered_map<int, int> &secondary_servers);
+    bool handle_quorum_votes(uint32_t operation_seq_num, std::unordered_map<int, int> &secondary_servers, std::unordered_map<int, int> &lagging_servers); // handle votes until a majority is reached (quorum mode)
+    static void drain_lagging_servers(uint32_t operation_seq_num, std::unordered_map<int, int> lagging_servers); // read vote and ack from lagging servers and close connections
+    std::vector<char> construct_and_send_commit(uint32_t operation_seq_num, const std::string &request_id, std::string &command, std::string &row, std::vector<char> &inputs, std::unordered_map<int, int> &secondary_servers);
     std::vector<char> construct_and_send_abort(uint32_t operation_seq_num, std::string &row, std::unordered_map<int, int> &secondary_servers);
+    static void add_committed_position(uint32_t operation_seq_num, std::vector<char> &response_msg); // append CP#:SEQ# of committed write to +OK response
+    static void complete_two_phase_commit(uint32_t operation_seq_num, std::string operation_log_filename, std::unordered_map<int, int> secondary_servers); // collect ACKs and write END after client is answered
 
     // 2PC secondary response methods
     void prepare(std::vector<char> &inputs); // handle prepare msg from primary
@@ -63,11 +71,11 @@ private:
     std::vector<char> rnmc(std::string &row, std::vector<char> &inputs);
 
     // 2PC state cleanup
-    void clean_operation_state(std::unordered_map<int, int> secondary_servers); // close connections to all secondaries
+    static void clean_operation_state(std::unordered_map<int, int> secondary_servers); // close connections to all secondaries
 
     // log writing
-    int write_to_log(std::string &log_filename, uint32_t operation_seq_num, const std::string &message);
-    int write_to_log(std::string &log_filename, uint32_t operation_seq_num, const std::vector<char> &message);
+    static int write_to_log(std::string &log_filename, uint32_t operation_seq_num, const std::string &message);
+    static int write_to_log(std::string &log_filename, uint32_t operation_seq_num, const std::vector<char> &message);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,98 @@
+#ifndef OP_TRACE_H
+#define OP_TRACE_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Binary trace of each write operation's trip through 2PC.
+// Every server appends fixed-size records to an mmap'd ring file in its disk directory. Records are written without locks or syscalls
+// (a slot is claimed with a fetch_add on the shared write index), so tracing stays on in production. The trace_report tool merges the
+// files of a replica group offline and reports per-phase latencies and per-operation timelines.
+class OpTrace
+{
+    // fields
+public:
+    // phase of an operation (values are stored in trace files - only ever append to this list)
+    enum Event : uint8_t
+    {
+        CLIENT_RECV = 1,      // server received write from client (recorded by the server the client is connected to)
+        FORWARD = 2,          // write forwarded to primary
+        BEGN = 3,             // primary sequenced the operation and wrote BEGN
+        PREP_SENT = 4,        // primary sent PREP to secondaries
+        VOTES_IN = 5,         // primary finished collecting votes (value = yes votes)
+        DECISION_LOGGED = 6,  // primary wrote CMMT or ABRT to its log (value = 1 on commit)
+        RESPONSE_SENT = 7,    // primary answered the forwarding server
+        ACKS_IN = 8,          // primary collected ACKs from secondaries
+        ENDT = 9,             // primary wrote END
+        CLIENT_RESPONSE = 10, // forwarding server answered the client
+        SECONDARY_VOTED = 11, // secondary logged PREP/ABRT and sent its vote (value = 1 on yes)
+        SECONDARY_ENDT = 12,  // secondary applied the commit and wrote END
+        NUM_EVENTS
+    };
+
+    // one trace record (32 bytes, written in place into the mapped file)
+    struct Record
+    {
+        std::atomic<uint64_t> stamp; // write index + 1, stored last - readers skip slots whose stamp doesn't match their position
+        uint64_t time_ns;            // wall clock time (ns since epoch, so files of servers on the same host line up)
+        uint32_t checkpoint;         // checkpoint version the sequence number belongs to (sequence numbers restart after each checkpoint)
+        uint32_t seq_num;            // operation sequence number (0 if the operation was never sequenced)
+        uint16_t port;               // client port of the server that recorded the event
+        uint8_t event;               // Event
+        uint8_t reserved;            // unused (keeps value aligned)
+        uint32_t value;              // event-specific value
+    };
+
+    // record as read back from a trace file
+    struct Entry
+    {
+        uint64_t time_ns;
+        uint32_t checkpoint;
+        uint32_t seq_num;
+        uint16_t port;
+        uint8_t event;
+        uint32_t value;
+    };
+
+    static const size_t num_records;         // capacity of the ring (older records are overwritten once it wraps)
+    static const std::string file_name;      // name of trace file in a server's disk directory
+    static std::atomic<uint32_t> checkpoint; // checkpoint version stamped on new records
+
+private:
+    // file header (first 64 bytes of a trace file)
+    struct Header
+    {
+        char magic[8];                    // "PCTRACE1"
+        uint32_t record_size;             // sizeof(Record) when the file was written
+        uint32_t port;                    // client port of the server that owns the file
+        uint64_t capacity;                // number of record slots following the header
+        std::atomic<uint64_t> next_index; // index of next record to write (slot is next_index % capacity)
+        char padding[32];
+    };
+
+    static Header *header;  // mapped header (nullptr if tracing is disabled)
+    static Record *records; // mapped record slots
+    static uint16_t port;   // client port stamped on records
+
+    // methods
+public:
+    static int open(const std::string &path, int server_port);                                   // map (creating if needed) the trace file. Returns -1 if the file can't be mapped (tracing stays off).
+    static uint64_t now_ns();                                                                    // current wall clock time in ns
+    static void record(Event event, uint32_t seq_num, uint32_t value = 0, uint64_t time_ns = 0); // append record (time defaults to now)
+
+    // record the client-facing events of a forwarded write once the primary's response (+OK CP#:SEQ#) reveals its sequence number
+    static void record_forwarded(const std::vector<char> &response, uint64_t recv_ns, uint64_t forward_ns);
+
+    static int read_file(const std::string &path, std::vector<Entry> &entries); // read completed records of a trace file in write order. Returns -1 on error.
+    static const char *event_name(uint8_t event);                               // short name of event
+
+private:
+    static void append(Event event, uint32_t record_checkpoint, uint32_t seq_num, uint32_t value, uint64_t time_ns); // write record into next slot
+
+    // make default constructor private
+    OpTrace() {}
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include <string>
 #include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include <shared_mutex>
 #include <fstream>
 #include "../utils/include/be_utils.h"
@@ -45,6 +46,8 @@ public:
     std::vector<char> get_all_rows();                                // read all rows in tablet (rows are separated by delimiter)
     std::vector<char> get_row(std::string &row);                     // read all columns from tablet data (columns are separated by delimiter)
     std::vector<char> get_value(std::string &row, std::string &col); // read value from tablet data
+    // read up to length bytes of value starting at offset. Response is +OK<SP>total_size\bbytes (a length of 0 only returns the size)
+    std::vector<char> get_value_range(std::string &row, std::string &col, size_t offset, size_t length);
 
     /**
      *  WRITE METHODS
@@ -101,6 +104,28 @@ public:
     void deserialize_from_file(const std::string &file_name); // deserialize file_name into this tablet object
     void deserialize_from_stream(std::vector<char> &stream);  // deserialize stream into this tablet object
 
+    /**
+     * MIGRATION METHODS
+     */
+
+    // serialize rows >= split_key into a stream (same format as a checkpoint, headed by the migrated range split_key:range_end)
+    std::vector<char> serialize_range_to_stream(const std::string &split_key);
+    // serialize only the supplied rows into a stream headed by split_key:range_end. Rows that no longer exist are returned in missing_rows
+    std::vector<char> serialize_rows_to_stream(const std::string &split_key, const std::unordered_set<std::string> &rows, std::vector<std::string> &missing_rows);
+    void install_rows_from_stream(std::vector<char> &stream, size_t offset); // replace rows in tablet with the rows in stream (starting at offset)
+    void erase_rows(const std::vector<std::string> &rows);                   // remove rows (and their mutexes) from tablet
+    void truncate_at(const std::string &split_key);                          // drop rows >= split_key and shrink range to end before split_key
+
+    /**
+     * RESIZING METHODS
+     */
+
+    void get_size(size_t &num_rows, size_t &num_bytes); // calculate number of rows and approximate number of bytes stored in tablet
+    std::string find_split_key();                       // first key of upper half of tablet (empty if tablet manages a single character)
+    void lock_all_rows();                               // wait until no reader or writer holds a row lock, and keep new ones out
+    void unlock_all_rows();                             // let readers and writers acquire row locks again
+    void absorb_rows(Tablet &source);                   // move rows that fall in this tablet's range out of source (caller holds lock_all_rows on source)
+
     /**
      * LOG REPLAY METHODS
      */
@@ -121,7 +146,8 @@ public:
     void rnmc(std::string &row, std::vector<char> &inputs);
 
 private:
-    std::vector<char> construct_msg(const std::string &msg, bool error); // construct success/error msg to send back to client
+    std::vector<char> construct_msg(const std::string &msg, bool error);        // construct success/error msg to send back to client
+    void append_row_to_stream(const std::string &row, std::vector<char> &stream); // append serialized row to stream (caller holds shared locks)
 };
 
 #endif
\ No newline at end of file
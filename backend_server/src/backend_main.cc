@@ -4,11 +4,12 @@
 // main expects the following flags:
 // c - sets storage server's client listening port
 // t - sets number of static tablets on this server
-// Example: backend_main -c 6000 -t 5
+// q - commit writes once a majority of the group votes yes (every server in a group should be started with the same mode)
+// Example: backend_main -c 6000 -t 5 [-q]
 int main(int argc, char *argv[])
 {
     int opt;
-    while ((opt = getopt(argc, argv, "c:t:")) != -1)
+    while ((opt = getopt(argc, argv, "c:t:q")) != -1)
     {
         switch (opt)
         {
@@ -36,6 +37,10 @@ int main(int argc, char *argv[])
                 return -1;
             }
             break;
+        case 'q':
+            // enable majority quorum commits
+            BackendServer::quorum_mode = true;
+            break;
         case '?':
             break;
         }
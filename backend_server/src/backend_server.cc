@@ -9,6 +9,12 @@ Logger be_logger = Logger("Backend server");
 const int BackendServer::coord_port = 4999;
 const std::string BackendServer::IP = "127.0.0.1:";
 
+// tablet resizing thresholds - merge thresholds are well below split thresholds so that a merged tablet is not immediately split again
+const size_t BackendServer::tablet_split_rows = 10000;
+const size_t BackendServer::tablet_split_bytes = 64 * 1024 * 1024;
+const size_t BackendServer::tablet_merge_rows = 1000;
+const size_t BackendServer::tablet_merge_bytes = 4 * 1024 * 1024;
+
 // *********************************************
 // STATIC FIELD INITIALIZATION
 // *********************************************
@@ -47,12 +53,38 @@ std::mutex BackendServer::group_server_connections_lock;
 // remote-write related fields
 uint32_t BackendServer::seq_num = 0;
 std::mutex BackendServer::seq_num_lock;
+bool BackendServer::quorum_mode = false;
+size_t BackendServer::group_size = 1;
+std::atomic<int> BackendServer::pending_operations(0);
+const int BackendServer::failover_wait_ms = 5000; // covers the coordinator's default heartbeat timeout
+
+// forwarded write deduplication fields
+const size_t BackendServer::request_history_size = 4096;
+std::atomic<uint64_t> BackendServer::next_request_num(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+std::unordered_map<std::string, std::vector<char>> BackendServer::committed_requests;
+std::deque<std::string> BackendServer::committed_request_order;
+std::mutex BackendServer::committed_requests_lock;
+
+// read fencing fields
+const int BackendServer::read_fence_timeout_ms = 100;
+uint32_t BackendServer::committed_seq_num = 0;
+std::set<uint32_t> BackendServer::committed_ahead;
+std::mutex BackendServer::committed_seq_num_lock;
+std::condition_variable BackendServer::committed_seq_num_cv;
 
 // checkpointing fields
 std::atomic<bool> BackendServer::is_checkpointing(false);
 uint32_t BackendServer::checkpoint_version = 0;
 uint32_t BackendServer::last_checkpoint = 0;
 
+// tablet migration fields
+std::shared_timed_mutex BackendServer::server_tablets_lock;
+std::atomic<bool> BackendServer::is_migrating(false);
+std::string BackendServer::migration_start = "";
+std::string BackendServer::migration_end = "";
+std::unordered_set<std::string> BackendServer::migration_dirty_rows;
+std::mutex BackendServer::migration_lock;
+
 // *********************************************
 // THREAD FN WRAPPER FOR SERVER CONNECTIONS
 // *********************************************
@@ -61,6 +93,7 @@ void *client_thread_adapter(void *obj)
 {
     KVSClient *kvs_client = static_cast<KVSClient *>(obj);
     kvs_client->read_from_client();
+    delete kvs_client;
     return nullptr;
 }
 
@@ -68,6 +101,7 @@ void *group_server_thread_adapter(void *obj)
 {
     KVSGroupServer *kvs_group_server = static_cast<KVSGroupServer *>(obj);
     kvs_group_server->read_from_group_server();
+    delete kvs_group_server;
     return nullptr;
 }
 
@@ -90,6 +124,15 @@ void BackendServer::run()
     // store node local storage directory
     disk_dir = "KVS_" + std::to_string(client_port) + "/";
 
+    // a group member that stops serving (admin kill, resync) closes connections the primary may still write to - handle EPIPE instead of exiting
+    signal(SIGPIPE, SIG_IGN);
+
+    // map operation trace (server runs without tracing if the file can't be mapped)
+    if (OpTrace::open(disk_dir + OpTrace::file_name, client_port) < 0)
+    {
+        be_logger.log("Unable to map operation trace file - tracing disabled", 30);
+    }
+
     // dispatch thread to communicate with coordinator
     if (dispatch_coord_comm_thread() < 0)
         return;
@@ -162,10 +205,10 @@ void BackendServer::accept_and_handle_clients()
             int client_port = ntohs(client_addr.sin_port);
             be_logger.log("Accepted connection from client on port " + std::to_string(client_port), 20);
 
-            // initialize KVSGroupServer object
-            KVSClient kvs_client(client_fd, client_port);
+            // initialize KVSClient object (allocated per connection, since the loop moves on to the next connection before the thread is done with it)
+            KVSClient *kvs_client = new KVSClient(client_fd, client_port);
             pthread_t client_thread;
-            pthread_create(&client_thread, nullptr, client_thread_adapter, &kvs_client);
+            pthread_create(&client_thread, nullptr, client_thread_adapter, kvs_client);
 
             // add thread to map of client connections
             client_connections_lock.lock();
@@ -223,11 +266,13 @@ void BackendServer::handle_coord_comm()
         // send heartbeats as long as the server is alive
         if (!is_dead)
         {
-            std::string ping = "PING";
+            // heartbeat carries this server's progress, so the coordinator can keep the most caught-up secondary ready as standby primary
+            std::string ping = "PING " + current_position();
             BeUtils::write_with_crlf(coord_sock_fd, ping);
 
             // wait for a potential broadcast message
-            if (BeUtils::wait_for_events({coord_sock_fd}, 1000) >= 0)
+            // server may have stopped serving while waiting - leave the coordinator's reply to its RECO for recovery to read
+            if (BeUtils::wait_for_events({coord_sock_fd}, 1000) >= 0 && !is_dead)
             {
                 be_logger.log("Received broadcast from coordinator", 20);
 
@@ -279,6 +324,8 @@ void BackendServer::handle_coord_comm()
                         }
                     }
                     secondary_ports_lock.unlock();
+                    // servers dropped by the coordinator are still part of the group's quorum
+                    group_size = std::max(group_size, new_servers.size());
 
                     // log new information about server
                     is_primary
@@ -364,6 +411,8 @@ int BackendServer::initialize_state_from_coordinator(int coord_sock_fd)
         secondary_ports.insert(std::stoi(secondary_port));
         secondaries += secondary_port + " ";
     }
+    // coordinator lists every server configured in the group when it starts up
+    group_size = res_tokens.size() - 2;
 
     // log information about server
     is_primary
@@ -424,7 +473,9 @@ int BackendServer::initialize_tablets()
         log_file.close();
         be_logger.log("Created log file for tablet " + tablet->range_start + ":" + tablet->range_end, 20);
     }
-    return 0;
+
+    // persist initial layout, so recovery before the first checkpoint rebuilds the same tablets
+    return write_tablet_metadata(last_checkpoint);
 }
 
 // **************************************************
@@ -496,10 +547,10 @@ void BackendServer::accept_and_handle_group_comm(int group_comm_sock_fd)
             int group_server_port = ntohs(group_server_addr.sin_port);
             be_logger.log("Accepted connection from group server on port " + std::to_string(group_server_port), 20);
 
-            // initialize KVSGroupServer object
-            KVSGroupServer kvs_group_server(group_server_fd, group_server_port);
+            // initialize KVSGroupServer object (allocated per connection, since the loop moves on to the next connection before the thread is done with it)
+            KVSGroupServer *kvs_group_server = new KVSGroupServer(group_server_fd, group_server_port);
             pthread_t group_server_thread;
-            pthread_create(&group_server_thread, nullptr, &group_server_thread_adapter, &kvs_group_server);
+            pthread_create(&group_server_thread, nullptr, &group_server_thread_adapter, kvs_group_server);
 
             // add thread to map of group server connections connections
             group_server_connections_lock.lock();
@@ -632,6 +683,21 @@ void BackendServer::accept_and_handle_admin_comm(int admin_sock_fd)
         {
             admin_live();
         }
+        else if (admin_msg_str.substr(0, 4) == "SPLT")
+        {
+            // SPLT<SP>SPLIT_KEY<SP>TARGET_GROUP_PORT - migration runs on its own thread so admin commands are not blocked
+            std::vector<std::string> tokens = Utils::split(admin_msg_str, " ");
+            int target_port = tokens.size() == 3 ? std::atoi(tokens.at(2).c_str()) : 0;
+            if (target_port > 0)
+            {
+                std::thread split_thread(admin_split, tokens.at(1), target_port);
+                split_thread.detach();
+            }
+            else
+            {
+                be_logger.log("Malformed SPLT command from admin", 40);
+            }
+        }
         else
         {
             be_logger.log("Unrecognized command from admin. This should NOT occur", 50);
@@ -663,6 +729,7 @@ void BackendServer::admin_kill()
 
     // clear all state
     server_tablets.clear();           // remove tablets from memory
+    tablet_ranges.clear();            // remove tablet layout from memory (rebuilt from tablet metadata on disk)
     client_connections.clear();       // clear map of active client connections
     group_server_connections.clear(); // clear map of active group server connections
     primary_port = 0;                 // clear current primary
@@ -685,14 +752,31 @@ void BackendServer::admin_live()
     std::string contact_primary(coord_response.byte_stream.begin(), coord_response.byte_stream.end());
     int contact_primary_port = std::stoi(contact_primary.substr(IP.length()));
 
+    // rebuild tablet layout of last checkpoint from disk (tablets may have been split, merged or migrated since startup)
+    // without metadata the layout stays empty, so the primary sends its checkpoint and layout instead
+    std::vector<std::string> checkpoint_layout;
+    if (read_tablet_metadata(last_checkpoint, checkpoint_layout) < 0)
+    {
+        be_logger.log("No tablet metadata for checkpoint " + std::to_string(last_checkpoint) + " - adopting primary's layout", 30);
+    }
+    server_tablets_lock.lock();
+    tablet_ranges = checkpoint_layout;
+    server_tablets_lock.unlock();
+
     // construct message to primary - RECO<SP>CP# SEQ# (no space between CP# and SEQ#)
     std::vector<char> recovery_msg = {'R', 'E', 'C', 'O', ' '};
     std::vector<uint8_t> my_port_num = BeUtils::host_num_to_network_vector(BackendServer::group_port);
     recovery_msg.insert(recovery_msg.end(), my_port_num.begin(), my_port_num.end());
     std::vector<uint8_t> last_cp_num = BeUtils::host_num_to_network_vector(BackendServer::last_checkpoint);
     recovery_msg.insert(recovery_msg.end(), last_cp_num.begin(), last_cp_num.end());
-    std::vector<uint8_t> last_seq_num = BeUtils::host_num_to_network_vector(BackendServer::seq_num);
+    // primary sends every operation after this sequence number - send the committed position, since operations past a gap may be missing
+    committed_seq_num_lock.lock();
+    std::vector<uint8_t> last_seq_num = BeUtils::host_num_to_network_vector(BackendServer::committed_seq_num);
+    committed_seq_num_lock.unlock();
     recovery_msg.insert(recovery_msg.end(), last_seq_num.begin(), last_seq_num.end());
+    // append tablet layout, so primary can send its checkpoint if its tablets were split/merged/migrated while this server was dead
+    std::vector<char> my_layout = serialize_tablet_layout(tablet_ranges);
+    recovery_msg.insert(recovery_msg.end(), my_layout.begin(), my_layout.end());
 
     // Download and clear your logs. This is to ensure that primary can send you requests, and it'll log to your log file
     // The downloaded logs are used if your checkpoint version is the same as the primary's
@@ -734,6 +818,24 @@ void BackendServer::admin_live()
 
     std::vector<char> &stream = primary_recovery_response.byte_stream;
 
+    // next 4 bytes are the size of the primary's tablet layout, followed by the layout
+    uint32_t layout_size = BeUtils::network_vector_to_host_num(stream);
+    stream.erase(stream.begin(), stream.begin() + 4);
+    std::vector<std::string> primary_layout = parse_tablet_layout(std::vector<char>(stream.begin(), stream.begin() + layout_size));
+    stream.erase(stream.begin(), stream.begin() + layout_size);
+    // checkpoint is always included if layouts differ - adopt primary's layout
+    if (cp_included)
+    {
+        server_tablets_lock.lock();
+        tablet_ranges = primary_layout;
+        server_tablets_lock.unlock();
+        for (std::string &tablet_range : tablet_ranges)
+        {
+            std::ofstream log_file(disk_dir + tablet_range + "_log", std::ofstream::app);
+            log_file.close();
+        }
+    }
+
     // across all log replays, take the max sequence number in case you become primary again and have to initiate with that seq num
     seq_num_lock.lock();
     uint32_t max_seq_num_from_replay = seq_num;
@@ -746,8 +848,9 @@ void BackendServer::admin_live()
     {
         be_logger.log("Recovering " + tablet_range + " tablet", 20);
 
-        // initialize a tablet using the default constructor and add it to the vector of live tablets
-        server_tablets.push_back(std::make_shared<Tablet>());
+        // initialize a tablet for this range and add it to the vector of live tablets
+        // (the range is kept if there's no checkpoint to deserialize yet, e.g. when recovering before the first checkpoint)
+        server_tablets.push_back(std::make_shared<Tablet>(tablet_range.substr(0, 1), tablet_range.substr(2, 1)));
         std::shared_ptr<Tablet> tablet = server_tablets.back();
 
         // If the checkpoint was included, then these first 4 bytes are a number, and the next x bytes are the number of corresponding bytes
@@ -797,7 +900,10 @@ void BackendServer::admin_live()
 
     seq_num_lock.lock();
     seq_num = std::max(seq_num, max_seq_num_from_replay);
+    uint32_t recovered_seq_num = seq_num;
     seq_num_lock.unlock();
+    // every operation replayed during recovery has been committed on this server
+    restore_committed_seq_num(recovered_seq_num);
 
     // set flag to false to indicate server is now alive
     is_recovering = false;
@@ -837,6 +943,12 @@ void BackendServer::coordinate_checkpoint()
             is_checkpointing = true; // Set flag to true to reject write requests
             be_logger.log("CP[" + std::to_string(checkpoint_version) + "] Primary initiating checkpointing", 20);
 
+            // wait for in-flight writes to write their END log, so logs aren't cleared underneath them
+            while (pending_operations > 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+
             // open connection with all servers
             be_logger.log("CP[" + std::to_string(checkpoint_version) + "] Opening connection with all servers", 20);
             std::unordered_map<int, int> servers = open_connection_with_secondary_servers();
@@ -853,9 +965,12 @@ void BackendServer::coordinate_checkpoint()
             }
             be_logger.log("CP[" + std::to_string(checkpoint_version) + "] Successfully opened connection with all servers", 20);
 
-            // Send CHECKPOINT to all servers with checkpoint number appended to message
+            // Send CHECKPOINT to all servers with checkpoint number and tablet layout appended to message
+            // tablets are split/merged during checkpointing, since writes are rejected and every tablet is rewritten to disk anyway
             std::vector<char> checkpoint_msg = {'C', 'K', 'P', 'T', ' '};
             checkpoint_msg.insert(checkpoint_msg.end(), version_num_vec.begin(), version_num_vec.end());
+            std::vector<char> layout = serialize_tablet_layout(compute_tablet_layout());
+            checkpoint_msg.insert(checkpoint_msg.end(), layout.begin(), layout.end());
             be_logger.log("CP[" + std::to_string(checkpoint_version) + "] Sending CHECKPOINT to servers", 20);
             send_message_to_servers(checkpoint_msg, servers);
 
@@ -895,16 +1010,673 @@ void BackendServer::coordinate_checkpoint()
 /// @brief Retrieve tablet containing data for thread to read from
 std::shared_ptr<Tablet> BackendServer::retrieve_data_tablet(std::string &row)
 {
+    server_tablets_lock.lock_shared();
     // iterate tablets in reverse order and find first tablet that row is "greater" than
-    for (int i = num_tablets - 1; i >= 0; i--)
+    for (int i = server_tablets.size() - 1; i >= 0; i--)
     {
-        std::string tablet_start = server_tablets.at(i)->range_start;
-        if (row >= tablet_start)
+        std::shared_ptr<Tablet> tablet = server_tablets.at(i);
+        // tablets are not necessarily contiguous after a migration, so the row must also fall before the end of the tablet's range
+        if (row >= tablet->range_start && row.substr(0, 1) <= tablet->range_end)
         {
-            return server_tablets.at(i);
+            server_tablets_lock.unlock_shared();
+            return tablet;
         }
     }
-    // this should never execute
-    be_logger.log("Could not find tablet for given row - this should NOT occur", 50);
+    server_tablets_lock.unlock_shared();
+
+    // row's range isn't on this server (it may have been migrated to another group since the caller checked)
+    be_logger.log("Could not find tablet for R[" + row + "]", 40);
     return nullptr;
-}
\ No newline at end of file
+}
+
+/// @brief Checks if row falls in the range of a tablet on this server
+bool BackendServer::owns_row(const std::string &row)
+{
+    bool owned = false;
+    server_tablets_lock.lock_shared();
+    for (const auto &tablet : server_tablets)
+    {
+        if (row >= tablet->range_start && row.substr(0, 1) <= tablet->range_end)
+        {
+            owned = true;
+            break;
+        }
+    }
+    server_tablets_lock.unlock_shared();
+    return owned;
+}
+
+// **************************************************
+// READ FENCING
+// **************************************************
+
+/// @brief Track operation finished (committed or aborted) on this server and wake reads waiting for it
+void BackendServer::record_commit(uint32_t operation_seq_num)
+{
+    // the primary acks a write once a majority of the group has committed it, so a secondary outside that majority can still be behind the client -
+    // fenced reads (FGTR/FGTV) wait on this position, and are redirected to the primary if this server doesn't catch up in time
+    // operations on different rows finish out of order, so the position only advances past operations once every earlier one has finished here
+    committed_seq_num_lock.lock();
+    if (operation_seq_num > committed_seq_num)
+    {
+        committed_ahead.insert(operation_seq_num);
+        while (!committed_ahead.empty() && *committed_ahead.begin() == committed_seq_num + 1)
+        {
+            committed_seq_num++;
+            committed_ahead.erase(committed_ahead.begin());
+        }
+    }
+    committed_seq_num_lock.unlock();
+    committed_seq_num_cv.notify_all();
+}
+
+/// @brief Set committed sequence number once recovery has replayed every operation up to it
+void BackendServer::restore_committed_seq_num(uint32_t operation_seq_num)
+{
+    committed_seq_num_lock.lock();
+    committed_seq_num = operation_seq_num;
+    committed_ahead.erase(committed_ahead.begin(), committed_ahead.upper_bound(operation_seq_num));
+    while (!committed_ahead.empty() && *committed_ahead.begin() == committed_seq_num + 1)
+    {
+        committed_seq_num++;
+        committed_ahead.erase(committed_ahead.begin());
+    }
+    committed_seq_num_lock.unlock();
+    committed_seq_num_cv.notify_all();
+}
+
+/// @brief Reset committed sequence number once checkpoint version is written (sequence numbers restart after each checkpoint)
+void BackendServer::reset_committed_seq_num(uint32_t version)
+{
+    committed_seq_num_lock.lock();
+    last_checkpoint = version;
+    committed_seq_num = 0;
+    committed_ahead.clear();
+    OpTrace::checkpoint = version;
+    committed_seq_num_lock.unlock();
+    committed_seq_num_cv.notify_all();
+}
+
+/// @brief Position of an operation returned to clients - CP#:SEQ# (sequence numbers are only unique within a checkpoint version)
+std::string BackendServer::committed_position(uint32_t operation_seq_num)
+{
+    committed_seq_num_lock.lock();
+    std::string position = std::to_string(last_checkpoint) + ":" + std::to_string(operation_seq_num);
+    committed_seq_num_lock.unlock();
+    return position;
+}
+
+/// @brief Position of the last operation committed on this server - CP#:SEQ#
+std::string BackendServer::current_position()
+{
+    committed_seq_num_lock.lock();
+    std::string position = std::to_string(last_checkpoint) + ":" + std::to_string(committed_seq_num);
+    committed_seq_num_lock.unlock();
+    return position;
+}
+
+/// @brief Wait until position (CP#:SEQ#) has been committed on this server. Returns false if the position is malformed or the wait timed out.
+bool BackendServer::wait_for_position(const std::string &min_position, int timeout_ms)
+{
+    std::vector<std::string> tokens = Utils::split(min_position, ":");
+    if (tokens.size() != 2 || tokens.at(0).find_first_not_of("0123456789") != std::string::npos || tokens.at(1).find_first_not_of("0123456789") != std::string::npos)
+    {
+        be_logger.log("Malformed read position <" + min_position + ">", 40);
+        return false;
+    }
+    uint32_t min_checkpoint = std::stoul(tokens.at(0));
+    uint32_t min_seq_num = std::stoul(tokens.at(1));
+
+    // position is reached once this server is on a later checkpoint, or on the same checkpoint with a higher sequence number
+    std::unique_lock<std::mutex> lock(committed_seq_num_lock);
+    return committed_seq_num_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [min_checkpoint, min_seq_num]
+                                         { return last_checkpoint > min_checkpoint || (last_checkpoint == min_checkpoint && committed_seq_num >= min_seq_num); });
+}
+
+// **************************************************
+// FAILOVER
+// **************************************************
+
+/// @brief Wait until the coordinator broadcasts a primary other than failed_port (the standby it promotes once the old primary is declared dead)
+bool BackendServer::wait_for_new_primary(int failed_port, int timeout_ms)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (primary_port == failed_port || primary_port == 0)
+    {
+        if (std::chrono::steady_clock::now() >= deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+/// @brief Rebuild state from primary after this secondary failed to apply a committed operation (it missed an earlier operation on the row).
+/// Server stops serving like an admin kill and recovers like an admin restart - recovery sends the committed position,
+/// so the primary replays every operation after the first one this server is missing.
+void BackendServer::resync_with_primary()
+{
+    be_logger.log("Server diverged from primary - restarting to recover missing operations", 50);
+    admin_kill();
+    admin_live();
+}
+
+// **************************************************
+// FORWARDED WRITE DEDUPLICATION
+// **************************************************
+
+/// @brief Id of a write forwarded to the primary - PORT:NUM. The primary sends it to every secondary with the commit, so whichever server
+/// becomes primary after a failover knows if a resent write was already committed.
+std::string BackendServer::new_request_id()
+{
+    return std::to_string(group_port) + ":" + std::to_string(next_request_num++);
+}
+
+/// @brief Remember response of a forwarded write committed in this group (only the most recent request_history_size writes are kept)
+void BackendServer::record_request(const std::string &request_id, const std::vector<char> &response)
+{
+    committed_requests_lock.lock();
+    if (committed_requests.emplace(request_id, response).second)
+    {
+        committed_request_order.push_back(request_id);
+        if (committed_request_order.size() > request_history_size)
+        {
+            committed_requests.erase(committed_request_order.front());
+            committed_request_order.pop_front();
+        }
+    }
+    committed_requests_lock.unlock();
+}
+
+/// @brief Look up response of a forwarded write committed in this group. Returns false if the write wasn't committed (or was forgotten).
+bool BackendServer::find_request(const std::string &request_id, std::vector<char> &response)
+{
+    committed_requests_lock.lock();
+    auto request = committed_requests.find(request_id);
+    bool found = request != committed_requests.end();
+    if (found)
+    {
+        response = request->second;
+    }
+    committed_requests_lock.unlock();
+    return found;
+}
+
+// **************************************************
+// TABLET MIGRATION
+// **************************************************
+
+/// @brief Migrates the range [split_key, end of tablet] to the primary of another group while this server keeps serving requests
+void BackendServer::admin_split(std::string split_key, int target_port)
+{
+    /**
+     * Steps
+     * 1. Stream rows in range to target primary (MIGR) - reads and writes continue, writes to the range are tracked
+     * 2. Reject writes (same as checkpointing) and send rows written during step 1 to target primary (MIGD)
+     * 3. Ask coordinator to flip ownership of the range to the target group
+     * 4. Drop range locally and on secondaries (MIGF) and resume writes
+     */
+    be_logger.log("MG[" + split_key + "] Admin requested migration to " + std::to_string(target_port), 20);
+
+    // only a primary can migrate, and the key must fall in a tablet on this server
+    if (!is_primary || is_dead || split_key.length() != 1 || !owns_row(split_key))
+    {
+        be_logger.log("MG[" + split_key + "] Server is not a live primary for this key. Skipping migration", 40);
+        return;
+    }
+    std::shared_ptr<Tablet> tablet = retrieve_data_tablet(split_key);
+
+    // moving an entire tablet must leave at least one tablet on this server, since the coordinator needs a non-empty range for each group
+    server_tablets_lock.lock_shared();
+    bool last_tablet = split_key == tablet->range_start && server_tablets.size() == 1;
+    server_tablets_lock.unlock_shared();
+    if (last_tablet)
+    {
+        be_logger.log("MG[" + split_key + "] Cannot migrate every key managed by this group. Skipping migration", 40);
+        return;
+    }
+
+    // track range being migrated so writes to it are recorded
+    migration_lock.lock();
+    if (!migration_start.empty())
+    {
+        migration_lock.unlock();
+        be_logger.log("MG[" + split_key + "] Migration already in progress. Skipping migration", 40);
+        return;
+    }
+    migration_start = split_key;
+    migration_end = tablet->range_end;
+    migration_dirty_rows.clear();
+    migration_lock.unlock();
+    std::string range_end = tablet->range_end;
+
+    // 1. stream rows in range to target primary
+    std::vector<char> migrate_msg = {'M', 'I', 'G', 'R', ' '};
+    std::vector<char> range_rows = tablet->serialize_range_to_stream(split_key);
+    migrate_msg.insert(migrate_msg.end(), range_rows.begin(), range_rows.end());
+    be_logger.log("MG[" + split_key + "] Streaming " + split_key + ":" + range_end + " to " + std::to_string(target_port), 20);
+    if (send_migration_message(target_port, migrate_msg) < 0)
+    {
+        abort_migration(split_key, target_port);
+        return;
+    }
+
+    // 2. reject writes and send rows written while the range was being streamed (in-flight writes must finish first, so their rows are tracked)
+    is_migrating = true;
+    while (pending_operations > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    migration_lock.lock();
+    std::unordered_set<std::string> dirty_rows = migration_dirty_rows;
+    migration_lock.unlock();
+
+    // MIGD<SP>[# deleted rows][size of row][row]...[rows in checkpoint format]
+    std::vector<std::string> deleted_rows;
+    std::vector<char> updated_rows = tablet->serialize_rows_to_stream(split_key, dirty_rows, deleted_rows);
+    std::vector<char> delta_msg = {'M', 'I', 'G', 'D', ' '};
+    std::vector<uint8_t> num_deleted = BeUtils::host_num_to_network_vector(deleted_rows.size());
+    delta_msg.insert(delta_msg.end(), num_deleted.begin(), num_deleted.end());
+    for (const std::string &row : deleted_rows)
+    {
+        std::vector<uint8_t> row_size = BeUtils::host_num_to_network_vector(row.length());
+        delta_msg.insert(delta_msg.end(), row_size.begin(), row_size.end());
+        delta_msg.insert(delta_msg.end(), row.begin(), row.end());
+    }
+    delta_msg.insert(delta_msg.end(), updated_rows.begin(), updated_rows.end());
+    be_logger.log("MG[" + split_key + "] Sending " + std::to_string(dirty_rows.size()) + " rows written during migration", 20);
+    if (send_migration_message(target_port, delta_msg) < 0)
+    {
+        abort_migration(split_key, target_port);
+        return;
+    }
+
+    // 3. flip ownership of range in coordinator - MIGR<SP>SOURCE_ADDR<SP>START:END<SP>TARGET_ADDR
+    std::string coord_msg = "MIGR " + IP + std::to_string(group_port) + " " + split_key + ":" + range_end + " " + IP + std::to_string(target_port);
+    int flip_fd = BeUtils::open_connection(coord_port);
+    BeUtils::ReadResult coord_response;
+    coord_response.error_code = -1;
+    if (flip_fd >= 0 && BeUtils::write_with_crlf(flip_fd, coord_msg) >= 0)
+    {
+        coord_response = BeUtils::read_with_crlf(flip_fd);
+    }
+    close(flip_fd);
+    if (coord_response.error_code < 0 || std::string(coord_response.byte_stream.begin(), coord_response.byte_stream.end()).substr(0, 3) != "+OK")
+    {
+        be_logger.log("MG[" + split_key + "] Coordinator rejected ownership change", 40);
+        abort_migration(split_key, target_port);
+        return;
+    }
+
+    // 4. drop range on secondaries and locally
+    std::vector<char> drop_msg = {'M', 'I', 'G', 'F', ' '};
+    drop_msg.insert(drop_msg.end(), split_key.begin(), split_key.end());
+    std::unordered_map<int, int> servers = open_connection_with_secondary_servers();
+    send_message_to_servers(drop_msg, servers);
+    drop_tablet_range(split_key);
+
+    // wait for secondaries to drop the range
+    std::vector<int> dead_servers = wait_for_acks_from_servers(servers);
+    for (int dead_server : dead_servers)
+    {
+        close(servers[dead_server]);
+        servers.erase(dead_server);
+    }
+    for (const auto &server : servers)
+    {
+        BeUtils::read_with_size(server.second); // we don't need to do anything with the ACKs
+        close(server.second);
+    }
+
+    // clear migration state and resume writes
+    migration_lock.lock();
+    migration_start.clear();
+    migration_end.clear();
+    migration_dirty_rows.clear();
+    migration_lock.unlock();
+    is_migrating = false;
+    be_logger.log("MG[" + split_key + "] Migrated " + split_key + ":" + range_end + " to " + std::to_string(target_port), 20);
+}
+
+/// @brief Drop partially migrated range on target and resume writes
+void BackendServer::abort_migration(const std::string &split_key, int target_port)
+{
+    be_logger.log("MG[" + split_key + "] Migration failed - dropping range on " + std::to_string(target_port), 40);
+    std::vector<char> drop_msg = {'M', 'I', 'G', 'F', ' '};
+    drop_msg.insert(drop_msg.end(), split_key.begin(), split_key.end());
+    send_migration_message(target_port, drop_msg);
+
+    migration_lock.lock();
+    migration_start.clear();
+    migration_end.clear();
+    migration_dirty_rows.clear();
+    migration_lock.unlock();
+    is_migrating = false;
+}
+
+/// @brief Send migration message to server and wait for +OK. Returns 0 on success, -1 otherwise.
+int BackendServer::send_migration_message(int port, std::vector<char> &msg)
+{
+    int fd = BeUtils::open_connection(port);
+    if (fd < 0)
+    {
+        be_logger.log("Failed to open connection with " + std::to_string(port) + " for migration", 40);
+        return -1;
+    }
+
+    // target installs the range and replicates it to its secondaries before responding
+    BeUtils::write_with_size(fd, msg);
+    if (BeUtils::wait_for_events({fd}, 30000) < 0)
+    {
+        be_logger.log("Timed out waiting for " + std::to_string(port) + " during migration", 40);
+        close(fd);
+        return -1;
+    }
+    BeUtils::ReadResult response = BeUtils::read_with_size(fd);
+    close(fd);
+    if (response.error_code < 0 || std::string(response.byte_stream.begin(), response.byte_stream.end()).substr(0, 3) != "+OK")
+    {
+        be_logger.log("Server " + std::to_string(port) + " failed to apply migration message", 40);
+        return -1;
+    }
+    return 0;
+}
+
+/// @brief Track rows written in the range being migrated, so they can be resent to the target group
+void BackendServer::track_migration_write(std::string &command, std::string &row, std::vector<char> &inputs)
+{
+    migration_lock.lock();
+    if (!migration_start.empty())
+    {
+        if (row >= migration_start && row.substr(0, 1) <= migration_end)
+        {
+            migration_dirty_rows.insert(row);
+        }
+        // a rename creates the new row, which must also be resent
+        std::string new_row(inputs.begin(), inputs.end());
+        if (command == "rnmr" && new_row >= migration_start && new_row.substr(0, 1) <= migration_end)
+        {
+            migration_dirty_rows.insert(new_row);
+        }
+    }
+    migration_lock.unlock();
+}
+
+/// @brief Add migrated tablet to server, create its log file and persist it as a checkpoint
+int BackendServer::install_tablet(std::shared_ptr<Tablet> tablet)
+{
+    // create log file for tablet
+    std::ofstream log_file(disk_dir + tablet->log_filename);
+    if (!log_file.is_open())
+    {
+        return -1;
+    }
+    log_file.close();
+
+    // insert tablet and range in sorted order - recovery relies on server_tablets and tablet_ranges sharing the same order
+    std::string tablet_range = tablet->range_start + "_" + tablet->range_end;
+    server_tablets_lock.lock();
+    auto tablet_pos = std::find_if(server_tablets.begin(), server_tablets.end(), [&tablet](const std::shared_ptr<Tablet> &curr)
+                                   { return curr->range_start > tablet->range_start; });
+    server_tablets.insert(tablet_pos, tablet);
+    tablet_ranges.insert(std::upper_bound(tablet_ranges.begin(), tablet_ranges.end(), tablet_range), tablet_range);
+    server_tablets_lock.unlock();
+
+    be_logger.log("Installed migrated tablet for range " + tablet->range_start + ":" + tablet->range_end, 20);
+    write_tablet_metadata(last_checkpoint);
+    return persist_tablet(tablet);
+}
+
+/// @brief Remove range starting at split_key from the tablet containing it. The tablet is removed if split_key is its first key.
+int BackendServer::drop_tablet_range(const std::string &split_key)
+{
+    server_tablets_lock.lock();
+    auto tablet_pos = std::find_if(server_tablets.begin(), server_tablets.end(), [&split_key](const std::shared_ptr<Tablet> &curr)
+                                   { return split_key >= curr->range_start && split_key <= curr->range_end; });
+    if (tablet_pos == server_tablets.end())
+    {
+        server_tablets_lock.unlock();
+        be_logger.log("No tablet found for migrated range starting at " + split_key, 40);
+        return -1;
+    }
+    std::shared_ptr<Tablet> tablet = *tablet_pos;
+
+    // files for tablet's range before it's modified
+    std::string old_range = tablet->range_start + "_" + tablet->range_end;
+    std::string old_cp_file = disk_dir + old_range + "_tablet_v" + std::to_string(last_checkpoint);
+    std::string old_log_file = disk_dir + tablet->log_filename;
+
+    auto range_pos = std::find(tablet_ranges.begin(), tablet_ranges.end(), old_range);
+    bool drop_tablet = split_key == tablet->range_start;
+    if (drop_tablet)
+    {
+        server_tablets.erase(tablet_pos);
+        if (range_pos != tablet_ranges.end())
+            tablet_ranges.erase(range_pos);
+    }
+    else
+    {
+        tablet->truncate_at(split_key);
+        if (range_pos != tablet_ranges.end())
+            *range_pos = tablet->range_start + "_" + tablet->range_end;
+    }
+    server_tablets_lock.unlock();
+
+    // remove files for old range - a truncated tablet is persisted under its new range
+    std::remove(old_cp_file.c_str());
+    std::remove(old_log_file.c_str());
+    be_logger.log("Dropped migrated range starting at " + split_key + " from " + old_range, 20);
+    write_tablet_metadata(last_checkpoint);
+    return drop_tablet ? 0 : persist_tablet(tablet);
+}
+
+/// @brief Rewrite tablet's checkpoint at the last checkpoint version and clear its log, so recovery does not replay writes for migrated rows
+int BackendServer::persist_tablet(std::shared_ptr<Tablet> tablet)
+{
+    std::string cp_file = disk_dir + tablet->range_start + "_" + tablet->range_end + "_tablet_v" + std::to_string(last_checkpoint);
+    // serialize appends to the file, so remove the old checkpoint first
+    std::remove(cp_file.c_str());
+    tablet->serialize(cp_file);
+
+    std::ofstream log_file(disk_dir + tablet->log_filename, std::ofstream::trunc);
+    if (!log_file.is_open())
+    {
+        return -1;
+    }
+    log_file.close();
+    return 0;
+}
+
+// **************************************************
+// TABLET RESIZING
+// **************************************************
+
+/// @brief Compute new tablet layout by splitting tablets above the split thresholds and merging adjacent tablets below the merge thresholds
+std::vector<std::string> BackendServer::compute_tablet_layout()
+{
+    std::vector<std::string> layout;
+
+    // layout can't change while a range is being migrated off this server
+    migration_lock.lock();
+    bool migration_in_progress = !migration_start.empty();
+    migration_lock.unlock();
+    server_tablets_lock.lock_shared();
+    if (migration_in_progress)
+    {
+        layout = tablet_ranges;
+        server_tablets_lock.unlock_shared();
+        return layout;
+    }
+
+    // size of last tablet added to layout - only set if that tablet can be merged with the next tablet
+    bool prev_mergeable = false;
+    size_t prev_rows = 0;
+    size_t prev_bytes = 0;
+    for (const auto &tablet : server_tablets)
+    {
+        size_t num_rows;
+        size_t num_bytes;
+        tablet->get_size(num_rows, num_bytes);
+
+        // split tablet in two
+        if (num_rows > tablet_split_rows || num_bytes > tablet_split_bytes)
+        {
+            std::string split_key = tablet->find_split_key();
+            if (!split_key.empty())
+            {
+                be_logger.log("Splitting tablet " + tablet->range_start + ":" + tablet->range_end + " at " + split_key, 20);
+                layout.push_back(tablet->range_start + "_" + std::string(1, split_key[0] - 1));
+                layout.push_back(split_key + "_" + tablet->range_end);
+                prev_mergeable = false;
+                continue;
+            }
+        }
+
+        // merge tablet into previous tablet if ranges are contiguous and the merged tablet is small
+        if (prev_mergeable && layout.back().back() + 1 == tablet->range_start[0] && prev_rows + num_rows < tablet_merge_rows && prev_bytes + num_bytes < tablet_merge_bytes)
+        {
+            be_logger.log("Merging tablet " + tablet->range_start + ":" + tablet->range_end + " into " + layout.back(), 20);
+            layout.back() = layout.back().substr(0, 1) + "_" + tablet->range_end;
+            prev_rows += num_rows;
+            prev_bytes += num_bytes;
+            continue;
+        }
+
+        layout.push_back(tablet->range_start + "_" + tablet->range_end);
+        prev_mergeable = true;
+        prev_rows = num_rows;
+        prev_bytes = num_bytes;
+    }
+    server_tablets_lock.unlock_shared();
+    return layout;
+}
+
+/// @brief Repartition rows into tablets matching layout. Returns ranges from the previous layout that no longer exist.
+std::unordered_set<std::string> BackendServer::apply_tablet_layout(const std::vector<std::string> &layout)
+{
+    std::unordered_set<std::string> stale_ranges;
+    server_tablets_lock.lock_shared();
+    std::vector<std::shared_ptr<Tablet>> old_tablets = server_tablets;
+    bool unchanged = layout.empty() || layout == tablet_ranges;
+    server_tablets_lock.unlock_shared();
+    if (unchanged)
+    {
+        return stale_ranges;
+    }
+
+    // wait for operations holding row locks (e.g. a prepared write waiting for CMMT) to release them BEFORE taking the tablet lock exclusively,
+    // since committing the operation requires a shared tablet lock
+    for (const auto &old_tablet : old_tablets)
+    {
+        old_tablet->lock_all_rows();
+    }
+    server_tablets_lock.lock();
+
+    // create tablet for each range and move rows from old tablets into it
+    std::vector<std::shared_ptr<Tablet>> new_tablets;
+    for (const std::string &range : layout)
+    {
+        std::shared_ptr<Tablet> tablet = std::make_shared<Tablet>(range.substr(0, 1), range.substr(2, 1));
+        for (const auto &old_tablet : old_tablets)
+        {
+            tablet->absorb_rows(*old_tablet);
+        }
+        new_tablets.push_back(tablet);
+
+        // create log file for tablet if its range is new
+        std::ofstream log_file(disk_dir + tablet->log_filename, std::ofstream::app);
+        log_file.close();
+    }
+
+    for (const std::string &range : tablet_ranges)
+    {
+        if (std::find(layout.begin(), layout.end(), range) == layout.end())
+        {
+            stale_ranges.insert(range);
+        }
+    }
+    server_tablets = new_tablets;
+    tablet_ranges = layout;
+    server_tablets_lock.unlock();
+    for (const auto &old_tablet : old_tablets)
+    {
+        old_tablet->unlock_all_rows();
+    }
+
+    be_logger.log("Repartitioned server into " + std::to_string(layout.size()) + " tablets", 20);
+    return stale_ranges;
+}
+
+/// @brief Convert list of ranges (start_end) into a stream of [start][end] pairs
+std::vector<char> BackendServer::serialize_tablet_layout(const std::vector<std::string> &layout)
+{
+    std::vector<char> stream;
+    for (const std::string &range : layout)
+    {
+        stream.push_back(range.front());
+        stream.push_back(range.back());
+    }
+    return stream;
+}
+
+/// @brief Convert stream of [start][end] pairs into list of ranges (start_end)
+std::vector<std::string> BackendServer::parse_tablet_layout(const std::vector<char> &stream)
+{
+    std::vector<std::string> layout;
+    for (size_t i = 0; i + 1 < stream.size(); i += 2)
+    {
+        layout.push_back(std::string(1, stream.at(i)) + "_" + std::string(1, stream.at(i + 1)));
+    }
+    return layout;
+}
+
+/// @brief Write tablet ranges (one per line) to tablets_v# and remove metadata for other versions
+int BackendServer::write_tablet_metadata(uint32_t version)
+{
+    std::string metadata_file = disk_dir + "tablets_v" + std::to_string(version);
+    std::ofstream metadata(metadata_file, std::ofstream::trunc);
+    if (!metadata.is_open())
+    {
+        be_logger.log("Failed to write tablet metadata " + metadata_file, 40);
+        return -1;
+    }
+    server_tablets_lock.lock_shared();
+    for (const std::string &range : tablet_ranges)
+    {
+        metadata << range << "\n";
+    }
+    server_tablets_lock.unlock_shared();
+    metadata.close();
+
+    // metadata for previous checkpoint is no longer needed
+    if (version != last_checkpoint)
+    {
+        std::string old_metadata_file = disk_dir + "tablets_v" + std::to_string(last_checkpoint);
+        std::remove(old_metadata_file.c_str());
+    }
+    return 0;
+}
+
+/// @brief Read tablet ranges written to tablets_v# by write_tablet_metadata. Returns -1 if the file is missing or holds no ranges.
+int BackendServer::read_tablet_metadata(uint32_t version, std::vector<std::string> &layout)
+{
+    std::ifstream metadata(disk_dir + "tablets_v" + std::to_string(version));
+    if (!metadata.is_open())
+    {
+        return -1;
+    }
+
+    // one range (start_end) per line
+    layout.clear();
+    std::string range;
+    while (std::getline(metadata, range))
+    {
+        if (range.length() == 3 && range[1] == '_')
+        {
+            layout.push_back(range);
+        }
+    }
+    metadata.close();
+    return layout.empty() ? -1 : 0;
+}
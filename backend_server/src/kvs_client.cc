@@ -72,13 +72,49 @@ void KVSClient::read_from_client()
 // @brief Parse client command. If read operation, call corresponding handler. Otherwise, forward to primary.
 void KVSClient::handle_command(std::vector<char> &client_stream)
 {
+    uint64_t recv_ns = OpTrace::now_ns();
+
     // extract command from first 4 bytes and convert command to lowercase
     std::string command(client_stream.begin(), client_stream.begin() + 4);
     command = Utils::to_lowercase(command);
 
+    // fenced reads (FGTR/FGTV) carry the position of the client's last write - FGTR<SP>CP#:SEQ#\bROW, FGTV<SP>CP#:SEQ#\bROW\bCOL
+    // strip the position and handle the remainder as a regular GETR/GETV
+    std::string min_position;
+    if ((command == "fgtr" || command == "fgtv") && client_stream.size() > 5)
+    {
+        auto position_end = std::find(client_stream.begin() + 5, client_stream.end(), '\b');
+        min_position = std::string(client_stream.begin() + 5, position_end);
+        client_stream.erase(client_stream.begin() + 5, position_end == client_stream.end() ? position_end : position_end + 1);
+        command = command == "fgtr" ? "getr" : "getv";
+        std::string regular_command = Utils::to_uppercase(command);
+        std::copy(regular_command.begin(), regular_command.end(), client_stream.begin());
+    }
+
+    // reject rows outside this server's tablets (range may have been migrated to another group since the client looked it up)
+    if (command != "geta" && client_stream.size() > 5)
+    {
+        auto row_end = std::find(client_stream.begin() + 5, client_stream.end(), '\b');
+        std::string row(client_stream.begin() + 5, row_end);
+        if (!BackendServer::owns_row(row))
+        {
+            std::string err_msg = "-ER Row not managed by this server";
+            kvs_client_logger.log(err_msg + " R[" + row + "]", 40);
+            std::vector<char> res_bytes(err_msg.begin(), err_msg.end());
+            send_response(res_bytes);
+            return;
+        }
+    }
+
     // READ commands - server can handle these commands directly without forwarding the operation to the primary
     std::vector<char> res_msg;
-    if (command == "getr")
+    // secondary hasn't committed the client's last write yet - wait briefly, then redirect the read to the primary
+    if (!min_position.empty() && !BackendServer::is_primary && !BackendServer::wait_for_position(min_position, BackendServer::read_fence_timeout_ms))
+    {
+        LOGGER_LOG(kvs_client_logger, 20, "Position " + min_position + " not committed - redirecting " + command + " to primary");
+        res_msg = forward_operation_to_primary(client_stream);
+    }
+    else if (command == "getr")
     {
         res_msg = getr(client_stream);
     }
@@ -86,6 +122,10 @@ void KVSClient::handle_command(std::vector<char> &client_stream)
     {
         res_msg = getv(client_stream);
     }
+    else if (command == "getp")
+    {
+        res_msg = getp(client_stream);
+    }
     else if (command == "geta")
     {
         res_msg = geta();
@@ -94,8 +134,15 @@ void KVSClient::handle_command(std::vector<char> &client_stream)
     else
     {
         // forward operation to primary and wait for primary's response
-        kvs_client_logger.log("Received " + command + " from client - forwarding operation to primary", 20);
+        LOGGER_LOG(kvs_client_logger, 20, "Received " + command + " from client - forwarding operation to primary");
+        uint64_t forward_ns = OpTrace::now_ns();
+        // tag write with an id (RQID<SP>ID\bWRITE), so if it's resent after a failover, the new primary can tell if the group already committed it
+        std::string request_tag = "RQID " + BackendServer::new_request_id() + "\b";
+        client_stream.insert(client_stream.begin(), request_tag.begin(), request_tag.end());
         res_msg = forward_operation_to_primary(client_stream);
+        send_response(res_msg);
+        OpTrace::record_forwarded(res_msg, recv_ns, forward_ns);
+        return;
     }
 
     // send response back to client that initiated request
@@ -115,12 +162,14 @@ std::vector<char> KVSClient::geta()
 
     // read all rows from all tablets
     std::vector<char> response_msg;
+    BackendServer::server_tablets_lock.lock_shared();
     for (const auto &tablet : BackendServer::server_tablets)
     {
         std::vector<char> rows = tablet->get_all_rows();
         response_msg.insert(response_msg.end(), rows.begin(), rows.end());
         response_msg.push_back('\b');
     }
+    BackendServer::server_tablets_lock.unlock_shared();
     // remove last added delimiter
     response_msg.pop_back();
 
@@ -141,12 +190,11 @@ std::vector<char> KVSClient::getr(std::vector<char> &inputs)
     // extract row as string from inputs
     std::string row(inputs.begin(), inputs.end());
     // log command and args
-    kvs_client_logger.log("GETR R[" + row + "]", 20);
+    LOGGER_LOG(kvs_client_logger, 20, "GETR R[" + row + "]");
 
     // retrieve tablet and read row
-    std::shared_ptr<Tablet> tablet = BackendServer::retrieve_data_tablet(row);
-    std::vector<char> response_msg = tablet->get_row(row);
-    return response_msg;
+    return read_owned_row(row, [&row](Tablet &tablet)
+                          { return tablet.get_row(row); });
 }
 
 // @brief Get value from tablet
@@ -172,55 +220,152 @@ std::vector<char> KVSClient::getv(std::vector<char> &inputs)
     std::string col = getv_args.substr(col_index + 1);
 
     // log command and args
-    kvs_client_logger.log("GETV R[" + row + "] C[" + col + "]", 20);
+    LOGGER_LOG(kvs_client_logger, 20, "GETV R[" + row + "] C[" + col + "]");
 
     // retrieve tablet and read value from row and col combination
-    std::shared_ptr<Tablet> tablet = BackendServer::retrieve_data_tablet(row);
-    std::vector<char> response_msg = tablet->get_value(row, col);
-    return response_msg;
+    return read_owned_row(row, [&row, &col](Tablet &tablet)
+                          { return tablet.get_value(row, col); });
 }
 
-/**
- * INTER-GROUP COMMUNICATION METHODS
- */
-
-// @brief Forward write operation to primary server
-std::vector<char> KVSClient::forward_operation_to_primary(std::vector<char> &inputs)
+// @brief Get part of value from tablet - GETP<SP>ROW\bCOL\bOFFSET\bLENGTH
+std::vector<char> KVSClient::getp(std::vector<char> &inputs)
 {
-    // open connection with primary port (intergroup communcation port)
-    int primary_fd = BeUtils::open_connection(BackendServer::primary_port);
-    // failed to open connection with primary - send error response back to client
-    if (primary_fd < 0)
+    // erase command from beginning of inputs
+    inputs.erase(inputs.begin(), inputs.begin() + 5);
+
+    // row, column, offset and length are all string-compatible values separated by delimiter
+    std::string getp_args(inputs.begin(), inputs.end());
+    std::vector<std::string> args;
+    size_t arg_start = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        size_t arg_end = getp_args.find('\b', arg_start);
+        if (arg_end == std::string::npos)
+        {
+            break;
+        }
+        args.push_back(getp_args.substr(arg_start, arg_end - arg_start));
+        arg_start = arg_end + 1;
+    }
+    args.push_back(getp_args.substr(arg_start));
+
+    size_t offset = 0;
+    size_t length = 0;
+    bool valid_range = args.size() == 4;
+    try
+    {
+        offset = valid_range ? std::stoul(args.at(2)) : 0;
+        length = valid_range ? std::stoul(args.at(3)) : 0;
+    }
+    catch (const std::exception &e)
+    {
+        valid_range = false;
+    }
+    if (!valid_range)
     {
-        std::string err_msg = "-ER Failed to forward write to primary";
+        // log and send error message
+        std::string err_msg = "-ER Malformed arguments to GETP(R,C,OFFSET,LENGTH)";
         kvs_client_logger.log(err_msg, 40);
         std::vector<char> res_bytes(err_msg.begin(), err_msg.end());
         return res_bytes;
     }
+    std::string &row = args.at(0);
+    std::string &col = args.at(1);
 
-    // write message to primary
-    BeUtils::write_with_size(primary_fd, inputs);
+    // log command and args
+    LOGGER_LOG(kvs_client_logger, 20, "GETP R[" + row + "] C[" + col + "] OFFSET[" + args.at(2) + "] LENGTH[" + args.at(3) + "]");
+
+    // retrieve tablet and read part of value from row and col combination
+    return read_owned_row(row, [&row, &col, offset, length](Tablet &tablet)
+                          { return tablet.get_value_range(row, col, offset, length); });
+}
 
-    // wait for primary to respond
-    kvs_client_logger.log("Waiting for response from primary", 20);
-    std::vector<int> read_fds = {primary_fd};
-    if (BeUtils::wait_for_events(read_fds, 30000) < 0)
+// @brief Read row from the tablet managing it. The row's range may be migrated away between the ownership check in handle_command and
+// the read (the tablet is dropped or truncated), so the read only counts if the row is still in the same tablet afterwards.
+std::vector<char> KVSClient::read_owned_row(std::string &row, const std::function<std::vector<char>(Tablet &)> &read)
+{
+    std::shared_ptr<Tablet> tablet = BackendServer::retrieve_data_tablet(row);
+    if (tablet != nullptr)
     {
-        std::string err_msg = "-ER Timed out waiting for response from primary";
-        kvs_client_logger.log(err_msg, 40);
-        std::vector<char> res_bytes(err_msg.begin(), err_msg.end());
-        return res_bytes;
+        std::vector<char> response_msg = read(*tablet);
+        if (BackendServer::retrieve_data_tablet(row) == tablet)
+        {
+            return response_msg;
+        }
     }
-    kvs_client_logger.log("Received response from primary - sending response to client", 20);
-    BeUtils::ReadResult primary_res = BeUtils::read_with_size(primary_fd);
-    if (primary_res.error_code < 0)
+
+    std::string err_msg = "-ER Row not managed by this server";
+    kvs_client_logger.log(err_msg + " R[" + row + "]", 40);
+    return std::vector<char>(err_msg.begin(), err_msg.end());
+}
+
+/**
+ * INTER-GROUP COMMUNICATION METHODS
+ */
+
+// @brief Forward write operation to primary server. If the primary can't be reached or dies before answering, the operation is forwarded to
+// the primary the coordinator promotes instead (writes keep their request id, so a write the old primary committed just before dying is
+// answered with its original response rather than applied again).
+std::vector<char> KVSClient::forward_operation_to_primary(std::vector<char> &inputs)
+{
+    std::string err_msg;
+    while (true)
     {
-        std::string err_msg = "-ER Failed to read response from primary";
+        // open connection with primary port (intergroup communcation port)
+        int primary_port = BackendServer::primary_port;
+        int primary_fd = BeUtils::open_connection(primary_port);
+        // failed to open connection with primary or to write message to primary - nothing reached the primary
+        if (primary_fd < 0 || BeUtils::write_with_size(primary_fd, inputs) < 0)
+        {
+            err_msg = "-ER Failed to forward write to primary";
+        }
+        else
+        {
+            // wait for primary to respond, checking between waits whether the coordinator replaced it (e.g. it hung and was declared dead)
+            kvs_client_logger.log("Waiting for response from primary", 20);
+            std::vector<int> read_fds = {primary_fd};
+            int waited_ms = 0;
+            while (BackendServer::primary_port == primary_port && waited_ms < 30000 && BeUtils::wait_for_events(read_fds, 100) < 0)
+            {
+                waited_ms += 100;
+            }
+            if (BackendServer::primary_port != primary_port)
+            {
+                err_msg = "-ER Primary replaced while waiting for response";
+            }
+            else if (waited_ms >= 30000)
+            {
+                // primary is alive but slow - don't resend the operation
+                close(primary_fd);
+                err_msg = "-ER Timed out waiting for response from primary";
+                kvs_client_logger.log(err_msg, 40);
+                return std::vector<char>(err_msg.begin(), err_msg.end());
+            }
+            else
+            {
+                kvs_client_logger.log("Received response from primary - sending response to client", 20);
+                BeUtils::ReadResult primary_res = BeUtils::read_with_size(primary_fd);
+                if (primary_res.error_code == 0)
+                {
+                    close(primary_fd);
+                    return primary_res.byte_stream;
+                }
+                err_msg = "-ER Failed to read response from primary";
+            }
+        }
+        if (primary_fd >= 0)
+        {
+            close(primary_fd);
+        }
         kvs_client_logger.log(err_msg, 40);
-        std::vector<char> res_bytes(err_msg.begin(), err_msg.end());
-        return res_bytes;
+
+        // primary is likely dead - hold the write until the coordinator promotes the standby
+        if (!BackendServer::wait_for_new_primary(primary_port, BackendServer::failover_wait_ms))
+        {
+            return std::vector<char>(err_msg.begin(), err_msg.end());
+        }
+        kvs_client_logger.log("Primary moved to " + std::to_string(BackendServer::primary_port) + " - forwarding write to new primary", 30);
     }
-    return primary_res.byte_stream;
 }
 
 /**
@@ -233,5 +378,5 @@ void KVSClient::send_response(std::vector<char> &response_msg)
     {
         kvs_client_logger.log("Failed to send response to client on port " + std::to_string(client_port), 20);
     }
-    kvs_client_logger.log("Response sent to client on port " + std::to_string(client_port), 20);
+    LOGGER_LOG(kvs_client_logger, 20, "Response sent to client on port " + std::to_string(client_port));
 }
\ No newline at end of file
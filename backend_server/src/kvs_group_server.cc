@@ -96,27 +96,76 @@ void KVSGroupServer::handle_command(std::vector<char> &byte_stream)
         return;
     }
 
+    // tablet migration commands
+    if (command == "migr" || command == "migd" || command == "migf")
+    {
+        migrate(command, byte_stream);
+        return;
+    }
+
     // write commands
 
     // primary server
     if (BackendServer::is_primary)
     {
+        // reads redirected by a secondary that hasn't committed the client's min sequence number yet
+        if (command == "getr" || command == "getv")
+        {
+            std::vector<char> response_msg = command == "getr" ? KVSClient::getr(byte_stream) : KVSClient::getv(byte_stream);
+            send_response(response_msg);
+            return;
+        }
+
+        // writes forwarded from a server carry the id it assigned to the write - RQID<SP>ID\bWRITE. Strip the id and handle the remainder as the write
+        std::string request_id;
+        if (command == "rqid" && byte_stream.size() > 5)
+        {
+            auto request_id_end = std::find(byte_stream.begin() + 5, byte_stream.end(), '\b');
+            request_id = std::string(byte_stream.begin() + 5, request_id_end);
+            byte_stream.erase(byte_stream.begin(), request_id_end == byte_stream.end() ? request_id_end : request_id_end + 1);
+            command = byte_stream.size() < 4 ? "" : Utils::to_lowercase(std::string(byte_stream.begin(), byte_stream.begin() + 4));
+
+            // write was resent after a failover, but the group committed it before the old primary could answer - don't apply it twice
+            std::vector<char> response_msg;
+            if (BackendServer::find_request(request_id, response_msg))
+            {
+                kvs_group_server_logger.log("Write " + request_id + " was already committed - sending its original response", 30);
+                send_response(response_msg);
+                return;
+            }
+        }
+
+        // Track write as in flight BEFORE checking flags, so checkpointing/migration can wait for in-flight writes to complete after setting their flag
+        BackendServer::pending_operations++;
+
         // Reject writes if primary is currently checkpointing
         if (BackendServer::is_checkpointing)
         {
             // log and send error message
+            BackendServer::pending_operations--;
             send_error_response("Unable to accept write request - server currently checkpointing");
             return;
         }
 
+        // Reject writes while primary is finalizing a tablet migration
+        if (BackendServer::is_migrating)
+        {
+            // log and send error message
+            BackendServer::pending_operations--;
+            send_error_response("Unable to accept write request - server currently migrating tablet");
+            return;
+        }
+
         // write operation forwarded from a server
         if (command == "putv" || command == "cput" || command == "delr" || command == "delv" || command == "rnmr" || command == "rnmc")
         {
-            execute_two_phase_commit(byte_stream);
+            // operation is no longer pending once its END log is written
+            execute_two_phase_commit(byte_stream, request_id);
         }
         else
         {
             // log and send error message
+            BackendServer::pending_operations--;
             send_error_response("Unrecognized command <" + command + "> - this should NOT occur");
             return;
         }
@@ -154,7 +203,11 @@ void KVSGroupServer::checkpoint(std::vector<char> &inputs)
 
     kvs_group_server_logger.log("CP[" + std::to_string(version_num) + "] Server beginning checkpointing", 20);
 
+    // remainder of inputs is the tablet layout chosen by the primary - repartition tablets before they're written to disk
+    std::unordered_set<std::string> stale_ranges = BackendServer::apply_tablet_layout(BackendServer::parse_tablet_layout(inputs));
+
     // Checkpoint all tablets on server
+    BackendServer::server_tablets_lock.lock_shared();
     for (const auto &tablet : BackendServer::server_tablets)
     {
         // file name of tablet - start_end_tablet_v# (# is operation_seq_num)
@@ -167,7 +220,9 @@ void KVSGroupServer::checkpoint(std::vector<char> &inputs)
         log_file.open(log_filename);
         bool log_is_empty = log_file.peek() == std::ifstream::traits_type::eof();
         log_file.close();
-        if (log_is_empty && BackendServer::last_checkpoint != 0)
+        // tablets created by a split/merge have no previous checkpoint file, so they must always be serialized
+        bool is_new_tablet = !stale_ranges.empty() && std::ifstream(old_cp_file).fail();
+        if (log_is_empty && BackendServer::last_checkpoint != 0 && !is_new_tablet)
         {
             kvs_group_server_logger.log("CP[" + std::to_string(version_num) + "] No updates since last checkpoint for " + tablet->range_start + ":" + tablet->range_end + ". Skipping", 20);
             std::rename(old_cp_file.c_str(), new_cp_file.c_str());
@@ -187,9 +242,21 @@ void KVSGroupServer::checkpoint(std::vector<char> &inputs)
             kvs_group_server_logger.log("CP[" + std::to_string(version_num) + "] Cleared " + log_filename, 20);
         }
     }
+    BackendServer::server_tablets_lock.unlock_shared();
 
-    // update version number of last checkpoint on this server
-    BackendServer::last_checkpoint = version_num;
+    // remove checkpoint and log files for ranges that were split/merged away
+    for (const std::string &range : stale_ranges)
+    {
+        std::string stale_cp_file = BackendServer::disk_dir + range + "_tablet_v" + std::to_string(BackendServer::last_checkpoint);
+        std::string stale_log_file = BackendServer::disk_dir + range + "_log";
+        std::remove(stale_cp_file.c_str());
+        std::remove(stale_log_file.c_str());
+        kvs_group_server_logger.log("CP[" + std::to_string(version_num) + "] Removed files for stale tablet " + range, 20);
+    }
+    BackendServer::write_tablet_metadata(version_num);
+
+    // update version number of last checkpoint on this server (committed sequence number restarts with the new version)
+    BackendServer::reset_committed_seq_num(version_num);
     // reset the sequence number, since all data is now saved
     BackendServer::seq_num_lock.lock();
     BackendServer::seq_num = 0;
@@ -235,12 +302,18 @@ void KVSGroupServer::assist_with_recovery(std::vector<char> &inputs)
     // extract sequence number and erase from inputs
     uint32_t sent_seq_num = BeUtils::network_vector_to_host_num(inputs);
     inputs.erase(inputs.begin(), inputs.begin() + 4);
+    // remainder of inputs is the recovering server's tablet layout
+    std::vector<std::string> sent_layout = BackendServer::parse_tablet_layout(inputs);
 
     // check if the requesting server requires your checkpoint files
     std::vector<char> response;
     bool checkpoint_required;
-    // last checkpoint comparison
-    if (BackendServer::last_checkpoint != sent_checkpoint_version)
+    // last checkpoint comparison - checkpoint is also required if tablets were split/merged/migrated since the server died
+    BackendServer::server_tablets_lock.lock_shared();
+    std::vector<char> layout = BackendServer::serialize_tablet_layout(BackendServer::tablet_ranges);
+    bool layout_changed = sent_layout != BackendServer::tablet_ranges;
+    BackendServer::server_tablets_lock.unlock_shared();
+    if (BackendServer::last_checkpoint != sent_checkpoint_version || layout_changed)
     {
         response.push_back('C');
         checkpoint_required = true;
@@ -251,7 +324,13 @@ void KVSGroupServer::assist_with_recovery(std::vector<char> &inputs)
         checkpoint_required = false;
     }
 
+    // append size of tablet layout and tablet layout, so recovering server builds the same tablets
+    std::vector<uint8_t> layout_size_vec = BeUtils::host_num_to_network_vector(layout.size());
+    response.insert(response.end(), layout_size_vec.begin(), layout_size_vec.end());
+    response.insert(response.end(), layout.begin(), layout.end());
+
     // iterate tablet range and add checkpoint file (if necessary) and log file
+    BackendServer::server_tablets_lock.lock_shared();
     for (std::string tablet_range : BackendServer::tablet_ranges)
     {
         // read entire log file into a vector and append to response
@@ -353,6 +432,7 @@ void KVSGroupServer::assist_with_recovery(std::vector<char> &inputs)
         // append the log_file_data vector to the end of response
         response.insert(response.end(), log_file_data.begin(), log_file_data.end());
     }
+    BackendServer::server_tablets_lock.unlock_shared();
 
     kvs_group_server_logger.log("Adding " + std::to_string(recovering_port_num) + " to recovering server list", 20);
     // track recovering server so it can receive update operations
@@ -364,22 +444,105 @@ void KVSGroupServer::assist_with_recovery(std::vector<char> &inputs)
     send_response(response);
 }
 
+// *********************************************
+// TABLET MIGRATION
+// *********************************************
+
+/// @brief Apply tablet migration message from the primary of another group (or from this group's primary)
+void KVSGroupServer::migrate(std::string &command, std::vector<char> &inputs)
+{
+    // primary replicates migration message to its secondaries, so every server in the group owns the same tablets
+    std::unordered_map<int, int> secondary_servers;
+    if (BackendServer::is_primary)
+    {
+        secondary_servers = BackendServer::open_connection_with_secondary_servers();
+        BackendServer::send_message_to_servers(inputs, secondary_servers);
+    }
+
+    // erase command from beginning of inputs
+    inputs.erase(inputs.begin(), inputs.begin() + 5);
+
+    int status = 0;
+    // MIGR<SP>[tablet stream] - build tablet for migrated range and add it to this server
+    if (command == "migr")
+    {
+        kvs_group_server_logger.log("Installing migrated tablet", 20);
+        std::shared_ptr<Tablet> tablet = std::make_shared<Tablet>();
+        tablet->deserialize_from_stream(inputs);
+        status = BackendServer::install_tablet(tablet);
+    }
+    // MIGD<SP>[# deleted rows][size of row][row]...[tablet stream] - apply rows written while migrated range was streamed
+    else if (command == "migd")
+    {
+        uint32_t num_deleted = BeUtils::network_vector_to_host_num(inputs);
+        inputs.erase(inputs.begin(), inputs.begin() + 4);
+        std::vector<std::string> deleted_rows;
+        for (uint32_t i = 0; i < num_deleted; i++)
+        {
+            uint32_t row_size = BeUtils::network_vector_to_host_num(inputs);
+            inputs.erase(inputs.begin(), inputs.begin() + 4);
+            deleted_rows.push_back(std::string(inputs.begin(), inputs.begin() + row_size));
+            inputs.erase(inputs.begin(), inputs.begin() + row_size);
+        }
+
+        // remainder of inputs is headed by the migrated range
+        std::string range_start(inputs.begin(), inputs.begin() + 1);
+        kvs_group_server_logger.log("Applying " + std::to_string(num_deleted) + " deleted rows to migrated tablet " + range_start, 20);
+        std::shared_ptr<Tablet> tablet = BackendServer::retrieve_data_tablet(range_start);
+        if (tablet == nullptr)
+        {
+            status = -1;
+        }
+        else
+        {
+            tablet->erase_rows(deleted_rows);
+            tablet->install_rows_from_stream(inputs, 2);
+            status = BackendServer::persist_tablet(tablet);
+        }
+    }
+    // MIGF<SP>SPLIT_KEY - drop migrated range from this server
+    else if (command == "migf")
+    {
+        std::string split_key(inputs.begin(), inputs.end());
+        kvs_group_server_logger.log("Dropping migrated range starting at " + split_key, 20);
+        status = BackendServer::drop_tablet_range(split_key);
+    }
+
+    // wait for secondaries to apply migration message
+    if (BackendServer::is_primary)
+    {
+        std::vector<int> dead_servers = BackendServer::wait_for_acks_from_servers(secondary_servers);
+        for (int dead_server : dead_servers)
+        {
+            close(secondary_servers[dead_server]);
+            secondary_servers.erase(dead_server);
+        }
+        for (const auto &server : secondary_servers)
+        {
+            BeUtils::read_with_size(server.second); // we don't need to do anything with the ACKs
+        }
+        clean_operation_state(secondary_servers);
+    }
+
+    if (status < 0)
+    {
+        send_error_response("Failed to apply " + command + " migration message");
+        return;
+    }
+    std::string ok_msg = "+OK";
+    std::vector<char> response_msg(ok_msg.begin(), ok_msg.end());
+    send_response(response_msg);
+}
+
 // *********************************************
 // 2PC PRIMARY COORDINATION METHODS
 // *********************************************
 
 /// @brief Coordinates 2PC for client that requested a write operation
-void KVSGroupServer::execute_two_phase_commit(std::vector<char> &inputs)
+void KVSGroupServer::execute_two_phase_commit(std::vector<char> &inputs, const std::string &request_id)
 {
     kvs_group_server_logger.log("Primary received write operation - executing 2PC", 20);
 
-    // primary is centralized sequencer - acquire lock for sequence number and increment sequence number
-    // This operation's seq number is saved for use during 2PC (since another primary thread may receive an operation and modify the sequence number)
-    BackendServer::seq_num_lock.lock();
-    BackendServer::seq_num += 1;
-    uint32_t operation_seq_num = BackendServer::seq_num;
-    BackendServer::seq_num_lock.unlock();
-
     // extract write command from inputs and convert to lowercase. Erase command from beginning of inputs
     std::string command(inputs.begin(), inputs.begin() + 4);
     command = Utils::to_lowercase(command);
@@ -390,8 +553,24 @@ void KVSGroupServer::execute_two_phase_commit(std::vector<char> &inputs)
     std::string row(inputs.begin(), row_end);
     inputs.erase(inputs.begin(), row_end + 1);
 
+    // the forwarding server checked ownership before the row's range may have been migrated away - reject the write before it's sequenced
+    std::shared_ptr<Tablet> tablet = BackendServer::retrieve_data_tablet(row);
+    if (tablet == nullptr)
+    {
+        BackendServer::pending_operations--;
+        send_error_response("Row not managed by this server");
+        return;
+    }
+
+    // primary is centralized sequencer - acquire lock for sequence number and increment sequence number
+    // This operation's seq number is saved for use during 2PC (since another primary thread may receive an operation and modify the sequence number)
+    BackendServer::seq_num_lock.lock();
+    BackendServer::seq_num += 1;
+    uint32_t operation_seq_num = BackendServer::seq_num;
+    BackendServer::seq_num_lock.unlock();
+
     // save the file name of the tablet log you'll be writing logs to
-    std::string operation_log_filename = BackendServer::retrieve_data_tablet(row)->log_filename;
+    std::string operation_log_filename = tablet->log_filename;
 
     // print operation and row
     kvs_group_server_logger.log("OP[" + std::to_string(operation_seq_num) + "] Executing " + command + " on R[" + row + "]", 20);
@@ -401,6 +580,11 @@ void KVSGroupServer::execute_two_phase_commit(std::vector<char> &inputs)
     // open connection with servers in recovery and add them to the map
     for (int port : BackendServer::ports_in_recovery)
     {
+        // server may already be listed as a secondary if the coordinator re-added it before the primary saw it finish recovering
+        if (secondary_servers.count(port) != 0)
+        {
+            continue;
+        }
         int recovery_server_fd = BeUtils::open_connection(port);
         secondary_servers[port] = recovery_server_fd;
     }
@@ -410,18 +594,27 @@ void KVSGroupServer::execute_two_phase_commit(std::vector<char> &inputs)
     // write BEGIN to log
     // P is added to indicate that the operation was performed as a primary
     write_to_log(operation_log_filename, operation_seq_num, "BEGNP");
+    OpTrace::record(OpTrace::BEGN, operation_seq_num);
 
     // Send PREPARE to all secondaries
     if (construct_and_send_prepare(operation_seq_num, command, row, secondary_servers) < 0)
     {
         // Failure while constructing and sending PREPARE
         clean_operation_state(secondary_servers);
+        BackendServer::record_commit(operation_seq_num);
+        BackendServer::pending_operations--;
         send_error_response("OP[" + std::to_string(operation_seq_num) + "] Unable to send PREPARE to secondary");
         return;
     }
+    OpTrace::record(OpTrace::PREP_SENT, operation_seq_num, secondary_servers.size());
 
     // Wait for votes from all secondaries (with timeout)
-    bool all_secondaries_in_favor = handle_secondary_votes(operation_seq_num, secondary_servers);
+    // in quorum mode, secondaries that haven't voted by the time a majority is reached are lagging - they still receive the outcome, but the primary doesn't wait for them
+    std::unordered_map<int, int> lagging_servers;
+    bool all_secondaries_in_favor = BackendServer::quorum_mode
+                                        ? handle_quorum_votes(operation_seq_num, secondary_servers, lagging_servers)
+                                        : handle_secondary_votes(operation_seq_num, secondary_servers);
+    OpTrace::record(OpTrace::VOTES_IN, operation_seq_num, all_secondaries_in_favor);
 
     std::vector<char> response_msg;
     // send commit message if all secondaries voted yes
@@ -437,8 +630,9 @@ void KVSGroupServer::execute_two_phase_commit(std::vector<char> &inputs)
         commit_log.insert(commit_log.end(), inputs_size.begin(), inputs_size.end());           // add input size to log
         commit_log.insert(commit_log.end(), inputs.begin(), inputs.end());                     // add inputs to log
         write_to_log(operation_log_filename, operation_seq_num, commit_log);
+        OpTrace::record(OpTrace::DECISION_LOGGED, operation_seq_num, 1);
 
-        response_msg = construct_and_send_commit(operation_seq_num, command, row, inputs, secondary_servers);
+        response_msg = construct_and_send_commit(operation_seq_num, request_id, command, row, inputs, secondary_servers);
     }
     // send abort message if all secondaries voted no
     else
@@ -449,10 +643,45 @@ void KVSGroupServer::execute_two_phase_commit(std::vector<char> &inputs)
         abort_log.insert(abort_log.end(), row_size.begin(), row_size.end());               // add row size to log
         abort_log.insert(abort_log.end(), row.begin(), row.end());                         // add row to log
         write_to_log(operation_log_filename, operation_seq_num, abort_log);
+        OpTrace::record(OpTrace::DECISION_LOGGED, operation_seq_num, 0);
 
         response_msg = construct_and_send_abort(operation_seq_num, row, secondary_servers);
     }
 
+    // hand lagging servers off to a separate thread, which reads their vote and ack once they catch up
+    if (!lagging_servers.empty())
+    {
+        for (const auto &server : lagging_servers)
+        {
+            secondary_servers.erase(server.first);
+        }
+        std::thread drain_thread(drain_lagging_servers, operation_seq_num, lagging_servers);
+        drain_thread.detach();
+    }
+
+    // return position of committed write (+OK CP#:SEQ#), so client can fence later reads on secondaries behind it
+    // aborted and failed operations are finished too, so the committed position can move past them
+    BackendServer::record_commit(operation_seq_num);
+    if (all_secondaries_in_favor)
+    {
+        add_committed_position(operation_seq_num, response_msg);
+        if (!request_id.empty())
+        {
+            BackendServer::record_request(request_id, response_msg);
+        }
+    }
+
+    // decision is durable in the primary's log and has been sent to every secondary - respond to client now,
+    // and collect ACKs and write END to the log in the background
+    send_response(response_msg);
+    OpTrace::record(OpTrace::RESPONSE_SENT, operation_seq_num);
+    std::thread completion_thread(complete_two_phase_commit, operation_seq_num, operation_log_filename, secondary_servers);
+    completion_thread.detach();
+}
+
+/// @brief Wait for ACKs from secondaries and write END to log once the client has been sent the result of the operation
+void KVSGroupServer::complete_two_phase_commit(uint32_t operation_seq_num, std::string operation_log_filename, std::unordered_map<int, int> secondary_servers)
+{
     // wait for servers to respond with acks
     std::vector<int> dead_servers = BackendServer::wait_for_acks_from_servers(secondary_servers);
     // remove dead servers from map of servers so we're not waiting on an ACK from them
@@ -467,13 +696,15 @@ void KVSGroupServer::execute_two_phase_commit(std::vector<char> &inputs)
     {
         BeUtils::read_with_size(server.second); // we don't need to do anything with the ACKs
     }
+    OpTrace::record(OpTrace::ACKS_IN, operation_seq_num, secondary_servers.size());
 
     // write END to log
     write_to_log(operation_log_filename, operation_seq_num, "ENDT");
+    OpTrace::record(OpTrace::ENDT, operation_seq_num);
 
     kvs_group_server_logger.log("OP[" + std::to_string(operation_seq_num) + "] Received ACKS from secondaries", 20);
     clean_operation_state(secondary_servers);
-    send_response(response_msg);
+    BackendServer::pending_operations--;
 }
 
 /// @brief Constructs prepare command to send to secondary servers
@@ -552,8 +783,95 @@ bool KVSGroupServer::handle_secondary_votes(uint32_t operation_seq_num, std::uno
     return true;
 }
 
+/// @brief Read votes from secondaries until a majority of the group (including the primary) votes yes or a majority can no longer be reached
+bool KVSGroupServer::handle_quorum_votes(uint32_t operation_seq_num, std::unordered_map<int, int> &secondary_servers, std::unordered_map<int, int> &lagging_servers)
+{
+    // primary counts as one yes vote - majority is over every server configured in the group, not just the ones reachable now,
+    // so two sides of a partition can't both commit
+    size_t votes_needed = std::max(BackendServer::group_size, secondary_servers.size() + 1) / 2;
+    size_t yes_votes = 0;
+    size_t no_votes = 0;
+    if (secondary_servers.size() < votes_needed)
+    {
+        kvs_group_server_logger.log("OP[" + std::to_string(operation_seq_num) + "] Only " + std::to_string(secondary_servers.size()) + " secondaries reachable - " + std::to_string(votes_needed) + " votes needed for a majority", 30);
+        lagging_servers = secondary_servers;
+        return false;
+    }
+    kvs_group_server_logger.log("OP[" + std::to_string(operation_seq_num) + "] Waiting for " + std::to_string(votes_needed) + " of " + std::to_string(secondary_servers.size()) + " votes from secondaries", 20);
+
+    // every server is lagging until its vote is read
+    lagging_servers = secondary_servers;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(2000);
+    while (yes_votes < votes_needed && no_votes <= secondary_servers.size() - votes_needed)
+    {
+        int remaining_ms = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining_ms <= 0)
+        {
+            kvs_group_server_logger.log("OP[" + std::to_string(operation_seq_num) + "] Timeout exceeded - failed to receive votes from a majority of secondaries", 20);
+            return false;
+        }
+
+        // poll all servers that haven't voted yet and read every vote that's available
+        std::vector<pollfd> pollfds;
+        for (const auto &server : lagging_servers)
+        {
+            pollfd pfd;
+            pfd.fd = server.second;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            pollfds.push_back(pfd);
+        }
+        if (poll(pollfds.data(), pollfds.size(), remaining_ms) < 0)
+        {
+            kvs_group_server_logger.log("OP[" + std::to_string(operation_seq_num) + "] Error occurred while polling secondaries for votes", 40);
+            return false;
+        }
+        for (const pollfd &pfd : pollfds)
+        {
+            if (!(pfd.revents & (POLLIN | POLLHUP | POLLERR)))
+            {
+                continue;
+            }
+            for (auto server = lagging_servers.begin(); server != lagging_servers.end(); server++)
+            {
+                if (server->second != pfd.fd)
+                {
+                    continue;
+                }
+                // a server that failed to vote is treated as a no vote
+                BeUtils::ReadResult secondary_read = BeUtils::read_with_size(pfd.fd);
+                std::string vote = secondary_read.error_code == 0 && secondary_read.byte_stream.size() >= 4 ? std::string(secondary_read.byte_stream.begin(), secondary_read.byte_stream.begin() + 4) : "secn";
+                Utils::to_lowercase(vote) == "secy" ? yes_votes++ : no_votes++;
+                lagging_servers.erase(server);
+                break;
+            }
+        }
+    }
+
+    kvs_group_server_logger.log("OP[" + std::to_string(operation_seq_num) + "] Received " + std::to_string(yes_votes) + " YES and " + std::to_string(no_votes) + " NO votes from secondaries", 20);
+    return yes_votes >= votes_needed;
+}
+
+/// @brief Read vote and ack from servers that were lagging when a quorum was reached, then close their connections
+void KVSGroupServer::drain_lagging_servers(uint32_t operation_seq_num, std::unordered_map<int, int> lagging_servers)
+{
+    for (const auto &server : lagging_servers)
+    {
+        // lagging server sends its vote and then its ack (we don't need to do anything with them)
+        for (int i = 0; i < 2; i++)
+        {
+            if (BeUtils::wait_for_events({server.second}, 30000) < 0 || BeUtils::read_with_size(server.second).error_code != 0)
+            {
+                break;
+            }
+        }
+        close(server.second);
+    }
+    kvs_group_server_logger.log("OP[" + std::to_string(operation_seq_num) + "] Lagging secondaries caught up", 20);
+}
+
 /// @brief Construct and send COMMIT to secondary servers
-std::vector<char> KVSGroupServer::construct_and_send_commit(uint32_t operation_seq_num, std::string &command, std::string &row, std::vector<char> &inputs, std::unordered_map<int, int> &secondary_servers)
+std::vector<char> KVSGroupServer::construct_and_send_commit(uint32_t operation_seq_num, const std::string &request_id, std::string &command, std::string &row, std::vector<char> &inputs, std::unordered_map<int, int> &secondary_servers)
 {
     // all secondaries voted yes - construct commit message to send to all secondaries
     kvs_group_server_logger.log("OP[" + std::to_string(operation_seq_num) + "] All secondaries voted YES - sending COMMIT", 20);
@@ -566,6 +884,8 @@ std::vector<char> KVSGroupServer::construct_and_send_commit(uint32_t operation_s
     std::vector<char> commit_msg = {'C', 'M', 'M', 'T', ' '};
     std::vector<uint8_t> seq_num_vec = BeUtils::host_num_to_network_vector(operation_seq_num); // add sequence number to commit_msg
     commit_msg.insert(commit_msg.end(), seq_num_vec.begin(), seq_num_vec.end());
+    commit_msg.insert(commit_msg.end(), request_id.begin(), request_id.end()); // add id of forwarded write (may be empty) and delimiter to commit_msg
+    commit_msg.push_back('\b');
     commit_msg.insert(commit_msg.end(), command.begin(), command.end()); // add command to commit_msg
     commit_msg.insert(commit_msg.end(), row.begin(), row.end());         // add row to commit_msg and add space after to differentiate remaining inputs
     commit_msg.push_back(' ');
@@ -603,6 +923,17 @@ std::vector<char> KVSGroupServer::construct_and_send_abort(uint32_t operation_se
     return std::vector<char>(response_msg.begin(), response_msg.end());
 }
 
+/// @brief Append position of committed write to a successful response (+OK CP#:SEQ#), so client can fence later reads on secondaries behind it
+void KVSGroupServer::add_committed_position(uint32_t operation_seq_num, std::vector<char> &response_msg)
+{
+    std::string ok = "+OK";
+    if (response_msg.size() == ok.size() && std::equal(ok.begin(), ok.end(), response_msg.begin()))
+    {
+        std::string position = " " + BackendServer::committed_position(operation_seq_num);
+        response_msg.insert(response_msg.end(), position.begin(), position.end());
+    }
+}
+
 // *********************************************
 // 2PC SECONDARY RESPONSE METHODS
 // *********************************************
@@ -636,6 +967,7 @@ void KVSGroupServer::prepare(std::vector<char> &inputs)
 
     // acquire an exclusive lock on the row
     std::vector<char> vote_response;
+    holds_row_lock = false;
     // failed to acquire exclusive row lock
     if (!BackendServer::is_recovering && tablet->acquire_exclusive_row_lock(command, row) < 0)
     {
@@ -662,6 +994,7 @@ void KVSGroupServer::prepare(std::vector<char> &inputs)
         write_to_log(tablet->log_filename, operation_seq_num, prepare_log);
 
         // construct vote
+        holds_row_lock = !BackendServer::is_recovering;
         vote_response = {'S', 'E', 'C', 'Y', ' '};
         kvs_group_server_logger.log("OP[" + std::to_string(operation_seq_num) + "] Secondary voted SECY", 20);
     }
@@ -670,6 +1003,7 @@ void KVSGroupServer::prepare(std::vector<char> &inputs)
     std::vector<uint8_t> seq_num_vec = BeUtils::host_num_to_network_vector(operation_seq_num);
     vote_response.insert(vote_response.end(), seq_num_vec.begin(), seq_num_vec.end());
     send_response(vote_response);
+    OpTrace::record(OpTrace::SECONDARY_VOTED, operation_seq_num, vote_response.at(3) == 'Y');
 }
 
 // @brief Secondary responds to commit command
@@ -682,6 +1016,11 @@ void KVSGroupServer::commit(std::vector<char> &inputs)
     uint32_t operation_seq_num = BeUtils::network_vector_to_host_num(inputs);
     inputs.erase(inputs.begin(), inputs.begin() + 4);
 
+    // extract id of forwarded write (empty if it had none). Erase id from beginning of inputs (+1 to remove delimiter)
+    auto request_id_end = std::find(inputs.begin(), inputs.end(), '\b');
+    std::string request_id(inputs.begin(), request_id_end);
+    inputs.erase(inputs.begin(), request_id_end + 1);
+
     // extract command from inputs and convert to lowercase. Erase command from beginning of inputs
     std::string command(inputs.begin(), inputs.begin() + 4);
     command = Utils::to_lowercase(command);
@@ -692,6 +1031,29 @@ void KVSGroupServer::commit(std::vector<char> &inputs)
     std::string row(inputs.begin(), row_end);
     inputs.erase(inputs.begin(), row_end + 1);
 
+    kvs_group_server_logger.log("OP[" + std::to_string(operation_seq_num) + "] Secondary received CMMT from primary for " + command + " on R[" + row + "]", 20);
+
+    // in quorum mode, the group can commit an operation this server voted no on - acquire the row lock now to apply it
+    std::shared_ptr<Tablet> tablet = BackendServer::retrieve_data_tablet(row);
+    if (!BackendServer::is_recovering && !holds_row_lock && tablet->acquire_exclusive_row_lock(command, row) < 0)
+    {
+        // the row doesn't exist here, so this server missed an earlier operation on it and has diverged from the primary
+        // don't log, end or ack the operation (committed position stays behind it) - NACK and rebuild state from the primary instead
+        kvs_group_server_logger.log("OP[" + std::to_string(operation_seq_num) + "] Secondary is missing R[" + row + "] - unable to apply commit", 40);
+        std::vector<char> nack_response = {'N', 'A', 'C', 'K', ' '};
+        std::vector<uint8_t> seq_num_vec = BeUtils::host_num_to_network_vector(operation_seq_num);
+        nack_response.insert(nack_response.end(), seq_num_vec.begin(), seq_num_vec.end());
+        send_response(nack_response);
+
+        // only the first connection to notice starts the resync
+        if (!BackendServer::is_dead.exchange(true))
+        {
+            std::thread resync_thread(BackendServer::resync_with_primary);
+            resync_thread.detach();
+        }
+        return;
+    }
+
     // write COMMIT to log - requires sequence number, command, row, inputs to commit transaction
     std::vector<char> commit_log = {'C', 'M', 'M', 'T'};
     commit_log.insert(commit_log.end(), command.begin(), command.end());                   // add command to log
@@ -701,25 +1063,34 @@ void KVSGroupServer::commit(std::vector<char> &inputs)
     std::vector<uint8_t> inputs_size = BeUtils::host_num_to_network_vector(inputs.size()); // size of inputs
     commit_log.insert(commit_log.end(), inputs_size.begin(), inputs_size.end());           // add input size to log
     commit_log.insert(commit_log.end(), inputs.begin(), inputs.end());                     // add inputs to log
-    std::string operation_log_filename = BackendServer::retrieve_data_tablet(row)->log_filename;
+    std::string operation_log_filename = tablet->log_filename;
     write_to_log(operation_log_filename, operation_seq_num, commit_log);
 
-    kvs_group_server_logger.log("OP[" + std::to_string(operation_seq_num) + "] Secondary received CMMT from primary for " + command + " on R[" + row + "]", 20);
-
     // execute write operation if server is not in recovery mode
+    std::vector<char> response_msg;
     if (!BackendServer::is_recovering)
     {
         // execute write operation
-        execute_write_operation(command, row, inputs);
+        response_msg = execute_write_operation(command, row, inputs);
     }
+    holds_row_lock = false;
 
     // write END to log
     write_to_log(operation_log_filename, operation_seq_num, "ENDT");
+    OpTrace::record(OpTrace::SECONDARY_ENDT, operation_seq_num);
 
-    // update sequence number on this server now that END log has been written
+    // update sequence number on this server now that END log has been written (operations on different rows can end out of order)
     BackendServer::seq_num_lock.lock();
-    BackendServer::seq_num = operation_seq_num;
+    BackendServer::seq_num = std::max(BackendServer::seq_num, operation_seq_num);
     BackendServer::seq_num_lock.unlock();
+    BackendServer::record_commit(operation_seq_num);
+
+    // remember the primary's response to the write, in case this server is promoted and the forwarding server resends it
+    if (!request_id.empty() && !response_msg.empty())
+    {
+        add_committed_position(operation_seq_num, response_msg);
+        BackendServer::record_request(request_id, response_msg);
+    }
 
     // send back ack
     std::vector<char> ack_response = {'A', 'C', 'K', 'N', ' '};
@@ -754,20 +1125,23 @@ void KVSGroupServer::abort(std::vector<char> &inputs)
     abort_log.insert(abort_log.end(), row.begin(), row.end());                         // add row to log
     write_to_log(tablet->log_filename, operation_seq_num, abort_log);
 
-    // release exclusive lock on row if server is not in recovery mode
-    if (!BackendServer::is_recovering)
+    // release exclusive lock on row if this server acquired it during prepare
+    if (holds_row_lock)
     {
         // release exclusive lock on row
         tablet->release_exclusive_row_lock(row);
+        holds_row_lock = false;
     }
 
     // write END to log
     write_to_log(tablet->log_filename, operation_seq_num, "ENDT");
 
-    // update sequence number on this server now that END log has been written
+    // update sequence number on this server now that END log has been written (operations on different rows can end out of order)
     BackendServer::seq_num_lock.lock();
-    BackendServer::seq_num = operation_seq_num;
+    BackendServer::seq_num = std::max(BackendServer::seq_num, operation_seq_num);
     BackendServer::seq_num_lock.unlock();
+    // aborted operation is finished too, so later operations can count as committed
+    BackendServer::record_commit(operation_seq_num);
 
     // send ACK back to primary
     std::vector<char> ack_response = {'A', 'C', 'K', 'N', ' '};
@@ -783,6 +1157,12 @@ void KVSGroupServer::abort(std::vector<char> &inputs)
 // Need to send a copy of inputs here because secondary receives exact copy of this command, and inputs is modified heavily in write operations
 std::vector<char> KVSGroupServer::execute_write_operation(std::string &command, std::string &row, std::vector<char> inputs)
 {
+    // record write if row is in a range being migrated off this server
+    if (BackendServer::is_primary)
+    {
+        BackendServer::track_migration_write(command, row, inputs);
+    }
+
     // call handler for command
     if (command == "putv")
     {
@@ -0,0 +1,203 @@
+#include "../include/op_trace.h"
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// *********************************************
+// CONSTANTS
+// *********************************************
+
+const size_t OpTrace::num_records = 65536; // 2MB of records per server
+const std::string OpTrace::file_name = "trace";
+
+static const char trace_magic[8] = {'P', 'C', 'T', 'R', 'A', 'C', 'E', '1'};
+
+// *********************************************
+// STATIC FIELD INITIALIZATION
+// *********************************************
+
+std::atomic<uint32_t> OpTrace::checkpoint(0);
+OpTrace::Header *OpTrace::header = nullptr;
+OpTrace::Record *OpTrace::records = nullptr;
+uint16_t OpTrace::port = 0;
+
+// *********************************************
+// WRITING
+// *********************************************
+
+/// @brief Map the trace file (created if it doesn't exist, reset if it was written with a different layout)
+int OpTrace::open(const std::string &path, int server_port)
+{
+    static_assert(sizeof(Header) == 64, "trace header must stay 64 bytes");
+    static_assert(sizeof(Record) == 32, "trace record must stay 32 bytes");
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    size_t file_size = sizeof(Header) + num_records * sizeof(Record);
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0 || (static_cast<size_t>(file_stat.st_size) != file_size && ftruncate(fd, file_size) < 0))
+    {
+        close(fd);
+        return -1;
+    }
+
+    void *mapped = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // mapping keeps the file open
+    if (mapped == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    // keep appending to a trace left by a previous run of this server, otherwise start a fresh one (new files are zero-filled)
+    Header *mapped_header = static_cast<Header *>(mapped);
+    if (memcmp(mapped_header->magic, trace_magic, sizeof(trace_magic)) != 0 || mapped_header->record_size != sizeof(Record) || mapped_header->capacity != num_records)
+    {
+        memset(mapped, 0, file_size);
+        memcpy(mapped_header->magic, trace_magic, sizeof(trace_magic));
+        mapped_header->record_size = sizeof(Record);
+        mapped_header->capacity = num_records;
+        mapped_header->next_index.store(0);
+    }
+    mapped_header->port = server_port;
+
+    port = server_port;
+    records = reinterpret_cast<Record *>(static_cast<char *>(mapped) + sizeof(Header));
+    header = mapped_header;
+    return 0;
+}
+
+uint64_t OpTrace::now_ns()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+void OpTrace::record(Event event, uint32_t seq_num, uint32_t value, uint64_t time_ns)
+{
+    if (header != nullptr)
+    {
+        append(event, checkpoint.load(std::memory_order_relaxed), seq_num, value, time_ns == 0 ? now_ns() : time_ns);
+    }
+}
+
+/// @brief Append a record to the ring. Writers claim distinct slots, so the only shared write is the fetch_add on the index.
+void OpTrace::append(Event event, uint32_t record_checkpoint, uint32_t seq_num, uint32_t value, uint64_t time_ns)
+{
+    uint64_t index = header->next_index.fetch_add(1, std::memory_order_relaxed);
+    Record &slot = records[index % num_records];
+
+    // invalidate slot while it's rewritten, then publish it by storing its stamp
+    slot.stamp.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.time_ns = time_ns;
+    slot.checkpoint = record_checkpoint;
+    slot.seq_num = seq_num;
+    slot.port = port;
+    slot.event = event;
+    slot.reserved = 0;
+    slot.value = value;
+    slot.stamp.store(index + 1, std::memory_order_release);
+}
+
+/// @brief Record client receive, forward and response of a write once its sequence number is known from the response
+void OpTrace::record_forwarded(const std::vector<char> &response, uint64_t recv_ns, uint64_t forward_ns)
+{
+    if (header == nullptr)
+    {
+        return;
+    }
+
+    // committed writes are answered with +OK CP#:SEQ# - anything else was aborted or failed before it was sequenced
+    uint32_t response_checkpoint = checkpoint.load(std::memory_order_relaxed);
+    uint32_t seq_num = 0;
+    std::string res(response.begin(), response.end());
+    size_t colon = res.find(':');
+    if (res.compare(0, 4, "+OK ") == 0 && colon != std::string::npos)
+    {
+        response_checkpoint = std::strtoul(res.c_str() + 4, nullptr, 10);
+        seq_num = std::strtoul(res.c_str() + colon + 1, nullptr, 10);
+    }
+
+    append(CLIENT_RECV, response_checkpoint, seq_num, 0, recv_ns);
+    append(FORWARD, response_checkpoint, seq_num, 0, forward_ns);
+    append(CLIENT_RESPONSE, response_checkpoint, seq_num, seq_num != 0, now_ns());
+}
+
+// *********************************************
+// READING
+// *********************************************
+
+/// @brief Read the completed records of a trace file, oldest first (slots being rewritten when the file was copied are skipped)
+int OpTrace::read_file(const std::string &path, std::vector<Entry> &entries)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0 || static_cast<size_t>(file_stat.st_size) < sizeof(Header))
+    {
+        close(fd);
+        return -1;
+    }
+    void *mapped = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        return -1;
+    }
+
+    const Header *file_header = static_cast<const Header *>(mapped);
+    if (memcmp(file_header->magic, trace_magic, sizeof(trace_magic)) != 0 || file_header->record_size != sizeof(Record) ||
+        sizeof(Header) + file_header->capacity * sizeof(Record) > static_cast<size_t>(file_stat.st_size))
+    {
+        munmap(mapped, file_stat.st_size);
+        return -1;
+    }
+
+    const Record *file_records = reinterpret_cast<const Record *>(static_cast<const char *>(mapped) + sizeof(Header));
+    uint64_t capacity = file_header->capacity;
+    uint64_t end = file_header->next_index.load(std::memory_order_acquire);
+    uint64_t start = end > capacity ? end - capacity : 0;
+    for (uint64_t index = start; index < end; index++)
+    {
+        const Record &slot = file_records[index % capacity];
+        if (slot.stamp.load(std::memory_order_acquire) != index + 1)
+        {
+            continue;
+        }
+        Entry entry;
+        entry.time_ns = slot.time_ns;
+        entry.checkpoint = slot.checkpoint;
+        entry.seq_num = slot.seq_num;
+        entry.port = slot.port;
+        entry.event = slot.event;
+        entry.value = slot.value;
+
+        // drop the record if a writer reclaimed the slot while it was being copied
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.stamp.load(std::memory_order_relaxed) == index + 1)
+        {
+            entries.push_back(entry);
+        }
+    }
+
+    munmap(mapped, file_stat.st_size);
+    return 0;
+}
+
+const char *OpTrace::event_name(uint8_t event)
+{
+    static const char *names[NUM_EVENTS] = {"?", "client_recv", "forward", "begn", "prep_sent", "votes_in", "decision_logged", "response_sent", "acks_in", "endt", "client_response", "secondary_voted", "secondary_endt"};
+    return event < NUM_EVENTS ? names[event] : "?";
+}
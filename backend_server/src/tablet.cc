@@ -36,14 +36,16 @@ std::vector<char> Tablet::get_all_rows()
 /// @brief Reads all columns at provided row
 std::vector<char> Tablet::get_row(std::string &row)
 {
-    // Return empty vector if row not found in map
+    row_locks_mutex.lock_shared(); // acquire shared lock on row_locks to read mutex from row_locks
+
+    // Return empty vector if row not found in map (checked under row_locks_mutex, since deletes and migrations erase rows)
     if (data.count(row) == 0)
     {
+        row_locks_mutex.unlock_shared(); // release shared lock on row_lock's mutex
         tablet_logger.log("-ER Row not found", 20);
         return construct_msg("Row not found", true);
     }
 
-    row_locks_mutex.lock_shared();   // acquire shared lock on row_locks to read mutex from row_locks
     row_locks.at(row).lock_shared(); // acquire shared lock on this row's mutex
     const auto &row_level_data = data.at(row);
 
@@ -70,14 +72,16 @@ std::vector<char> Tablet::get_row(std::string &row)
 /// @brief Reads value at provided row and column
 std::vector<char> Tablet::get_value(std::string &row, std::string &col)
 {
-    // Return empty vector if row not found in map
+    row_locks_mutex.lock_shared(); // acquire shared lock on row_locks to read mutex from row_locks
+
+    // Return empty vector if row not found in map (checked under row_locks_mutex, since deletes and migrations erase rows)
     if (data.count(row) == 0)
     {
+        row_locks_mutex.unlock_shared(); // release shared lock on row_lock's mutex
         tablet_logger.log("-ER Row not found", 20);
         return construct_msg("Row not found", true);
     }
 
-    row_locks_mutex.lock_shared();   // acquire shared lock on row_locks to read mutex from row_locks
     row_locks.at(row).lock_shared(); // acquire shared lock on this row's mutex
     const auto &row_level_data = data.at(row);
 
@@ -97,12 +101,55 @@ std::vector<char> Tablet::get_value(std::string &row, std::string &col)
     row_locks_mutex.unlock_shared();   // release shared lock on row_lock's mutex
 
     // append +OK to response and send it back
-    tablet_logger.log("+OK Retrieved value at R[" + row + "], C[" + col + "]", 20);
+    LOGGER_LOG(tablet_logger, 20, "+OK Retrieved value at R[" + row + "], C[" + col + "]");
     response_msg.insert(response_msg.begin(), ok.begin(), ok.end());
     response_msg.insert(response_msg.begin() + ok.size(), ' '); // Add a space after "+OK"
     return response_msg;
 }
 
+/// @brief read part of a value from tablet data, so large values can be transferred in pieces
+std::vector<char> Tablet::get_value_range(std::string &row, std::string &col, size_t offset, size_t length)
+{
+    row_locks_mutex.lock_shared(); // acquire shared lock on row_locks to read mutex from row_locks
+
+    // Return empty vector if row not found in map (checked under row_locks_mutex, since deletes and migrations erase rows)
+    if (data.count(row) == 0)
+    {
+        row_locks_mutex.unlock_shared(); // release shared lock on row_lock's mutex
+        tablet_logger.log("-ER Row not found", 20);
+        return construct_msg("Row not found", true);
+    }
+
+    row_locks.at(row).lock_shared(); // acquire shared lock on this row's mutex
+    const auto &row_level_data = data.at(row);
+
+    // release shared lock and exit if col not found in row
+    if (row_level_data.count(col) == 0)
+    {
+        row_locks.at(row).unlock_shared(); // release shared lock on row's mutex
+        row_locks_mutex.unlock_shared();   // release shared lock on row_lock's mutex
+        tablet_logger.log("-ER Column not found", 20);
+        return construct_msg("Column not found", true);
+    }
+
+    // response is headed by the full size of the value, so the caller can plan the remaining reads
+    const std::vector<char> &value = row_level_data.at(col);
+    std::string header = ok + " " + std::to_string(value.size()) + delimiter;
+    size_t bytes_start = std::min(offset, value.size());
+    size_t bytes_end = bytes_start + std::min(length, value.size() - bytes_start);
+
+    std::vector<char> response_msg;
+    response_msg.reserve(header.size() + bytes_end - bytes_start);
+    response_msg.insert(response_msg.end(), header.begin(), header.end());
+    response_msg.insert(response_msg.end(), value.begin() + bytes_start, value.begin() + bytes_end);
+
+    row_locks.at(row).unlock_shared(); // release shared lock on row's mutex
+    row_locks_mutex.unlock_shared();   // release shared lock on row_lock's mutex
+
+    LOGGER_LOG(tablet_logger, 20, "+OK Retrieved bytes [" + std::to_string(bytes_start) + ", " + std::to_string(bytes_end) + ") of value at R[" + row + "], C[" + col + "]");
+    return response_msg;
+}
+
 // *********************************************
 // ACQUIRING/RELEASING LOCKS FOR WRITE
 // *********************************************
@@ -122,7 +169,7 @@ int Tablet::acquire_exclusive_row_lock(std::string &operation, std::string &row)
         row_locks.at(row).lock();      // acquire exclusive lock on data map to create row
         // create entry for row in data map
         data.emplace(row, std::unordered_map<std::string, std::vector<char>>());
-        tablet_logger.log("Created R[" + row + "]", 20);
+        LOGGER_LOG(tablet_logger, 20, "Created R[" + row + "]");
         // return from here since locks have been acquired
         return 0;
     }
@@ -147,7 +194,7 @@ void Tablet::release_exclusive_row_lock(std::string &row)
 {
     row_locks.at(row).unlock();      // unlock exclusive lock on row
     row_locks_mutex.unlock_shared(); // unlock shared lock on row locks
-    tablet_logger.log("+OK Released exclusive row lock on R[" + row + "]", 20);
+    LOGGER_LOG(tablet_logger, 20, "+OK Released exclusive row lock on R[" + row + "]");
 }
 
 // *********************************************
@@ -166,7 +213,7 @@ std::vector<char> Tablet::put_value(std::string &row, std::string &col, std::vec
     row_locks.at(row).unlock();      // unlock exclusive lock on row
     row_locks_mutex.unlock_shared(); // unlock shared lock on row locks
 
-    tablet_logger.log("+OK Inserted value at R[" + row + "], C[" + col + "]", 20);
+    LOGGER_LOG(tablet_logger, 20, "+OK Inserted value at R[" + row + "], C[" + col + "]");
     std::vector<char> response_msg(ok.begin(), ok.end());
     return response_msg;
 }
@@ -191,7 +238,7 @@ std::vector<char> Tablet::cond_put_value(std::string &row, std::string &col, std
 
     row_locks.at(row).unlock();      // unlock exclusive lock on row
     row_locks_mutex.unlock_shared(); // release shared lock on row locks
-    tablet_logger.log("+OK Conditionally inserted value at R[" + row + "], C[" + col + "]", 20);
+    LOGGER_LOG(tablet_logger, 20, "+OK Conditionally inserted value at R[" + row + "], C[" + col + "]");
     std::vector<char> response_msg(ok.begin(), ok.end());
     return response_msg;
 }
@@ -210,7 +257,7 @@ std::vector<char> Tablet::delete_row(std::string &row)
     row_locks.erase(row);
     row_locks_mutex.unlock();
 
-    tablet_logger.log("+OK Deleted R[" + row + "]", 20);
+    LOGGER_LOG(tablet_logger, 20, "+OK Deleted R[" + row + "]");
     std::vector<char> response_msg(ok.begin(), ok.end());
     return response_msg;
 }
@@ -236,7 +283,7 @@ std::vector<char> Tablet::delete_value(std::string &row, std::string &col)
     row_locks.at(row).unlock();      // unlock exclusive lock on row
     row_locks_mutex.unlock_shared(); // release shared lock on row locks
 
-    tablet_logger.log("+OK Deleted value at R[" + row + "], C[" + col + "]", 20);
+    LOGGER_LOG(tablet_logger, 20, "+OK Deleted value at R[" + row + "], C[" + col + "]");
     std::vector<char> response_msg(ok.begin(), ok.end());
     return response_msg;
 }
@@ -267,7 +314,7 @@ std::vector<char> Tablet::rename_row(std::string &old_row, std::string &new_row)
     row_locks.erase(old_row);
     row_locks_mutex.unlock();
 
-    tablet_logger.log("+OK Renamed row R[" + old_row + "] to R[" + new_row + "]", 20);
+    LOGGER_LOG(tablet_logger, 20, "+OK Renamed row R[" + old_row + "] to R[" + new_row + "]");
     std::vector<char> response_msg(ok.begin(), ok.end());
     return response_msg;
 }
@@ -286,7 +333,7 @@ std::vector<char> Tablet::rename_column(std::string &row, std::string &old_col,
     row_locks.at(row).unlock();      // unlock exclusive lock on row
     row_locks_mutex.unlock_shared(); // unlock shared lock on row locks
 
-    tablet_logger.log("+OK Renamed column at R[" + row + "] from C[" + old_col + "] to C[" + new_col + "]", 20);
+    LOGGER_LOG(tablet_logger, 20, "+OK Renamed column at R[" + row + "] from C[" + old_col + "] to C[" + new_col + "]");
     std::vector<char> response_msg(ok.begin(), ok.end());
     return response_msg;
 }
@@ -399,9 +446,9 @@ void Tablet::deserialize_from_file(const std::string &file_name)
     // read until the end of the file
     while (true)
     {
-        // exit loop if we've reached the end of the file
+        // exit loop if we've reached the end of the file (or the file can't be read)
         // must be located at the start in case the tablet is empty
-        if (file.eof())
+        if (!file.good())
         {
             break;
         }
@@ -536,6 +583,245 @@ void Tablet::deserialize_from_stream(std::vector<char> &stream)
     }
 }
 
+// *********************************************
+// TABLET MIGRATION
+// *********************************************
+
+// read 4 byte network order number from stream at offset
+static uint32_t read_num_at(std::vector<char> &stream, size_t offset)
+{
+    std::vector<char> num_vec(stream.begin() + offset, stream.begin() + offset + 4);
+    return BeUtils::network_vector_to_host_num(num_vec);
+}
+
+/// @brief Append row in checkpoint format ([size of row key][row][size of row data][size of col key][col][size of val][value]...) to stream
+void Tablet::append_row_to_stream(const std::string &row, std::vector<char> &stream)
+{
+    // write size of row name and row name to stream
+    std::vector<uint8_t> row_name_size = BeUtils::host_num_to_network_vector(row.length());
+    stream.insert(stream.end(), row_name_size.begin(), row_name_size.end());
+    stream.insert(stream.end(), row.begin(), row.end());
+
+    // calculate size of column data for this row
+    const auto &row_level_column_map = data.at(row);
+    uint32_t column_data_size = 0;
+    for (const auto &col : row_level_column_map)
+    {
+        column_data_size += col.first.length() + col.second.size() + 8;
+    }
+    std::vector<uint8_t> column_data_size_vec = BeUtils::host_num_to_network_vector(column_data_size);
+    stream.insert(stream.end(), column_data_size_vec.begin(), column_data_size_vec.end());
+
+    // write each column and its data to the stream
+    for (const auto &col : row_level_column_map)
+    {
+        std::vector<uint8_t> col_name_size = BeUtils::host_num_to_network_vector(col.first.length());
+        stream.insert(stream.end(), col_name_size.begin(), col_name_size.end());
+        stream.insert(stream.end(), col.first.begin(), col.first.end());
+
+        std::vector<uint8_t> col_data_size = BeUtils::host_num_to_network_vector(col.second.size());
+        stream.insert(stream.end(), col_data_size.begin(), col_data_size.end());
+        stream.insert(stream.end(), col.second.begin(), col.second.end());
+    }
+}
+
+/// @brief Serialize all rows >= split_key into a stream that can be deserialized as a tablet for split_key:range_end
+std::vector<char> Tablet::serialize_range_to_stream(const std::string &split_key)
+{
+    // header is the range of the migrated tablet (each should be 1 character)
+    std::vector<char> stream(split_key.begin(), split_key.end());
+    stream.insert(stream.end(), range_end.begin(), range_end.end());
+
+    row_locks_mutex.lock_shared(); // acquire shared lock on row_locks to read mutex from row_locks
+    for (auto row = data.lower_bound(split_key); row != data.end(); row++)
+    {
+        row_locks.at(row->first).lock_shared(); // acquire shared lock on this row's mutex
+        append_row_to_stream(row->first, stream);
+        row_locks.at(row->first).unlock_shared(); // release shared lock on row's mutex
+    }
+    row_locks_mutex.unlock_shared(); // release shared lock on row_lock's mutex
+    return stream;
+}
+
+/// @brief Serialize supplied rows into a stream headed by split_key:range_end. Rows that no longer exist are added to missing_rows.
+std::vector<char> Tablet::serialize_rows_to_stream(const std::string &split_key, const std::unordered_set<std::string> &rows, std::vector<std::string> &missing_rows)
+{
+    std::vector<char> stream(split_key.begin(), split_key.end());
+    stream.insert(stream.end(), range_end.begin(), range_end.end());
+
+    row_locks_mutex.lock_shared(); // acquire shared lock on row_locks to read mutex from row_locks
+    for (const std::string &row : rows)
+    {
+        if (data.count(row) == 0)
+        {
+            missing_rows.push_back(row);
+            continue;
+        }
+        row_locks.at(row).lock_shared(); // acquire shared lock on this row's mutex
+        append_row_to_stream(row, stream);
+        row_locks.at(row).unlock_shared(); // release shared lock on row's mutex
+    }
+    row_locks_mutex.unlock_shared(); // release shared lock on row_lock's mutex
+    return stream;
+}
+
+/// @brief Replace rows in tablet with the rows contained in stream (stream must be in checkpoint row format, starting at offset)
+void Tablet::install_rows_from_stream(std::vector<char> &stream, size_t offset)
+{
+    // exclusive access to row_locks guarantees that no reader or writer holds a row lock during the install
+    row_locks_mutex.lock();
+    while (offset < stream.size())
+    {
+        // extract the row name
+        uint32_t row_name_size = read_num_at(stream, offset);
+        offset += 4;
+        std::string row_name(stream.begin() + offset, stream.begin() + offset + row_name_size);
+        offset += row_name_size;
+
+        // create mutex for row and clear any stale columns in the row
+        row_locks[row_name];
+        auto &row_level_column_map = data[row_name];
+        row_level_column_map.clear();
+
+        // read columns until all data for this row has been processed
+        uint32_t row_data_size = read_num_at(stream, offset);
+        offset += 4;
+        size_t row_data_end = offset + row_data_size;
+        while (offset < row_data_end)
+        {
+            uint32_t col_name_size = read_num_at(stream, offset);
+            offset += 4;
+            std::string col_name(stream.begin() + offset, stream.begin() + offset + col_name_size);
+            offset += col_name_size;
+
+            uint32_t col_data_size = read_num_at(stream, offset);
+            offset += 4;
+            row_level_column_map[col_name] = std::vector<char>(stream.begin() + offset, stream.begin() + offset + col_data_size);
+            offset += col_data_size;
+        }
+    }
+    row_locks_mutex.unlock();
+}
+
+/// @brief Remove rows and their mutexes from tablet
+void Tablet::erase_rows(const std::vector<std::string> &rows)
+{
+    row_locks_mutex.lock();
+    for (const std::string &row : rows)
+    {
+        data.erase(row);
+        row_locks.erase(row);
+    }
+    row_locks_mutex.unlock();
+}
+
+/// @brief Drop all rows >= split_key and shrink the tablet's range so that it ends right before split_key
+void Tablet::truncate_at(const std::string &split_key)
+{
+    row_locks_mutex.lock();
+    for (auto row = data.lower_bound(split_key); row != data.end();)
+    {
+        row_locks.erase(row->first);
+        row = data.erase(row);
+    }
+    row_locks_mutex.unlock();
+
+    // update range and log file name for this tablet
+    range_end = std::string(1, split_key[0] - 1);
+    log_filename = range_start + "_" + range_end + "_log";
+    LOGGER_LOG(tablet_logger, 20, "Truncated tablet to range " + range_start + ":" + range_end);
+}
+
+// *********************************************
+// TABLET RESIZING
+// *********************************************
+
+/// @brief Calculate number of rows and approximate number of bytes (row keys + column keys + values) stored in tablet
+void Tablet::get_size(size_t &num_rows, size_t &num_bytes)
+{
+    num_rows = 0;
+    num_bytes = 0;
+    row_locks_mutex.lock_shared(); // acquire shared lock on row_locks to read mutex from row_locks
+    for (const auto &row : data)
+    {
+        row_locks.at(row.first).lock_shared(); // acquire shared lock on this row's mutex
+        num_rows++;
+        num_bytes += row.first.length();
+        for (const auto &col : row.second)
+        {
+            num_bytes += col.first.length() + col.second.size();
+        }
+        row_locks.at(row.first).unlock_shared(); // release shared lock on row's mutex
+    }
+    row_locks_mutex.unlock_shared(); // release shared lock on row_lock's mutex
+}
+
+/// @brief Find the first key of the upper half of the tablet (by bytes). Returns an empty string if the tablet can't be split.
+std::string Tablet::find_split_key()
+{
+    // tablets are split on the first character of a row, so a tablet managing a single character can't be split
+    if (range_start >= range_end)
+    {
+        return "";
+    }
+
+    size_t num_rows;
+    size_t num_bytes;
+    get_size(num_rows, num_bytes);
+
+    // find row at which half of the tablet's bytes have been seen
+    char split_char = range_end[0];
+    size_t bytes_seen = 0;
+    row_locks_mutex.lock_shared(); // acquire shared lock on row_locks to read mutex from row_locks
+    for (const auto &row : data)
+    {
+        row_locks.at(row.first).lock_shared(); // acquire shared lock on this row's mutex
+        bytes_seen += row.first.length();
+        for (const auto &col : row.second)
+        {
+            bytes_seen += col.first.length() + col.second.size();
+        }
+        row_locks.at(row.first).unlock_shared(); // release shared lock on row's mutex
+        if (bytes_seen * 2 >= num_bytes)
+        {
+            split_char = row.first[0];
+            break;
+        }
+    }
+    row_locks_mutex.unlock_shared(); // release shared lock on row_lock's mutex
+
+    // both halves must manage at least one character
+    split_char = std::max(split_char, (char)(range_start[0] + 1));
+    split_char = std::min(split_char, range_end[0]);
+    return std::string(1, split_char);
+}
+
+/// @brief Take exclusive access to the row_locks map - waits for every row lock to be released
+void Tablet::lock_all_rows()
+{
+    row_locks_mutex.lock();
+}
+
+void Tablet::unlock_all_rows()
+{
+    row_locks_mutex.unlock();
+}
+
+/// @brief Move rows that fall in this tablet's range out of source and into this tablet
+void Tablet::absorb_rows(Tablet &source)
+{
+    // caller's exclusive access to source's row_locks map (lock_all_rows) guarantees that no reader or writer holds a row lock on source
+    row_locks_mutex.lock();
+    for (auto row = source.data.lower_bound(range_start); row != source.data.end() && row->first.substr(0, 1) <= range_end;)
+    {
+        data[row->first] = std::move(row->second);
+        row_locks[row->first];
+        source.row_locks.erase(row->first);
+        row = source.data.erase(row);
+    }
+    row_locks_mutex.unlock();
+}
+
 // *********************************************
 // TABLET LOG REPLAY
 // *********************************************
@@ -560,13 +846,15 @@ uint32_t Tablet::replay_log_from_file(const std::string &file_name)
     bool is_primary_during_transaction;
     // tracks if an abort operation already occurred in this transaction as a secondary (don't want to release locks twice)
     bool prepare_seen = false;
+    // tracks if the row lock is held for the operation in this transaction (lock isn't taken if the row doesn't exist)
+    bool row_locked = false;
 
     // read until the end of the file
     while (true)
     {
-        // exit loop if we've reached the end of the file
+        // exit loop if we've reached the end of the file (or the file can't be read)
         // must be located at the start in case the log file is empty
-        if (file.eof())
+        if (!file.good())
         {
             break;
         }
@@ -611,11 +899,11 @@ uint32_t Tablet::replay_log_from_file(const std::string &file_name)
 
             // safe guard - if server was a primary, then prepare log should never have been found
             // however, if it was found, we'll still read the necessary items to clear it from the log, but we won't acquire the row lock
-            if (is_primary_during_transaction)
+            if (!is_primary_during_transaction)
             {
                 prepare_seen = true;
                 // acquire the exclusive row lock to perform the operation
-                acquire_exclusive_row_lock(write_operation, row_name);
+                row_locked = acquire_exclusive_row_lock(write_operation, row_name) == 0;
             }
         }
         else if (operation == "CMMT")
@@ -644,15 +932,20 @@ uint32_t Tablet::replay_log_from_file(const std::string &file_name)
             std::vector<char> inputs(inputs_size);
             file.read(inputs.data(), inputs_size);
 
-            // if you're the primary, you need to acquire the locks first (secondary would already have acquired it during prepare)
-            if (is_primary_during_transaction)
+            // if you're the primary, you need to acquire the locks first (secondary would already have acquired it during prepare,
+            // unless it voted no and the group committed anyway in quorum mode)
+            if (!prepare_seen)
             {
                 // acquire the exclusive row lock to perform the operation
-                acquire_exclusive_row_lock(write_operation, row_name);
+                row_locked = acquire_exclusive_row_lock(write_operation, row_name) == 0;
             }
 
-            // perform the commit operation
-            execute_write_operation(write_operation, row_name, inputs);
+            // perform the commit operation (nothing to apply if the row doesn't exist)
+            if (row_locked)
+            {
+                execute_write_operation(write_operation, row_name, inputs);
+            }
+            row_locked = false;
         }
         else if (operation == "ABRT")
         {
@@ -668,16 +961,18 @@ uint32_t Tablet::replay_log_from_file(const std::string &file_name)
 
             // if you're the primary, do nothing
             // if you're the secondary, do nothing UNLESS you previously saw a PREPARE command
-            if (!is_primary_during_transaction && prepare_seen)
+            if (!is_primary_during_transaction && prepare_seen && row_locked)
             {
                 // release the exclusive row lock held in preparation for COMMIT
                 release_exclusive_row_lock(row_name);
             }
+            row_locked = false;
         }
         else if (operation == "ENDT")
         {
             // reset necessaray transaction related fields
             prepare_seen = false;
+            row_locked = false;
             transaction_complete = true;         // set flag indicating this transaction is in progress
             transaction_num = operation_seq_num; // set global transaction number for operation
         }
@@ -697,6 +992,8 @@ uint32_t Tablet::replay_log_from_stream(std::vector<char> &stream)
     bool is_primary_during_transaction;
     // tracks if an abort operation already occurred in this transaction as a secondary (don't want to release locks twice)
     bool prepare_seen = false;
+    // tracks if the row lock is held for the operation in this transaction (lock isn't taken if the row doesn't exist)
+    bool row_locked = false;
 
     // read until the end of the file
     while (!stream.empty())
@@ -738,11 +1035,11 @@ uint32_t Tablet::replay_log_from_stream(std::vector<char> &stream)
 
             // safe guard - if server was a primary, then prepare log should never have been found
             // however, if it was found, we'll still read the necessary items to clear it from the log, but we won't acquire the row lock
-            if (is_primary_during_transaction)
+            if (!is_primary_during_transaction)
             {
                 prepare_seen = true;
                 // acquire the exclusive row lock to perform the operation
-                acquire_exclusive_row_lock(write_operation, row_name);
+                row_locked = acquire_exclusive_row_lock(write_operation, row_name) == 0;
             }
         }
         else if (operation == "CMMT")
@@ -769,15 +1066,20 @@ uint32_t Tablet::replay_log_from_stream(std::vector<char> &stream)
             std::vector<char> inputs(stream.begin(), stream.begin() + inputs_size);
             stream.erase(stream.begin(), stream.begin() + inputs_size);
 
-            // if you're the primary, you need to acquire the locks first (secondary would already have acquired it during prepare)
-            if (is_primary_during_transaction)
+            // if you're the primary, you need to acquire the locks first (secondary would already have acquired it during prepare,
+            // unless it voted no and the group committed anyway in quorum mode)
+            if (!prepare_seen)
             {
                 // acquire the exclusive row lock to perform the operation
-                acquire_exclusive_row_lock(write_operation, row_name);
+                row_locked = acquire_exclusive_row_lock(write_operation, row_name) == 0;
             }
 
-            // perform the commit operation
-            execute_write_operation(write_operation, row_name, inputs);
+            // perform the commit operation (nothing to apply if the row doesn't exist)
+            if (row_locked)
+            {
+                execute_write_operation(write_operation, row_name, inputs);
+            }
+            row_locked = false;
         }
         else if (operation == "ABRT")
         {
@@ -792,16 +1094,18 @@ uint32_t Tablet::replay_log_from_stream(std::vector<char> &stream)
 
             // if you're the primary, do nothing
             // if you're the secondary, do nothing UNLESS you previously saw a PREPARE command
-            if (!is_primary_during_transaction && prepare_seen)
+            if (!is_primary_during_transaction && prepare_seen && row_locked)
             {
                 // release the exclusive row lock held in preparation for COMMIT
                 release_exclusive_row_lock(row_name);
             }
+            row_locked = false;
         }
         else if (operation == "ENDT")
         {
             // reset necessaray transaction related fields
             prepare_seen = false;
+            row_locked = false;
             transaction_complete = true;         // set flag indicating this transaction is in progress
             transaction_num = operation_seq_num; // set global transaction number for operation
         }
@@ -887,7 +1191,7 @@ void Tablet::putv(std::string &row, std::vector<char> &inputs)
     std::vector<char> val(col_end + 1, inputs.end());
 
     // log command and args
-    tablet_logger.log("PUTV R[" + row + "] C[" + col + "]", 20);
+    LOGGER_LOG(tablet_logger, 20, "PUTV R[" + row + "] C[" + col + "]");
 
     // retrieve tablet and put value for row and col combination
     put_value(row, col, val);
@@ -926,7 +1230,7 @@ void Tablet::cput(std::string &row, std::vector<char> &inputs)
     std::vector<char> val2 = inputs;
 
     // log command and args
-    tablet_logger.log("CPUT R[" + row + "] C[" + col + "]", 20);
+    LOGGER_LOG(tablet_logger, 20, "CPUT R[" + row + "] C[" + col + "]");
 
     // call CPUT on tablet
     cond_put_value(row, col, val1, val2);
@@ -935,7 +1239,7 @@ void Tablet::cput(std::string &row, std::vector<char> &inputs)
 void Tablet::delr(std::string &row, std::vector<char> &inputs)
 {
     // log command and args
-    tablet_logger.log("DELR R[" + row + "]", 20);
+    LOGGER_LOG(tablet_logger, 20, "DELR R[" + row + "]");
 
     // retrieve tablet and delete row
     delete_row(row);
@@ -946,7 +1250,7 @@ void Tablet::delv(std::string &row, std::vector<char> &inputs)
     std::string col(inputs.begin(), inputs.end());
 
     // log command and args
-    tablet_logger.log("DELV R[" + row + "] C[" + col + "]", 20);
+    LOGGER_LOG(tablet_logger, 20, "DELV R[" + row + "] C[" + col + "]");
 
     // retrieve tablet and delete value from row and col combination
     delete_value(row, col);
@@ -958,7 +1262,7 @@ void Tablet::rnmr(std::string &row, std::vector<char> &inputs)
     std::string new_row(inputs.begin(), inputs.end());
 
     // log command and args
-    tablet_logger.log("RNMR R1[" + row + "] R2[" + new_row + "]", 20);
+    LOGGER_LOG(tablet_logger, 20, "RNMR R1[" + row + "] R2[" + new_row + "]");
 
     // retrieve tablet and delete value from row and col combination
     rename_row(row, new_row);
@@ -982,7 +1286,7 @@ void Tablet::rnmc(std::string &row, std::vector<char> &inputs)
     std::string new_col(inputs.begin(), inputs.end());
 
     // log command and args
-    tablet_logger.log("RNMC R[" + row + "] C1[" + old_col + "] C2[" + new_col + "]", 20);
+    LOGGER_LOG(tablet_logger, 20, "RNMC R[" + row + "] C1[" + old_col + "] C2[" + new_col + "]");
 
     // retrieve tablet and delete value from row and col combination
     rename_column(row, old_col, new_col);
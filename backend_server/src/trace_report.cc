@@ -0,0 +1,226 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "../include/op_trace.h"
+
+// phase of an operation, measured between two events
+struct Phase
+{
+    const char *name;
+    uint8_t from;
+    uint8_t to;
+    bool background; // phase runs after the client has been answered
+};
+
+// phases in the order an operation moves through them
+static const Phase phases[] = {
+    {"client_parse", OpTrace::CLIENT_RECV, OpTrace::FORWARD, false},
+    {"forward", OpTrace::FORWARD, OpTrace::BEGN, false},
+    {"prepare", OpTrace::BEGN, OpTrace::PREP_SENT, false},
+    {"votes", OpTrace::PREP_SENT, OpTrace::VOTES_IN, false},
+    {"decision_log", OpTrace::VOTES_IN, OpTrace::DECISION_LOGGED, false},
+    {"commit_send", OpTrace::DECISION_LOGGED, OpTrace::RESPONSE_SENT, false},
+    {"respond", OpTrace::RESPONSE_SENT, OpTrace::CLIENT_RESPONSE, false},
+    {"acks", OpTrace::RESPONSE_SENT, OpTrace::ACKS_IN, true},
+    {"end_log", OpTrace::ACKS_IN, OpTrace::ENDT, true},
+    {"secondary_vote", OpTrace::PREP_SENT, OpTrace::SECONDARY_VOTED, false},
+    {"secondary_apply", OpTrace::DECISION_LOGGED, OpTrace::SECONDARY_ENDT, true},
+    {"total", OpTrace::CLIENT_RECV, OpTrace::CLIENT_RESPONSE, false},
+};
+
+// every event recorded for one operation, across all trace files
+struct Operation
+{
+    std::vector<OpTrace::Entry> entries;
+
+    // time of event (latest occurrence, so the slowest secondary is reported). Returns false if the event wasn't recorded.
+    bool event_time(uint8_t event, uint64_t &time_ns) const
+    {
+        bool found = false;
+        for (const OpTrace::Entry &entry : entries)
+        {
+            if (entry.event == event && (!found || entry.time_ns > time_ns))
+            {
+                time_ns = entry.time_ns;
+                found = true;
+            }
+        }
+        return found;
+    }
+};
+
+static uint64_t percentile(const std::vector<uint64_t> &sorted, double p)
+{
+    return sorted.at(std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size())));
+}
+
+/// @brief Print count and latency percentiles of each phase
+static void print_breakdown(const std::map<std::pair<uint32_t, uint32_t>, Operation> &operations)
+{
+    std::cout << std::left << std::setw(18) << "phase" << std::right << std::setw(9) << "count" << std::setw(11) << "p50(us)" << std::setw(11) << "p90(us)"
+              << std::setw(11) << "p99(us)" << std::setw(11) << "max(us)" << std::endl;
+    for (const Phase &phase : phases)
+    {
+        std::vector<uint64_t> durations;
+        for (const auto &operation : operations)
+        {
+            uint64_t from_ns, to_ns;
+            if (operation.second.event_time(phase.from, from_ns) && operation.second.event_time(phase.to, to_ns) && to_ns >= from_ns)
+            {
+                durations.push_back((to_ns - from_ns) / 1000);
+            }
+        }
+        if (durations.empty())
+        {
+            continue;
+        }
+        std::sort(durations.begin(), durations.end());
+        std::cout << std::left << std::setw(18) << (std::string(phase.name) + (phase.background ? "*" : "")) << std::right << std::setw(9) << durations.size()
+                  << std::setw(11) << percentile(durations, 0.5) << std::setw(11) << percentile(durations, 0.9) << std::setw(11) << percentile(durations, 0.99)
+                  << std::setw(11) << durations.back() << std::endl;
+    }
+    std::cout << "(* runs after the client is answered)" << std::endl;
+}
+
+/// @brief Print folded stacks (total us per phase) for flamegraph.pl
+static void print_folded(const std::map<std::pair<uint32_t, uint32_t>, Operation> &operations)
+{
+    for (const Phase &phase : phases)
+    {
+        if (std::string(phase.name) == "total" || std::string(phase.name).compare(0, 10, "secondary_") == 0)
+        {
+            continue; // these overlap the primary's phases
+        }
+        uint64_t total_us = 0;
+        for (const auto &operation : operations)
+        {
+            uint64_t from_ns, to_ns;
+            if (operation.second.event_time(phase.from, from_ns) && operation.second.event_time(phase.to, to_ns) && to_ns >= from_ns)
+            {
+                total_us += (to_ns - from_ns) / 1000;
+            }
+        }
+        if (total_us > 0)
+        {
+            std::cout << "write;" << (phase.background ? "background;" : "") << phase.name << " " << total_us << std::endl;
+        }
+    }
+}
+
+/// @brief Print every event of an operation with a bar spanning until the next event recorded by the same server
+static void print_timeline(uint32_t checkpoint, uint32_t seq_num, Operation operation)
+{
+    const int width = 60;
+    std::sort(operation.entries.begin(), operation.entries.end(), [](const OpTrace::Entry &a, const OpTrace::Entry &b)
+              { return a.time_ns < b.time_ns; });
+    uint64_t start_ns = operation.entries.front().time_ns;
+    uint64_t span_ns = std::max<uint64_t>(operation.entries.back().time_ns - start_ns, 1);
+
+    std::cout << "OP[" << checkpoint << ":" << seq_num << "] " << span_ns / 1000 << "us" << std::endl;
+    for (size_t i = 0; i < operation.entries.size(); i++)
+    {
+        const OpTrace::Entry &entry = operation.entries.at(i);
+        uint64_t end_ns = entry.time_ns;
+        for (size_t j = i + 1; j < operation.entries.size(); j++)
+        {
+            if (operation.entries.at(j).port == entry.port)
+            {
+                end_ns = operation.entries.at(j).time_ns;
+                break;
+            }
+        }
+
+        int bar_start = (entry.time_ns - start_ns) * width / span_ns;
+        int bar_end = std::max<int>((end_ns - start_ns) * width / span_ns, bar_start + 1);
+        std::string bar(width + 1, ' ');
+        std::fill(bar.begin() + bar_start, bar.begin() + std::min(bar_end, width + 1), '#');
+
+        std::cout << std::right << std::setw(10) << ("+" + std::to_string((entry.time_ns - start_ns) / 1000) + "us") << "  " << std::setw(5) << entry.port << "  "
+                  << std::left << std::setw(16) << OpTrace::event_name(entry.event) << std::setw(4) << entry.value << "|" << bar << "|" << std::endl;
+    }
+}
+
+// main function to analyze trace files written by storage servers (KVS_<port>/trace)
+// main expects the following flags:
+// s - print the timeline of each operation with this sequence number instead of the phase breakdown
+// c - only include operations sequenced in this checkpoint version
+// f - print folded stacks (input for flamegraph.pl) instead of the phase breakdown
+// Example: trace_report [-s 42] [-c 3] [-f] KVS_6000/trace KVS_6001/trace KVS_6002/trace KVS_6003/trace
+int main(int argc, char *argv[])
+{
+    long timeline_seq_num = -1;
+    long checkpoint = -1;
+    bool folded = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:c:f")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            timeline_seq_num = std::strtol(optarg, nullptr, 10);
+            break;
+        case 'c':
+            checkpoint = std::strtol(optarg, nullptr, 10);
+            break;
+        case 'f':
+            folded = true;
+            break;
+        default:
+            std::cerr << "Usage: trace_report [-s SEQ] [-c CHECKPOINT] [-f] TRACE_FILE..." << std::endl;
+            return -1;
+        }
+    }
+    if (optind == argc)
+    {
+        std::cerr << "Usage: trace_report [-s SEQ] [-c CHECKPOINT] [-f] TRACE_FILE..." << std::endl;
+        return -1;
+    }
+
+    // merge records of every file into operations keyed by CP#:SEQ#
+    std::map<std::pair<uint32_t, uint32_t>, Operation> operations;
+    size_t unsequenced = 0;
+    for (int i = optind; i < argc; i++)
+    {
+        std::vector<OpTrace::Entry> entries;
+        if (OpTrace::read_file(argv[i], entries) < 0)
+        {
+            std::cerr << "Unable to read trace file " << argv[i] << std::endl;
+            return -1;
+        }
+        for (const OpTrace::Entry &entry : entries)
+        {
+            if (entry.seq_num == 0)
+            {
+                unsequenced += entry.event == OpTrace::CLIENT_RESPONSE;
+                continue;
+            }
+            if ((checkpoint >= 0 && entry.checkpoint != checkpoint) || (timeline_seq_num >= 0 && entry.seq_num != timeline_seq_num))
+            {
+                continue;
+            }
+            operations[std::make_pair(entry.checkpoint, entry.seq_num)].entries.push_back(entry);
+        }
+    }
+
+    if (timeline_seq_num >= 0)
+    {
+        for (const auto &operation : operations)
+        {
+            print_timeline(operation.first.first, operation.first.second, operation.second);
+        }
+    }
+    else if (folded)
+    {
+        print_folded(operations);
+    }
+    else
+    {
+        std::cout << operations.size() << " operations (" << unsequenced << " client writes not committed)" << std::endl;
+        print_breakdown(operations);
+    }
+    return 0;
+}
@@ -25,9 +25,11 @@
 #include <strings.h>
 #include <stdlib.h>
 #include <shared_mutex>
-#include <poll.h>
+#include <sys/epoll.h>
+#include <chrono>
 #include <random>
 #include <algorithm>
+#include <atomic>
 
 #include "../../utils/include/utils.h"
 #include "../../front_end/utils/include/fe_utils.h"
@@ -39,20 +41,77 @@ extern int MAX_REQUEST;                            // max size of a request by c
 extern Logger logger;                              // setup logger
 extern int SHUTDOWN;                               // shutdown flag
 extern int VERBOSE;                                // verbose flag
+extern std::string LOOKUP_HELLO;                   // line a front end sends to open a persistent lookup connection
+extern int HEARTBEAT_TIMEOUT_MS;                   // time without a heartbeat before a kvs is declared dead
+extern int HEARTBEAT_TICK_MS;                      // granularity of the heartbeat timer wheel
+extern int HEARTBEAT_WHEEL_SLOTS;                  // slots in the heartbeat timer wheel
 
 /// @brief signal handler
 /// @param sig signal to handle
 void signal_handler(int sig);
 
-/// @brief work to be done by thread servicing a request from a KVS server
-/// @param arg a void pointer
+/// @brief work to be done by the thread tracking heartbeats of every KVS server
+/// @param arg unused
 /// @return void
-void *kvs_thread(void *arg);
+void *heartbeat_thread(void *arg);
 
-/// @brief work to be done by thread servicing a request from a front-end server
-/// @param arg a void pointer
+/// @brief hands an initialized kvs connection to the heartbeat thread
+/// @param kvs the kvs in kvs_intranet, with fd set to its connection
+void register_kvs(struct kvs_args &kvs);
+
+/// @brief handles a command received on a kvs connection
+/// @param kvs the kvs that sent the command
+/// @param command command with its CRLF removed
+/// @return true if the command was recognized, false otherwise
+bool handle_kvs_command(struct kvs_args &kvs, const std::string &command);
+
+/// @brief records the position a kvs reported with its heartbeat and re-elects the standby of its cluster
+/// @param kvs the kvs that sent the heartbeat
+/// @param position committed position of the kvs - CP#:SEQ#
+void record_kvs_position(struct kvs_args &kvs, const std::string &position);
+
+/// @brief marks the most caught-up secondary of a cluster as its standby (cluster_mutex must be held exclusively)
+/// @param group the cluster number
+/// @return index of the standby in the cluster, or -1 if the cluster has no secondaries
+int elect_standby(int group);
+
+/// @brief adds a kvs that resumed heartbeats back to the client map and its cluster and broadcasts the new cluster
+/// @param kvs the kvs that is alive again
+void mark_kvs_alive(struct kvs_args &kvs);
+
+/// @brief removes a dead kvs from the client map and its cluster, promoting the standby if it was the primary, and broadcasts the new cluster
+/// @param kvs the kvs that stopped sending heartbeats
+void mark_kvs_dead(struct kvs_args &kvs);
+
+/// @brief hands an accepted connection to the lookup thread, which reads and serves its first message
+/// @param fd the accepted connection
+/// @param addr ip:port of the peer
+void register_connection(int fd, const std::string &addr);
+
+/// @brief work to be done by the thread serving front-end lookups and reading the first message of every connection
+/// @param arg unused
 /// @return void
-void *client_thread(void *arg);
+void *lookup_thread(void *arg);
+
+/// @brief handles the first message received on a connection (kvs INIT, MIGR, lookup hello or one-shot lookup)
+/// @param client the connection, with request holding the message
+/// @return true if the connection stays open for lookups, false if it should be closed (fd is set to -1 if it was handed off)
+bool handle_first_message(struct client_args &client);
+
+/// @brief answers every complete lookup frame received on a persistent front-end connection with a single send
+/// @param client the connection, with request holding the bytes received that weren't answered yet
+/// @return true if the connection stays open, false if a frame was malformed or the response couldn't be sent
+bool answer_lookup_frames(struct client_args &client);
+
+/// @brief looks up the kvs responsible for a path in the current routing snapshot (does not lock)
+/// @param path file/folder path whose first character selects the kvs
+/// @param found set to true if a kvs was found, false otherwise
+/// @param version set to the version of the snapshot the lookup was answered from
+/// @return the client-facing address of the kvs, or an error message if none was found
+std::string lookup_kvs(const std::string &path, bool &found, uint64_t &version);
+
+/// @brief rebuilds the routing snapshot from the client map and kvs clusters and publishes it to readers (must be called after every client map or cluster update)
+void publish_routing_snapshot();
 
 /// @brief randomly sample an index between [0, length)
 /// @param length the upper bound of the sampling range (exclusive)
@@ -62,7 +121,7 @@ size_t sample_index(size_t length);
 /// @brief constructs a specialized message for the given kvs
 /// @param kvs an address of a kvs_args struct
 /// @return a message to be sent back to the kvs
-std::string get_kvs_message(struct kvs_args &kvs);
+std::string get_kvs_message(const struct kvs_args &kvs);
 
 /// @brief broadcasts a specialized message to each member of the cluster specified by group number
 /// @param group the cluster number of the calling kvs
@@ -84,12 +143,18 @@ bool send_kvs_init(struct kvs_args &kvs, std::string &request);
 /// @return true is successful, false otherwise
 bool send_kvs_reco(struct kvs_args &kvs);
 
+/// @brief moves ownership of a key range from one kvs cluster to another after a tablet migration
+/// @param request - MIGR request of the form "MIGR <source server addr> <start>:<end> <target server addr>"
+/// @return "+OK\r\n" if successful, "-ER <reason>\r\n" otherwise
+std::string migrate_key_range(std::string &request);
+
 /// @brief client server connection
 struct client_args
 {
-    std::string addr;    // address of client
-    int fd;              // file descriptor for coordinator-http communication
-    std::string request; // data read from client socket
+    std::string addr;        // address of client
+    int fd;                  // file descriptor for coordinator-http communication
+    std::string request;     // data read from client socket (not yet handled)
+    bool persistent = false; // sent the lookup hello, so frames are served until it disconnects
 };
 
 /// @brief kvs server connection
@@ -103,6 +168,36 @@ struct kvs_args
     bool alive;              // alive or not
     int kvs_group;           // kvs cluser number
     int fd = -1;             // file descriptor for coordinator-kvs communication
+    bool standby = false;    // secondary promoted if the primary dies (most caught-up secondary of its cluster)
+    uint32_t checkpoint = 0; // checkpoint version of the last operation the kvs reported as committed
+    uint32_t seq_num = 0;    // sequence number of the last operation the kvs reported as committed
+};
+
+/// @brief heartbeat state of a kvs connection (owned by the heartbeat thread)
+struct kvs_connection
+{
+    struct kvs_args *kvs;   // kvs in kvs_intranet
+    std::string buffer;     // bytes received that don't form a complete command yet
+    uint64_t deadline_tick; // timer wheel tick at which the kvs is declared dead unless it sends a heartbeat first
+};
+
+/// @brief immutable routing table read without locking (replaced as a whole by publish_routing_snapshot)
+struct routing_snapshot
+{
+    uint64_t version;                                               // increases whenever a key is routed to a different kvs
+    std::string kvs_addrs[256];                                     // client-facing address of the kvs serving each key (empty if no kvs serves the key)
+    std::unordered_map<int, std::vector<struct kvs_args>> clusters; // copy of kvs_clusters when the snapshot was built
+};
+
+/// @brief pins the current routing snapshot for the lifetime of the guard, so it isn't freed while it's read (only locks if every reader slot is taken)
+struct routing_guard
+{
+    const routing_snapshot *snapshot; // pinned snapshot (guards nest - an inner guard may see a newer snapshot)
+
+    routing_guard();
+    ~routing_guard();
+    routing_guard(const routing_guard &) = delete;
+    routing_guard &operator=(const routing_guard &) = delete;
 };
 
 #endif
\ No newline at end of file
@@ -12,7 +12,7 @@
  *  Coordinator stores ancillary data structures on launch to alleviate burden
  *  of primary reassignment later.
  *
- *  Launch: ./coordinator [-v verbose mode] [-s # number of server groups] [-b # number of backups per kvs group]
+ *  Launch: ./coordinator [-v verbose mode] [-s # number of server groups] [-b # number of backups per kvs group] [-t # ms without heartbeat before a kvs is declared dead]
  *
  *  !!! Coordinator starts on 127.0.0.1:4999 !!!
  *  !!! Port pattern for KVS servers is: 6[<0-index server_group#>][<0-indexed server#>]0
@@ -54,6 +54,24 @@
  *          "127.0.0.1:9210", kvs_args,
  *          "127.0.0.1:9220": kvs_args,
  *      }
+ *  4) routing - immutable, versioned routing_snapshot holding the kvs chosen for each key and a copy of kvs_clusters
+ *      Rebuilt and swapped in atomically whenever client_map or kvs_clusters change, so lookups and messages
+ *      to kvs servers never wait on failover bookkeeping. Readers pin the snapshot they load by publishing the
+ *      current epoch in a per-thread reader slot (routing_guard); a replaced snapshot is freed once every pinned
+ *      reader has moved past the epoch it was replaced in.
+ *
+ *  Front ends keep a persistent connection open for lookups:
+ *      front end sends "LKUP\r\n" once, then any number of frames
+ *      request frame:  [4-byte big-endian length][path]
+ *      response frame: [4-byte big-endian length][status byte: '+' found, '-' error][8-byte big-endian snapshot version][ip:port or error message]
+ *      front ends drop cached addresses older than the newest version they've seen
+ *  One-shot connections (path in, ip:port out, connection closed) are still served for older clients
+ *  Every accepted connection is handed to a single lookup thread that polls them with epoll: it reads the first
+ *  message, hands kvs connections (INIT) to the heartbeat thread and serves lookups without a thread per front end
+ *
+ *  KVS heartbeats are read by a single heartbeat thread that polls every kvs connection with epoll.
+ *  Each PING pushes the kvs's deadline forward on a hashed timer wheel (HEARTBEAT_TICK_MS per slot);
+ *  a kvs is declared dead when its deadline passes or as soon as its connection closes.
  */
 
 #include "../include/coordinator.h"
@@ -65,6 +83,10 @@ int MAX_REQUEST = 10000;                    // max size of a request by coordina
 std::mutex MAP_MUTEX;                       // mutex for map of threads
 int SHUTDOWN = 0;                           // shutdown flag
 int VERBOSE = 0;                            // verbose flag
+std::string LOOKUP_HELLO = "LKUP\r\n";      // line a front end sends to open a persistent lookup connection
+int HEARTBEAT_TIMEOUT_MS = 3000;            // time without a heartbeat before a kvs is declared dead
+int HEARTBEAT_TICK_MS = 100;                // granularity of the heartbeat timer wheel
+int HEARTBEAT_WHEEL_SLOTS = 64;             // slots in the heartbeat timer wheel (deadlines further out wait for later rounds)
 
 std::unordered_map<std::string, struct kvs_args> kvs_intranet; // tracks which kvs intranet ip is associated with each kvs server
 std::shared_timed_mutex intranet_mutex;
@@ -72,6 +94,16 @@ std::unordered_map<int, std::vector<struct kvs_args>> kvs_clusters; // tracks wh
 std::shared_timed_mutex cluster_mutex;
 std::unordered_map<char, std::vector<struct kvs_args>> client_map; // tracks the kvs servers responsible for each key
 std::shared_timed_mutex client_map_mutex;
+std::atomic<const routing_snapshot *> routing(nullptr);                     // current routing snapshot
+std::vector<std::pair<uint64_t, const routing_snapshot *>> retired_snapshots; // replaced snapshots and the epoch they were replaced in (freed once no reader can hold them)
+std::mutex routing_mutex;                                                   // serializes publishers so snapshots are swapped in the order they were built
+std::atomic<uint64_t> routing_epoch(1);                                     // advanced every time a snapshot is replaced
+const int MAX_ROUTING_READERS = 1024;                                       // threads that can pin snapshots without locking at once
+std::atomic<bool> reader_slot_used[MAX_ROUTING_READERS];                    // reader slots claimed by a thread
+std::atomic<uint64_t> reader_epochs[MAX_ROUTING_READERS];                   // epoch each reader pinned (0 while it isn't reading)
+std::vector<struct kvs_args *> pending_kvs; // initialized kvs servers waiting to be adopted by the heartbeat thread
+std::mutex pending_kvs_mutex;
+int lookup_epoll_fd = -1; // epoll instance of the lookup thread, which polls every front-end connection
 
 int main(int argc, char *argv[])
 {
@@ -90,7 +122,7 @@ int main(int argc, char *argv[])
     int kvs_backups = 2; // default 2 backups per server group
 
     // read command line options
-    while ((option = getopt(argc, argv, "vs:b:")) != -1)
+    while ((option = getopt(argc, argv, "vs:b:t:")) != -1)
     {
         switch (option)
         {
@@ -120,8 +152,8 @@ int main(int argc, char *argv[])
                     logger.log("Number of KVS server groups must be at least 1, " + std::to_string(kvs_servers) + " provided.", LOGGER_CRITICAL);
                     return 1;
                 }
-                break;
             }
+            break;
         case 'b':
             if (optarg)
             {
@@ -145,9 +177,33 @@ int main(int argc, char *argv[])
                     logger.log("Number of KVS backups per server group must be at least 1, " + std::to_string(kvs_backups) + " provided.", LOGGER_CRITICAL);
                     return 1;
                 }
+            }
+            break;
+        case 't':
+            if (optarg)
+            {
+                // read command line argument
+                std::string input(optarg);
 
-                break;
+                // check if option is positive integer
+                for (unsigned long i = 0; i < input.length(); i++)
+                {
+                    if (!std::isdigit(input[i]))
+                    {
+                        logger.log("Option '-t' requires a positive integer argument, coordinator exiting", LOGGER_CRITICAL);
+                        return 1;
+                    }
+                }
+
+                // heartbeats are sent every second, so anything shorter would declare healthy servers dead
+                HEARTBEAT_TIMEOUT_MS = std::stoi(input);
+                if (HEARTBEAT_TIMEOUT_MS <= 1000)
+                {
+                    logger.log("Heartbeat timeout must be more than 1000 ms, " + std::to_string(HEARTBEAT_TIMEOUT_MS) + " provided.", LOGGER_CRITICAL);
+                    return 1;
+                }
             }
+            break;
         case '?':
             // handle unknown options characters
             if (isprint(optopt))
@@ -172,6 +228,7 @@ int main(int argc, char *argv[])
     {
         logger.log("Server Groups: " + std::to_string(kvs_servers), LOGGER_INFO);
         logger.log("Backups/Server Group: " + std::to_string(kvs_backups), LOGGER_INFO);
+        logger.log("Heartbeat timeout: " + std::to_string(HEARTBEAT_TIMEOUT_MS) + " ms", LOGGER_INFO);
     }
 
     /* -------------------- KVS SERVER INFORMATION -------------------- */
@@ -247,6 +304,7 @@ int main(int argc, char *argv[])
             logger.log(msg, LOGGER_DEBUG);
         }
     }
+    publish_routing_snapshot();
     logger.log("KVS server responsibilites set", LOGGER_INFO);
 
     /* -------------------- SEND ADMIN MESSAGE -------------------- */
@@ -312,6 +370,27 @@ int main(int argc, char *argv[])
     /* -------------------- COORDINATING -------------------- */
     pthread_t thid; // var for new thread_ids
 
+    // start tracking kvs heartbeats
+    if (pthread_create(&thid, NULL, heartbeat_thread, NULL) != 0)
+    {
+        logger.log("Error, unable to create heartbeat thread.", LOGGER_CRITICAL);
+        return 1;
+    }
+    MAP_MUTEX.lock();
+    THREADS[thid] = -1;
+    MAP_MUTEX.unlock();
+
+    // serve front-end lookups (and the first message of every connection) from one thread
+    lookup_epoll_fd = epoll_create1(0);
+    if (lookup_epoll_fd < 0 || pthread_create(&thid, NULL, lookup_thread, NULL) != 0)
+    {
+        logger.log("Error, unable to create lookup thread.", LOGGER_CRITICAL);
+        return 1;
+    }
+    MAP_MUTEX.lock();
+    THREADS[thid] = -1;
+    MAP_MUTEX.unlock();
+
     // setup address struct for message from client or from other servers
     struct sockaddr_in src;
     socklen_t srclen = sizeof(src);
@@ -325,89 +404,13 @@ int main(int argc, char *argv[])
         // accept incoming connections
         int comm_fd = accept(dispatcher_fd, (struct sockaddr *)&src, &srclen);
 
-        // if valid connection created (no error on accept)
+        // if valid connection created (no error on accept), hand it to the lookup thread, which reads its first message
+        // (so a peer that is slow to send can't hold up accepting other connections)
         if (comm_fd != -1)
         {
             // extract source ip address and port (important - convert port from network order to host order)
-            std::string source;
-            bool present;
-
-            std::string request;
-            request.resize(MAX_REQUEST);
-            int rlen = 0;
-            if ((rlen = recv(comm_fd, &request[0], request.size() - rlen, 0)) == -1)
-            {
-                // ERR
-            }
-            request.resize(rlen);
-
-            // Check for INIT from a KVS server (comes with source address in message)
-            if (request.substr(0, 4).compare("INIT") == 0)
-            {
-                present = true;
-                source = request.substr(5, request.size() - 7);
-            }
-            // Client messages - source ip can be extracted from sin_addr
-            else
-            {
-                present = false;
-                source = std::string(inet_ntoa(src.sin_addr)) + ":" + std::to_string(ntohs(src.sin_port));
-            }
-
-            // log message source
-            logger.log(source, LOGGER_DEBUG);
-
-            // if connection is from a kvs
-            if (present)
-            {
-                // get kvs associated with this connection
-                intranet_mutex.lock_shared();
-                kvs_args &kvs = kvs_intranet.at(source); // retrieve reference to kvs from map, since we're updating its fd (and this should be retained in the map)
-                intranet_mutex.unlock_shared();
-
-                cluster_mutex.lock();
-                for (size_t i = 0; i < kvs_clusters[kvs.kvs_group].size(); i++)
-                {
-                    if (kvs_clusters[kvs.kvs_group][i].server_addr.compare(kvs.server_addr) == 0)
-                    {
-                        kvs.fd = comm_fd;
-                        kvs_clusters[kvs.kvs_group][i].fd = comm_fd;
-                        break;
-                    }
-                }
-                cluster_mutex.unlock();
-
-                // send init response to kvs
-                if (send_kvs_init(kvs, request))
-                {
-
-                    // create thread to service long-running connection with kvs
-                    if (pthread_create(&thid, NULL, kvs_thread, (void *)&kvs) != 0)
-                    {
-                        logger.log("Error, unable to create new thread.", LOGGER_CRITICAL);
-                        return 1;
-                    }
-                }
-            }
-            else
-            {
-                struct client_args client;
-                client.addr = source;
-                client.fd = comm_fd;
-                client.request = request;
-
-                // give thread relavent handler
-                if (pthread_create(&thid, NULL, client_thread, (void *)&client) != 0)
-                {
-                    logger.log("Error, unable to create new thread.", LOGGER_CRITICAL);
-                    return 1;
-                }
-            }
-
-            // acquire mutex on threads map and store new thread id
-            MAP_MUTEX.lock();
-            THREADS[thid] = comm_fd;
-            MAP_MUTEX.unlock();
+            std::string source = std::string(inet_ntoa(src.sin_addr)) + ":" + std::to_string(ntohs(src.sin_port));
+            register_connection(comm_fd, source);
         }
         if (SHUTDOWN)
             break;
@@ -461,248 +464,720 @@ void signal_handler(int sig)
     }
 }
 
-/// @brief work to be done by thread servicing a request from a KVS server
-/// @param arg a void pointer
+/// @brief current tick of the heartbeat timer wheel
+/// @return milliseconds on the monotonic clock divided by the tick length
+static uint64_t heartbeat_tick()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now).count() / HEARTBEAT_TICK_MS;
+}
+
+/// @brief work to be done by the thread tracking heartbeats of every KVS server
+/// @param arg unused
 /// @return void
-void *kvs_thread(void *arg)
+void *heartbeat_thread(void *arg)
 {
     /* -------------------- WORKER SETUP -------------------- */
-    // extract the client struct
-    struct kvs_args *kvs = (struct kvs_args *)arg;
-    kvs->alive = true;
-
-    // setup polling for KVS server
-    std::vector<struct pollfd> fds(1);
-    fds[0].fd = kvs->fd;
-    fds[0].events = POLLIN;   // awaiting POLLIN event
-    int timeout_msecs = 3000; // timeout 4000 milliseconds = 4 seconds
-    int ret;
-
-    while (true)
+    (void)arg; // unused
+    int epoll_fd = epoll_create1(0);
+    if (epoll_fd < 0)
     {
-        ret = poll(fds.data(), fds.size(), timeout_msecs);
-        // logger.log("Poll stopped <" + kvs->server_addr + "> " + std::to_string(ret), LOGGER_WARN);
-        if (ret > 0) // socket is ready to be read
-        {
-            // if events triggered, do stuff
-            if (fds[0].revents & POLLIN)
-            {
-                // read from fd
-                std::string command;
-                bool is_complete = false;
-                int bytes_recvd;
-                while (true)
-                {
-                    char buf[1024]; // size of buffer for CURRENT read
-                    bytes_recvd = recv(kvs->fd, buf, sizeof(buf), 0);
+        logger.log("Unable to create epoll instance for heartbeats (" + std::string(strerror(errno)) + ")", LOGGER_CRITICAL);
+        pthread_exit(NULL);
+    }
 
-                    // error while reading from source
-                    if (bytes_recvd < 0)
-                    {
-                        logger.log("Error reading from source", LOGGER_ERROR);
-                        break;
-                    }
-                    // check condition where connection was preemptively closed by source
-                    else if (bytes_recvd == 0)
-                    {
-                        logger.log("Remote socket closed connection", LOGGER_ERROR);
-                        break;
-                    }
+    std::unordered_map<int, struct kvs_connection> connections;                                  // open kvs connections keyed by fd
+    std::vector<std::vector<std::pair<int, uint64_t>>> wheel(HEARTBEAT_WHEEL_SLOTS);             // (fd, deadline tick) entries in the slot of their deadline
+    uint64_t timeout_ticks = (HEARTBEAT_TIMEOUT_MS + HEARTBEAT_TICK_MS - 1) / HEARTBEAT_TICK_MS; // timeout rounded up to whole ticks
+    uint64_t last_tick = heartbeat_tick();
 
-                    for (int i = 0; i < bytes_recvd; i++)
-                    {
-                        // check last index of coordinator's response for \r and curr index in buf for \n
-                        if (command.length() > 0 && command.back() == '\r' && buf[i] == '\n')
-                        {
-                            command.pop_back(); // delete \r in client message
-                            is_complete = true;
-                            break;
-                        }
-                        command.push_back(buf[i]);
-                    }
+    // pushes a connection's deadline forward - its previous wheel entry is left behind and skipped once its slot comes up
+    auto schedule = [&](int fd)
+    {
+        struct kvs_connection &connection = connections[fd];
+        connection.deadline_tick = heartbeat_tick() + timeout_ticks;
+        wheel[connection.deadline_tick % wheel.size()].push_back(std::make_pair(fd, connection.deadline_tick));
+    };
 
-                    if (is_complete)
-                    {
-                        break;
-                    }
-                }
+    // stops tracking a connection, e.g. after the kvs closed it
+    auto drop = [&](int fd)
+    {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+        close(fd);
+        connections.erase(fd);
+    };
 
-                // Received PING from KVS
-                if (command.compare("PING") == 0)
-                {
-                    logger.log("Received PING from " + kvs->server_addr, LOGGER_INFO);
-                    if (!kvs->alive)
-                    {
-                        // add alive server to client map
-                        client_map_mutex.lock();
-                        for (auto &key : kvs->kv_range)
-                        {
-                            client_map[key].push_back(*kvs);
-                        }
-                        client_map_mutex.unlock();
-
-                        // if cluster group is empty - no primary is set currently - assign this server as primary
-                        if (kvs_clusters[kvs->kvs_group].empty())
-                            kvs->primary = true;
-
-                        // add alive server to cluster group
-                        cluster_mutex.lock();
-                        kvs_clusters[kvs->kvs_group].push_back(*kvs);
-                        cluster_mutex.unlock();
-
-                        // broadcast updated server list and primary to all kvs in cluster
-                        broadcast_to_cluster(kvs->kvs_group);
-                        kvs->alive = true;
-                    }
-                }
-                // Received RECO from KVS
-                else if (command.compare("RECO") == 0)
-                {
-                    logger.log("Received RECO from " + kvs->server_addr, LOGGER_INFO);
-                    if (kvs->alive)
-                    {
-                        continue; // if kvs is already alive, do not process the below commands
-                    }
-                    else
-                    {
-                        send_kvs_reco(*kvs);
-                    }
-                }
-                else
-                {
-                    logger.log("Unrecognized command from KVS server - SIGINT to KVS " + kvs->server_addr + " likely received - ensure this is intentional", LOGGER_CRITICAL);
-                    break;
-                }
+    while (!SHUTDOWN)
+    {
+        // adopt kvs connections registered since the last pass
+        std::vector<struct kvs_args *> registered;
+        pending_kvs_mutex.lock();
+        registered.swap(pending_kvs);
+        pending_kvs_mutex.unlock();
+        for (struct kvs_args *kvs : registered)
+        {
+            struct epoll_event event;
+            event.events = EPOLLIN;
+            event.data.fd = kvs->fd;
+            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, kvs->fd, &event) < 0)
+            {
+                logger.log("Unable to track heartbeats of " + kvs->server_addr + " (" + strerror(errno) + ")", LOGGER_ERROR);
+                close(kvs->fd);
+                continue;
             }
+            connections[kvs->fd].kvs = kvs;
+            schedule(kvs->fd);
         }
-        else if (ret == -1) // failure occured
+
+        // wait at most one tick, so deadlines are checked on time even if no kvs sends anything
+        struct epoll_event events[64];
+        int ready = epoll_wait(epoll_fd, events, 64, HEARTBEAT_TICK_MS);
+        if (ready < 0 && errno != EINTR)
         {
-            logger.log("Polling socket for KVS " + kvs->client_addr + "/" + kvs->server_addr + "failed. (" + strerror(errno) + ")", LOGGER_ERROR);
+            logger.log("Polling KVS connections failed (" + std::string(strerror(errno)) + ")", LOGGER_ERROR);
             break;
         }
-        else // call timed out and no fds are ready to be read from
-        {
-            logger.log("KVS " + kvs->server_addr + " passed away", LOGGER_WARN);
-            if (!kvs->alive)
-                continue; // if kvs is already dead, do not process the below commands
 
-            // kvs is dead
-            kvs->alive = false;
+        /* -------------------- HEARTBEATS -------------------- */
+        for (int i = 0; i < ready; i++)
+        {
+            int fd = events[i].data.fd;
+            struct kvs_connection &connection = connections[fd];
+            struct kvs_args &kvs = *connection.kvs;
 
-            // remove dead server from client map
-            std::vector<struct kvs_args>::iterator position;
-            client_map_mutex.lock();
-            for (auto &key : kvs->kv_range)
+            char buf[1024];
+            int bytes_recvd = recv(fd, buf, sizeof(buf), 0);
+            if (bytes_recvd <= 0)
             {
-                for (size_t i = 0; i < client_map[key].size(); i++)
-                {
-                    if (client_map[key][i].client_addr.compare(kvs->client_addr) == 0)
-                    {
-                        position = client_map[key].begin() + i;
-                        break;
-                    }
-                }
-                client_map[key].erase(position);
+                // a closed connection means the kvs process is gone - no need to wait out the timeout
+                logger.log("Connection with KVS " + kvs.server_addr + " closed", LOGGER_WARN);
+                if (kvs.alive)
+                    mark_kvs_dead(kvs);
+                drop(fd);
+                continue;
             }
-            client_map_mutex.unlock();
+            connection.buffer.append(buf, bytes_recvd);
 
-            // remove dead server from cluster group
-            cluster_mutex.lock();
-            for (size_t i = 0; i < kvs_clusters[kvs->kvs_group].size(); i++)
+            // handle every complete command, any command counts as a heartbeat
+            size_t end;
+            bool recognized = true;
+            while (recognized && (end = connection.buffer.find("\r\n")) != std::string::npos)
             {
-                if (kvs_clusters[kvs->kvs_group][i].client_addr.compare(kvs->client_addr) == 0)
-                {
-                    position = kvs_clusters[kvs->kvs_group].begin() + i;
-                    break;
-                }
+                std::string command = connection.buffer.substr(0, end);
+                connection.buffer.erase(0, end + 2);
+                schedule(fd);
+                recognized = handle_kvs_command(kvs, command);
             }
-            kvs_clusters[kvs->kvs_group].erase(position);
-
-            // if current server was primary select a new primary
-            if (kvs->primary && !kvs_clusters[kvs->kvs_group].empty())
+            if (!recognized)
             {
-                // no longer primary
-                kvs->primary = false;
-
-                // assign new primary at random
-                size_t candidate = sample_index(kvs_clusters[kvs->kvs_group].size());
-                kvs_clusters[kvs->kvs_group][candidate].primary = true;
+                logger.log("Unrecognized command from KVS server - SIGINT to KVS " + kvs.server_addr + " likely received - ensure this is intentional", LOGGER_CRITICAL);
+                if (kvs.alive)
+                    mark_kvs_dead(kvs);
+                drop(fd);
             }
-            cluster_mutex.unlock();
+        }
 
-            // broadcast updated server list and primary to all kvs in cluster
-            if (!kvs_clusters[kvs->kvs_group].empty())
+        /* -------------------- FAILURE DETECTION -------------------- */
+        // visit every slot passed since the last pass (each slot at most once - entries further out stay for a later round)
+        uint64_t now = heartbeat_tick();
+        uint64_t first_tick = std::max(last_tick + 1, now + 1 - std::min<uint64_t>(now + 1, wheel.size()));
+        for (uint64_t tick = first_tick; tick <= now; tick++)
+        {
+            std::vector<std::pair<int, uint64_t>> &slot = wheel[tick % wheel.size()];
+            std::vector<std::pair<int, uint64_t>> pending;
+            for (auto &entry : slot)
             {
-                broadcast_to_cluster(kvs->kvs_group);
+                auto connection = connections.find(entry.first);
+                if (connection == connections.end() || connection->second.deadline_tick != entry.second)
+                    continue; // connection was dropped or its deadline was pushed forward since
+                if (entry.second > now)
+                {
+                    pending.push_back(entry);
+                    continue;
+                }
+
+                // kvs stays tracked, so it rejoins once heartbeats resume (e.g. after being revived by the admin console)
+                logger.log("KVS " + connection->second.kvs->server_addr + " passed away", LOGGER_WARN);
+                if (connection->second.kvs->alive)
+                    mark_kvs_dead(*connection->second.kvs);
             }
+            slot.swap(pending);
         }
+        last_tick = now;
     }
 
+    // clean up thread resources
+    for (auto &connection : connections)
+        close(connection.first);
+    close(epoll_fd);
+
     // detach self - notify kernel to reclaim resources
     if (SHUTDOWN != 1)
         pthread_detach(pthread_self());
-
-    // clean up thread resources
     MAP_MUTEX.lock();
     THREADS.erase(pthread_self());
     MAP_MUTEX.unlock();
-    close(kvs->fd);
 
     // shutdown thread
     int *status = 0;
     pthread_exit((void *)status);
 }
 
-/// @brief work to be done by thread servicing a request from a front-end server
-/// @param arg a void pointer
-/// @return void
-void *client_thread(void *arg)
+/// @brief hands an initialized kvs connection to the heartbeat thread
+/// @param kvs the kvs in kvs_intranet, with fd set to its connection
+void register_kvs(struct kvs_args &kvs)
 {
-    /* -------------------- WORKER SETUP -------------------- */
-    // extract the client struct
-    struct client_args *client = (struct client_args *)arg;
+    // adopted on the heartbeat thread's next pass (within one tick)
+    pending_kvs_mutex.lock();
+    pending_kvs.push_back(&kvs);
+    pending_kvs_mutex.unlock();
+}
 
-    int sent = 0;
-    if (VERBOSE)
-        logger.log("Received request from <" + client->addr + ">: " + client->request, LOGGER_INFO);
+/// @brief handles a command received on a kvs connection
+/// @param kvs the kvs that sent the command
+/// @param command command with its CRLF removed
+/// @return true if the command was recognized, false otherwise
+bool handle_kvs_command(struct kvs_args &kvs, const std::string &command)
+{
+    // Received PING from KVS (followed by its committed position CP#:SEQ#, which older servers leave out)
+    if (command.compare(0, 4, "PING") == 0 && (command.size() == 4 || command[4] == ' '))
+    {
+        LOGGER_LOG(logger, LOGGER_INFO, "Received PING from " + kvs.server_addr);
+        if (!kvs.alive)
+            mark_kvs_alive(kvs);
+        if (command.size() > 5)
+            record_kvs_position(kvs, command.substr(5));
+        return true;
+    }
+    // Received RECO from KVS
+    if (command.compare("RECO") == 0)
+    {
+        logger.log("Received RECO from " + kvs.server_addr, LOGGER_INFO);
+        // a kvs that stopped serving (e.g. to resync after diverging) recovers before it misses a heartbeat - drop it from its cluster first,
+        // so its primary tracks it as recovering, and it rejoins with its first PING
+        if (kvs.alive)
+            mark_kvs_dead(kvs);
+        send_kvs_reco(kvs);
+        return true;
+    }
+    return false;
+}
 
-    if ((client->request).length() > 0)
+/// @brief records the position a kvs reported with its heartbeat and re-elects the standby of its cluster
+/// @param kvs the kvs that sent the heartbeat
+/// @param position committed position of the kvs - CP#:SEQ#
+void record_kvs_position(struct kvs_args &kvs, const std::string &position)
+{
+    size_t colon = position.find(':');
+    if (colon == std::string::npos || colon == 0 || colon == position.size() - 1 || position.find_first_not_of("0123456789:") != std::string::npos)
     {
-        // assign appropriate kvs for given request by randomly sampling vector
-        char key = client->request[0];
-        client_map_mutex.lock_shared();
-        // std::string kvs_server = (client_map.count(key) ? client_map[key][sample_index(client_map[key].size())].client_addr : "-ERR First character non-alphabetical"); // TODO: UNCOMMENT THIS AND TEST
-        std::string kvs_server = (client_map.count(key) ? client_map[key][0].client_addr : "-ERR First character non-alphabetical"); // just select first kvs in vector
-        client_map_mutex.unlock_shared();
-        logger.log("KVS choice for " + std::string(1, key) + " is " + kvs_server, LOGGER_INFO);
+        logger.log("Malformed position <" + position + "> from " + kvs.server_addr, LOGGER_WARN);
+        return;
+    }
+    kvs.checkpoint = std::strtoul(position.c_str(), NULL, 10);
+    kvs.seq_num = std::strtoul(position.c_str() + colon + 1, NULL, 10);
 
-        // send response
-        if ((sent = send(client->fd, &kvs_server[0], kvs_server.size(), 0)) == -1)
+    cluster_mutex.lock();
+    for (auto &server : kvs_clusters[kvs.kvs_group])
+    {
+        if (server.server_addr.compare(kvs.server_addr) == 0)
         {
-            logger.log("Failed to send data (" + std::string(strerror(errno)) + ")", LOGGER_ERROR);
+            server.checkpoint = kvs.checkpoint;
+            server.seq_num = kvs.seq_num;
+            break;
         }
-        else
+    }
+    elect_standby(kvs.kvs_group);
+    cluster_mutex.unlock();
+}
+
+/// @brief checks if a kvs has committed more operations than another
+/// @return true if a is on a later checkpoint than b, or on the same checkpoint with a higher sequence number
+static bool is_ahead(const struct kvs_args &a, const struct kvs_args &b)
+{
+    return a.checkpoint > b.checkpoint || (a.checkpoint == b.checkpoint && a.seq_num > b.seq_num);
+}
+
+/// @brief marks the most caught-up secondary of a cluster as its standby (cluster_mutex must be held exclusively)
+/// @param group the cluster number
+/// @return index of the standby in the cluster, or -1 if the cluster has no secondaries
+int elect_standby(int group)
+{
+    std::vector<struct kvs_args> &cluster = kvs_clusters[group];
+    int standby = -1;
+    int current = -1;
+    for (size_t i = 0; i < cluster.size(); i++)
+    {
+        if (cluster[i].primary)
+            continue;
+        if (cluster[i].standby)
+            current = i;
+        if (standby < 0 || is_ahead(cluster[i], cluster[standby]))
+            standby = i;
+    }
+
+    // the current standby keeps its place unless another secondary is strictly ahead, so the choice doesn't flap between equally caught-up secondaries
+    if (current >= 0 && !is_ahead(cluster[standby], cluster[current]))
+        standby = current;
+    for (size_t i = 0; i < cluster.size(); i++)
+        cluster[i].standby = ((int)i == standby);
+
+    if (standby >= 0 && standby != current)
+        logger.log("Standby primary of G" + std::to_string(group) + " is " + cluster[standby].server_addr + " at " + std::to_string(cluster[standby].checkpoint) + ":" + std::to_string(cluster[standby].seq_num), LOGGER_INFO);
+    return standby;
+}
+
+/// @brief adds a kvs that resumed heartbeats back to the client map and its cluster and broadcasts the new cluster
+/// @param kvs the kvs that is alive again
+void mark_kvs_alive(struct kvs_args &kvs)
+{
+    // copy the entry under the intranet lock - a migration on the lookup thread rewrites kv_range in place
+    intranet_mutex.lock_shared();
+    struct kvs_args entry = kvs;
+    intranet_mutex.unlock_shared();
+
+    // add alive server to client map
+    client_map_mutex.lock();
+    for (auto &key : entry.kv_range)
+    {
+        client_map[key].push_back(entry);
+    }
+    client_map_mutex.unlock();
+
+    // if cluster group is empty - no primary is set currently - assign this server as primary
+    cluster_mutex.lock();
+    if (kvs_clusters[kvs.kvs_group].empty())
+        kvs.primary = entry.primary = true;
+
+    // add alive server to cluster group
+    kvs_clusters[kvs.kvs_group].push_back(entry);
+    elect_standby(kvs.kvs_group);
+    cluster_mutex.unlock();
+    publish_routing_snapshot();
+
+    // broadcast updated server list and primary to all kvs in cluster
+    broadcast_to_cluster(kvs.kvs_group);
+    kvs.alive = true;
+}
+
+/// @brief removes a dead kvs from the client map and its cluster, promoting the standby if it was the primary, and broadcasts the new cluster
+/// @param kvs the kvs that stopped sending heartbeats
+void mark_kvs_dead(struct kvs_args &kvs)
+{
+    // kvs is dead
+    kvs.alive = false;
+
+    // copy the range under the intranet lock - a migration on the lookup thread rewrites it in place
+    intranet_mutex.lock_shared();
+    std::string kv_range = kvs.kv_range;
+    intranet_mutex.unlock_shared();
+
+    // remove dead server from client map
+    client_map_mutex.lock();
+    for (auto &key : kv_range)
+    {
+        for (size_t i = 0; i < client_map[key].size(); i++)
         {
-            if (VERBOSE)
-                logger.log("Sent response to <" + client->addr + ">: " + kvs_server, LOGGER_INFO);
+            if (client_map[key][i].client_addr.compare(kvs.client_addr) == 0)
+            {
+                client_map[key].erase(client_map[key].begin() + i);
+                break;
+            }
         }
     }
+    client_map_mutex.unlock();
 
-    // clean up thread resources
-    MAP_MUTEX.lock();
-    THREADS.erase(pthread_self());
-    MAP_MUTEX.unlock();
-    close(client->fd);
+    // remove dead server from cluster group
+    cluster_mutex.lock();
+    std::vector<struct kvs_args> &cluster = kvs_clusters[kvs.kvs_group];
+    bool was_primary = false; // taken from the cluster, since kvs_intranet isn't updated when a standby is promoted
+    for (size_t i = 0; i < cluster.size(); i++)
+    {
+        if (cluster[i].client_addr.compare(kvs.client_addr) == 0)
+        {
+            was_primary = cluster[i].primary;
+            cluster.erase(cluster.begin() + i);
+            break;
+        }
+    }
+
+    // if current server was primary promote the standby - it has committed the most operations, so it can take writes right away
+    if (was_primary && !cluster.empty())
+    {
+        // no longer primary
+        kvs.primary = false;
+
+        int candidate = elect_standby(kvs.kvs_group);
+        cluster[candidate].primary = true;
+        cluster[candidate].standby = false;
+        logger.log("Promoted standby " + cluster[candidate].server_addr + " to primary of G" + std::to_string(kvs.kvs_group), LOGGER_WARN);
+
+        // elect the next standby among the remaining secondaries
+        elect_standby(kvs.kvs_group);
+    }
+    bool cluster_empty = cluster.empty();
+    cluster_mutex.unlock();
+    publish_routing_snapshot();
+
+    // broadcast updated server list and primary to all kvs in cluster
+    if (!cluster_empty)
+    {
+        broadcast_to_cluster(kvs.kvs_group);
+    }
+}
+
+/// @brief hands an accepted connection to the lookup thread, which reads and serves its first message
+/// @param fd the accepted connection
+/// @param addr ip:port of the peer
+void register_connection(int fd, const std::string &addr)
+{
+    struct client_args *client = new client_args();
+    client->addr = addr;
+    client->fd = fd;
+
+    // epoll_ctl is safe to call while the lookup thread waits, so the connection is polled right away
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = client;
+    if (epoll_ctl(lookup_epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+    {
+        logger.log("Unable to poll connection from <" + addr + "> (" + strerror(errno) + ")", LOGGER_ERROR);
+        close(fd);
+        delete client;
+    }
+}
+
+/// @brief work to be done by the thread serving front-end lookups and reading the first message of every connection
+/// @param arg unused
+/// @return void
+void *lookup_thread(void *arg)
+{
+    /* -------------------- WORKER SETUP -------------------- */
+    (void)arg; // unused
+    std::vector<char> buf(MAX_REQUEST);
+
+    while (!SHUTDOWN)
+    {
+        struct epoll_event events[64];
+        int ready = epoll_wait(lookup_epoll_fd, events, 64, -1);
+        if (ready < 0 && errno != EINTR)
+        {
+            logger.log("Polling lookup connections failed (" + std::string(strerror(errno)) + ")", LOGGER_ERROR);
+            break;
+        }
+
+        /* -------------------- LOOKUPS -------------------- */
+        for (int i = 0; i < ready; i++)
+        {
+            struct client_args *client = (struct client_args *)events[i].data.ptr;
+
+            // a connection stays open only while it is a persistent front-end connection that keeps sending valid frames
+            int bytes_recvd = recv(client->fd, &buf[0], buf.size(), 0);
+            bool keep_open = false;
+            if (bytes_recvd > 0)
+            {
+                client->request.append(&buf[0], bytes_recvd);
+                keep_open = client->persistent ? answer_lookup_frames(*client) : handle_first_message(*client);
+            }
+            if (keep_open)
+                continue;
+
+            // fd is -1 once the connection was handed to the heartbeat thread
+            if (client->fd != -1)
+            {
+                epoll_ctl(lookup_epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+                close(client->fd);
+            }
+            if (VERBOSE && client->persistent)
+                logger.log("Closed lookup connection with <" + client->addr + ">", LOGGER_INFO);
+            delete client;
+        }
+    }
+
+    // clean up thread resources (connections still open are closed when the process exits)
+    close(lookup_epoll_fd);
 
     // detach self - notify kernel to reclaim resources
     if (SHUTDOWN != 1)
         pthread_detach(pthread_self());
+    MAP_MUTEX.lock();
+    THREADS.erase(pthread_self());
+    MAP_MUTEX.unlock();
 
     // shutdown thread
     int *status = 0;
     pthread_exit((void *)status);
 }
 
+/// @brief handles the first message received on a connection (kvs INIT, MIGR, lookup hello or one-shot lookup)
+/// @param client the connection, with request holding the message
+/// @return true if the connection stays open for lookups, false if it should be closed (fd is set to -1 if it was handed off)
+bool handle_first_message(struct client_args &client)
+{
+    std::string &request = client.request;
+
+    // Check for MIGR from a KVS primary that finished streaming a key range to another cluster
+    if (request.compare(0, 4, "MIGR") == 0)
+    {
+        std::string response = migrate_key_range(request);
+        if (send(client.fd, &response[0], response.size(), 0) == -1)
+        {
+            logger.log("Failed to send data (" + std::string(strerror(errno)) + ")", LOGGER_ERROR);
+        }
+        return false;
+    }
+
+    // Check for INIT from a KVS server (comes with source address in message)
+    if (request.compare(0, 4, "INIT") == 0)
+    {
+        std::string source = request.substr(5, request.size() - 7);
+        logger.log(source, LOGGER_DEBUG);
+
+        // get kvs associated with this connection
+        intranet_mutex.lock_shared();
+        kvs_args &kvs = kvs_intranet.at(source); // retrieve reference to kvs from map, since we're updating its fd (and this should be retained in the map)
+        intranet_mutex.unlock_shared();
+
+        // a kvs still in its cluster is alive from the start - one that was declared dead rejoins on its first PING
+        kvs.fd = client.fd;
+        kvs.alive = false;
+        cluster_mutex.lock();
+        for (size_t i = 0; i < kvs_clusters[kvs.kvs_group].size(); i++)
+        {
+            if (kvs_clusters[kvs.kvs_group][i].server_addr.compare(kvs.server_addr) == 0)
+            {
+                kvs.alive = true;
+                kvs_clusters[kvs.kvs_group][i].fd = client.fd;
+                break;
+            }
+        }
+        cluster_mutex.unlock();
+        publish_routing_snapshot();
+
+        // send init response to kvs and let the heartbeat thread track the connection from now on
+        epoll_ctl(lookup_epoll_fd, EPOLL_CTL_DEL, client.fd, NULL);
+        if (send_kvs_init(kvs, request))
+        {
+            register_kvs(kvs);
+            client.fd = -1;
+        }
+        return false;
+    }
+
+    logger.log(client.addr, LOGGER_DEBUG);
+
+    // persistent front-end connection - served until the front end disconnects, frames sent along with the hello are answered right away
+    if (request.compare(0, LOOKUP_HELLO.size(), LOOKUP_HELLO) == 0)
+    {
+        if (VERBOSE)
+            logger.log("Opened lookup connection with <" + client.addr + ">", LOGGER_INFO);
+        client.persistent = true;
+        request.erase(0, LOOKUP_HELLO.size());
+        return answer_lookup_frames(client);
+    }
+
+    // one-shot lookup from an older client
+    if (VERBOSE)
+        logger.log("Received request from <" + client.addr + ">: " + request, LOGGER_INFO);
+
+    // assign appropriate kvs for given request
+    bool found;
+    uint64_t version;
+    std::string kvs_server = lookup_kvs(request, found, version);
+    LOGGER_LOG(logger, LOGGER_INFO, "KVS choice for " + std::string(1, request[0]) + " is " + kvs_server);
+
+    // send response
+    if (send(client.fd, &kvs_server[0], kvs_server.size(), 0) == -1)
+    {
+        logger.log("Failed to send data (" + std::string(strerror(errno)) + ")", LOGGER_ERROR);
+    }
+    else
+    {
+        if (VERBOSE)
+            logger.log("Sent response to <" + client.addr + ">: " + kvs_server, LOGGER_INFO);
+    }
+    return false;
+}
+
+/// @brief answers every complete lookup frame received on a persistent front-end connection with a single send
+/// @param client the connection, with request holding the bytes received that weren't answered yet
+/// @return true if the connection stays open, false if a frame was malformed or the response couldn't be sent
+bool answer_lookup_frames(struct client_args &client)
+{
+    std::string &buffer = client.request;
+    std::string responses;
+    size_t offset = 0;
+    bool malformed = false;
+    while (buffer.size() - offset >= 4)
+    {
+        uint32_t length;
+        memcpy(&length, &buffer[offset], 4);
+        length = ntohl(length);
+        if (length == 0 || length > (uint32_t)MAX_REQUEST)
+        {
+            malformed = true;
+            break;
+        }
+        if (buffer.size() - offset - 4 < length)
+            break; // wait for rest of frame
+
+        bool found;
+        uint64_t version;
+        std::string kvs_server = lookup_kvs(buffer.substr(offset + 4, length), found, version);
+        uint32_t response_length = htonl(kvs_server.size() + 9);
+        responses.append((char *)&response_length, 4);
+        responses.push_back(found ? '+' : '-');
+        for (int shift = 56; shift >= 0; shift -= 8)
+            responses.push_back((char)(version >> shift));
+        responses += kvs_server;
+        offset += 4 + length;
+    }
+    buffer.erase(0, offset);
+
+    if (malformed)
+    {
+        logger.log("Malformed lookup frame from <" + client.addr + "> - closing connection", LOGGER_ERROR);
+        return false;
+    }
+
+    // responses are small, so a front end that keeps reading them never makes this wait for long
+    size_t sent = 0;
+    while (sent < responses.size())
+    {
+        int bytes_sent = send(client.fd, &responses[sent], responses.size() - sent, 0);
+        if (bytes_sent < 0 && errno == EINTR)
+            continue;
+        if (bytes_sent < 0)
+            break;
+        sent += bytes_sent;
+    }
+    if (sent < responses.size())
+    {
+        logger.log("Failed to send data (" + std::string(strerror(errno)) + ")", LOGGER_ERROR);
+        return false;
+    }
+    return true;
+}
+
+/// @brief looks up the kvs responsible for a path in the current routing snapshot (does not lock)
+/// @param path file/folder path whose first character selects the kvs
+/// @param found set to true if a kvs was found, false otherwise
+/// @param version set to the version of the snapshot the lookup was answered from
+/// @return the client-facing address of the kvs, or an error message if none was found
+std::string lookup_kvs(const std::string &path, bool &found, uint64_t &version)
+{
+    routing_guard guard;
+    const std::string &kvs_server = guard.snapshot->kvs_addrs[(unsigned char)path[0]];
+    version = guard.snapshot->version;
+    found = !kvs_server.empty();
+    return found ? kvs_server : "-ERR First character non-alphabetical or no KVS available";
+}
+
+/// @brief the calling thread's reader slot, handed back when the thread exits
+struct routing_reader
+{
+    int slot = -1; // claimed reader slot (-1 if none was free)
+    int depth = 0; // guards currently alive on this thread (only the outermost pins and unpins)
+
+    ~routing_reader()
+    {
+        if (slot >= 0)
+            reader_slot_used[slot].store(false, std::memory_order_release);
+    }
+};
+
+/// @brief returns the calling thread's reader, claiming a free slot if it isn't reading already
+static routing_reader &thread_reader()
+{
+    static thread_local routing_reader reader;
+    for (int i = 0; reader.slot < 0 && reader.depth == 0 && i < MAX_ROUTING_READERS; i++)
+    {
+        bool used = false;
+        if (reader_slot_used[i].compare_exchange_strong(used, true))
+            reader.slot = i;
+    }
+    return reader;
+}
+
+routing_guard::routing_guard()
+{
+    routing_reader &reader = thread_reader();
+    if (reader.depth++ == 0)
+    {
+        // announce the epoch before loading the pointer (both seq_cst): a publisher that replaces the loaded snapshot
+        // afterwards advances the epoch past the pinned one and so sees the pin when it scans the reader slots
+        if (reader.slot >= 0)
+            reader_epochs[reader.slot].store(routing_epoch.load());
+        else
+            routing_mutex.lock(); // no free slot - hold off reclamation by holding the publisher lock instead
+    }
+    snapshot = routing.load();
+}
+
+routing_guard::~routing_guard()
+{
+    routing_reader &reader = thread_reader();
+    if (--reader.depth == 0)
+    {
+        if (reader.slot >= 0)
+            reader_epochs[reader.slot].store(0, std::memory_order_release);
+        else
+            routing_mutex.unlock();
+    }
+}
+
+/// @brief rebuilds the routing snapshot from the client map and kvs clusters and publishes it to readers (must be called after every client map or cluster update)
+void publish_routing_snapshot()
+{
+    std::lock_guard<std::mutex> publish_lock(routing_mutex);
+
+    routing_snapshot *snapshot = new routing_snapshot();
+    client_map_mutex.lock_shared();
+    for (auto &key : client_map)
+    {
+        // std::string kvs_server = client_map[key][sample_index(client_map[key].size())].client_addr; // TODO: UNCOMMENT THIS AND TEST
+        if (!key.second.empty())
+            snapshot->kvs_addrs[(unsigned char)key.first] = key.second[0].client_addr; // just select first kvs in vector
+    }
+    client_map_mutex.unlock_shared();
+    cluster_mutex.lock_shared();
+    snapshot->clusters = kvs_clusters;
+    cluster_mutex.unlock_shared();
+
+    // version only moves when a key is routed to a different kvs, so cluster-only changes don't invalidate front end caches
+    // (publishers are serialized, so the current snapshot can be read without pinning it)
+    const routing_snapshot *current = routing.load();
+    snapshot->version = current == nullptr ? 1 : current->version;
+    for (int key = 0; current != nullptr && key < 256; key++)
+    {
+        if (snapshot->kvs_addrs[key] != current->kvs_addrs[key])
+        {
+            snapshot->version++;
+            break;
+        }
+    }
+
+    // readers that pin the new epoch (or later) can only load the new snapshot
+    const routing_snapshot *old_snapshot = routing.exchange(snapshot);
+    uint64_t retire_epoch = routing_epoch.fetch_add(1) + 1;
+    if (old_snapshot != nullptr)
+        retired_snapshots.push_back(std::make_pair(retire_epoch, old_snapshot));
+
+    // free retired snapshots replaced before the oldest epoch still pinned by a reader
+    uint64_t oldest_pinned = UINT64_MAX;
+    for (int i = 0; i < MAX_ROUTING_READERS; i++)
+    {
+        uint64_t epoch = reader_epochs[i].load();
+        if (epoch != 0)
+            oldest_pinned = std::min(oldest_pinned, epoch);
+    }
+    auto reclaimable = std::partition(retired_snapshots.begin(), retired_snapshots.end(), [oldest_pinned](const std::pair<uint64_t, const routing_snapshot *> &retired)
+                                      { return retired.first > oldest_pinned; });
+    for (auto it = reclaimable; it != retired_snapshots.end(); it++)
+        delete it->second;
+    retired_snapshots.erase(reclaimable, retired_snapshots.end());
+}
+
 /// @brief randomly sample an index between [0, length)
 /// @param length the upper bound of the sampling range (exclusive)
 /// @return a random index in range [0, length)
@@ -716,21 +1191,24 @@ size_t sample_index(size_t length)
 /// @brief constructs a specialized message for the given kvs
 /// @param kvs an address of a kvs_args struct
 /// @return a message to be sent back to the kvs
-std::string get_kvs_message(struct kvs_args &kvs)
+std::string get_kvs_message(const struct kvs_args &kvs)
 {
     // construct message
     std::string response = std::string(1, kvs.kv_range[0]) + ":" + std::string(1, kvs.kv_range.back()) + " "; // add key value range to message
     std::string secondaries = "";
 
-    cluster_mutex.lock_shared();
-    for (auto &server : kvs_clusters[kvs.kvs_group])
+    routing_guard guard;
+    auto cluster = guard.snapshot->clusters.find(kvs.kvs_group);
+    if (cluster != guard.snapshot->clusters.end())
     {
-        if (server.primary)
-            response += server.server_addr + " "; // add primary to message
-        else
-            secondaries += server.server_addr + " "; // create list of secondaries
+        for (auto &server : cluster->second)
+        {
+            if (server.primary)
+                response += server.server_addr + " "; // add primary to message
+            else
+                secondaries += server.server_addr + " "; // create list of secondaries
+        }
     }
-    cluster_mutex.unlock_shared();
 
     secondaries.pop_back();           // remove final trailing whitespace from message
     response += secondaries + "\r\n"; // add secondaries to message with terminating CRLF
@@ -741,21 +1219,24 @@ std::string get_kvs_message(struct kvs_args &kvs)
 /// @brief constructs a specialized message for the given kvs
 /// @param kvs an address of a kvs_args struct
 /// @return a message to be sent back to the kvs
-std::string get_kvs_broadcast_message(struct kvs_args &kvs)
+std::string get_kvs_broadcast_message(const struct kvs_args &kvs)
 {
     // construct message
     std::string response = "";
     std::string secondaries = "";
 
-    cluster_mutex.lock_shared();
-    for (auto &server : kvs_clusters[kvs.kvs_group])
+    routing_guard guard;
+    auto cluster = guard.snapshot->clusters.find(kvs.kvs_group);
+    if (cluster != guard.snapshot->clusters.end())
     {
-        if (server.primary)
-            response += server.server_addr + " "; // add primary to message
-        else
-            secondaries += server.server_addr + " "; // create list of secondaries
+        for (auto &server : cluster->second)
+        {
+            if (server.primary)
+                response += server.server_addr + " "; // add primary to message
+            else
+                secondaries += server.server_addr + " "; // create list of secondaries
+        }
     }
-    cluster_mutex.unlock_shared();
 
     // secondaries in message
     if (!secondaries.empty())
@@ -775,10 +1256,14 @@ std::string get_kvs_broadcast_message(struct kvs_args &kvs)
 /// @param group the cluster number of the calling kvs
 void broadcast_to_cluster(int group)
 {
-    cluster_mutex.lock_shared();
-    std::string message = get_kvs_broadcast_message(kvs_clusters[group][0]);
+    // members are taken from the routing snapshot, so sends don't hold up failover bookkeeping
+    routing_guard guard;
+    auto cluster = guard.snapshot->clusters.find(group);
+    if (cluster == guard.snapshot->clusters.end() || cluster->second.empty())
+        return;
+    std::string message = get_kvs_broadcast_message(cluster->second[0]);
 
-    for (auto &kvs : kvs_clusters[group])
+    for (auto &kvs : cluster->second)
     {
         int bytes_sent = send(kvs.fd, (char *)message.c_str(), message.length(), 0);
         while (bytes_sent != message.length())
@@ -793,7 +1278,6 @@ void broadcast_to_cluster(int group)
 
         logger.log("Message broadcasted to <" + kvs.server_addr + ">", LOGGER_INFO);
     }
-    cluster_mutex.unlock_shared();
 }
 
 /// @brief constructs message to be sent to admin HTTP server
@@ -802,8 +1286,8 @@ std::string get_admin_message()
 {
     std::string message = "C ";
 
-    cluster_mutex.lock_shared();
-    for (auto &cluster : kvs_clusters)
+    routing_guard guard;
+    for (auto &cluster : guard.snapshot->clusters)
     {
         // add group number
         message += "SG" + std::to_string(cluster.first) + ": ";
@@ -834,7 +1318,6 @@ std::string get_admin_message()
         // add cluster of servers to message
         message += temp + "\n";
     }
-    cluster_mutex.unlock_shared();
 
     message.pop_back();
     message += "\r\n"; // add terminating characters
@@ -880,14 +1363,16 @@ bool send_kvs_reco(struct kvs_args &kvs)
     int sent = 0;
     std::string response = "";
 
-    if (kvs_clusters[kvs.kvs_group].empty())
+    routing_guard guard;
+    auto cluster = guard.snapshot->clusters.find(kvs.kvs_group);
+    if (cluster == guard.snapshot->clusters.end() || cluster->second.empty())
     {
         response = kvs.server_addr + "\r\n";
     }
     else
     {
         // construct message
-        for (auto &server : kvs_clusters[kvs.kvs_group])
+        for (auto &server : cluster->second)
         {
             if (server.primary)
             {
@@ -910,4 +1395,94 @@ bool send_kvs_reco(struct kvs_args &kvs)
     }
 
     return successful;
-}
\ No newline at end of file
+}
+/// @brief moves ownership of a key range from one kvs cluster to another after a tablet migration
+/// @param request - MIGR request of the form "MIGR <source server addr> <start>:<end> <target server addr>"
+/// @return "+OK\r\n" if successful, "-ER <reason>\r\n" otherwise
+std::string migrate_key_range(std::string &request)
+{
+    // strip trailing CRLF and split request into its components
+    if (request.size() >= 2 && request.substr(request.size() - 2).compare("\r\n") == 0)
+        request.resize(request.size() - 2);
+    std::vector<std::string> tokens = Utils::split(request, " ");
+    if (tokens.size() != 4 || tokens[2].size() != 3 || tokens[2][1] != ':' || tokens[2][0] > tokens[2][2])
+    {
+        logger.log("Malformed migration request: " + request, LOGGER_ERROR);
+        return "-ER Malformed migration request\r\n";
+    }
+    std::string source_addr = tokens[1];
+    std::string target_addr = tokens[3];
+    char start = tokens[2][0];
+    char end = tokens[2][2];
+
+    // locate source and target clusters and ensure source owns the entire range
+    intranet_mutex.lock();
+    if (kvs_intranet.count(source_addr) == 0 || kvs_intranet.count(target_addr) == 0)
+    {
+        intranet_mutex.unlock();
+        logger.log("Unknown KVS server in migration request: " + request, LOGGER_ERROR);
+        return "-ER Unknown KVS server\r\n";
+    }
+    int source_group = kvs_intranet[source_addr].kvs_group;
+    int target_group = kvs_intranet[target_addr].kvs_group;
+    std::string &source_range = kvs_intranet[source_addr].kv_range;
+    bool owns_range = true;
+    for (char key = start; key <= end; key++)
+    {
+        owns_range = owns_range && source_range.find(key) != std::string::npos;
+    }
+    if (source_group == target_group || !owns_range)
+    {
+        intranet_mutex.unlock();
+        logger.log("Invalid migration request: " + request, LOGGER_ERROR);
+        return "-ER Invalid migration range or target\r\n";
+    }
+
+    // update key value range of every server in both clusters (the heartbeat thread copies it under this lock to maintain the client map)
+    for (auto &kvs : kvs_intranet)
+    {
+        std::string &range = kvs.second.kv_range;
+        if (kvs.second.kvs_group == source_group)
+        {
+            range.erase(std::remove_if(range.begin(), range.end(), [start, end](char key)
+                                       { return key >= start && key <= end; }),
+                        range.end());
+        }
+        else if (kvs.second.kvs_group == target_group)
+        {
+            for (char key = start; key <= end; key++)
+                range.push_back(key);
+            std::sort(range.begin(), range.end());
+        }
+    }
+    std::string source_kv_range = source_range;
+    std::string target_kv_range = kvs_intranet[target_addr].kv_range;
+    intranet_mutex.unlock();
+
+    // update copies of the ranges held by each cluster and collect alive servers of target cluster (primary first)
+    std::vector<struct kvs_args> owners;
+    cluster_mutex.lock();
+    for (auto &kvs : kvs_clusters[source_group])
+        kvs.kv_range = source_kv_range;
+    for (auto &kvs : kvs_clusters[target_group])
+    {
+        kvs.kv_range = target_kv_range;
+        if (kvs.primary)
+            owners.insert(owners.begin(), kvs);
+        else
+            owners.push_back(kvs);
+    }
+    cluster_mutex.unlock();
+
+    // route keys in range to target cluster
+    client_map_mutex.lock();
+    for (char key = start; key <= end; key++)
+    {
+        client_map[key] = owners;
+    }
+    client_map_mutex.unlock();
+    publish_routing_snapshot();
+
+    logger.log("Migrated " + tokens[2] + " from G" + std::to_string(source_group) + " to G" + std::to_string(target_group), LOGGER_INFO);
+    return "+OK\r\n";
+}
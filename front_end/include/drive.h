@@ -23,7 +23,7 @@
 
 void open_filefolder(const HttpRequest& req, HttpResponse& res);
 
-void upload_file(const HttpRequest& req, HttpResponse& res);
+std::shared_ptr<BodyHandler> upload_file(const HttpRequest& req);
 
 void create_folder(const HttpRequest& req, HttpResponse& res);
 
@@ -65,7 +65,8 @@ void signup_handler(const HttpRequest &req, HttpResponse &res)
         return;
     }
 
-    bool present = HttpServer::check_kvs_addr(username);
+    uint64_t kvs_version = FeUtils::routing_version(); // routing version the address is cached under
+    bool present = HttpServer::check_kvs_addr(username, kvs_version);
     std::vector<std::string> kvs_addr;
 
     // check if we know already know the KVS server address for user
@@ -77,7 +78,7 @@ void signup_handler(const HttpRequest &req, HttpResponse &res)
     else
     {
         // query the coordinator for the KVS server address
-        kvs_addr = FeUtils::query_coordinator(username);
+        kvs_addr = FeUtils::query_coordinator(username, kvs_version);
     }
 
     // create socket for communication with KVS server
@@ -110,7 +111,7 @@ void signup_handler(const HttpRequest &req, HttpResponse &res)
         kvs_res = FeUtils::kv_put(kvs_sock, row_key, welcome_email[0], welcome_email[1]);
 
         // cache kvs server for user
-        HttpServer::set_kvs_addr(username, kvs_addr[0] + ":" + kvs_addr[1]);
+        HttpServer::set_kvs_addr(username, kvs_addr[0] + ":" + kvs_addr[1], kvs_version);
 
         // set cookies
         FeUtils::set_cookies(res, username, sid);
@@ -176,7 +177,8 @@ void login_handler(const HttpRequest &req, HttpResponse &res)
     // parse username and password from request body
     std::string username = Utils::trim(Utils::split(req_body[0], "=")[1]);
     std::string password = Utils::trim(Utils::split(req_body[1], "=")[1]);
-    bool present = HttpServer::check_kvs_addr(username);
+    uint64_t kvs_version = FeUtils::routing_version(); // routing version the address is cached under
+    bool present = HttpServer::check_kvs_addr(username, kvs_version);
     std::vector<std::string> kvs_addr;
 
     // check if we know already know the KVS server address for user
@@ -188,7 +190,7 @@ void login_handler(const HttpRequest &req, HttpResponse &res)
     else
     {
         // query the coordinator for the KVS server address
-        kvs_addr = FeUtils::query_coordinator(username);
+        kvs_addr = FeUtils::query_coordinator(username, kvs_version);
     }
 
     // create socket for communication with KVS server
@@ -199,7 +201,7 @@ void login_handler(const HttpRequest &req, HttpResponse &res)
     {
         // if not present, set cache
         if (!present)
-            HttpServer::set_kvs_addr(username, kvs_addr[0] + ":" + kvs_addr[1]);
+            HttpServer::set_kvs_addr(username, kvs_addr[0] + ":" + kvs_addr[1], kvs_version);
 
         // generate random SID
         std::string sid = generate_sid();
@@ -678,7 +680,7 @@ void logout_handler(const HttpRequest &req, HttpResponse &res)
         sid = cookies["sid"];
 
         // check if user exists in cache
-        bool present = HttpServer::check_kvs_addr(username);
+        bool present = HttpServer::check_kvs_addr(username, FeUtils::routing_version());
         std::vector<std::string> kvs_addr;
 
         // get the KVS server address for user associated with the request
@@ -749,7 +751,8 @@ void update_password_handler(const HttpRequest &req, HttpResponse &res)
         std::string sid = cookies["sid"];
 
         // check if user exists in cache
-        bool present = HttpServer::check_kvs_addr(username);
+        uint64_t kvs_version = FeUtils::routing_version(); // routing version the address is cached under
+        bool present = HttpServer::check_kvs_addr(username, kvs_version);
         std::vector<std::string> kvs_addr;
 
         // get the KVS server address for user associated with the request
@@ -761,7 +764,7 @@ void update_password_handler(const HttpRequest &req, HttpResponse &res)
         else
         {
             // query the coordinator for the KVS server address
-            kvs_addr = FeUtils::query_coordinator(username);
+            kvs_addr = FeUtils::query_coordinator(username, kvs_version);
         }
 
         // create socket for communication with KVS server
@@ -792,7 +795,7 @@ void update_password_handler(const HttpRequest &req, HttpResponse &res)
 
             // if not present, set cache
             if (!present)
-                HttpServer::set_kvs_addr(username, kvs_addr[0] + ":" + kvs_addr[1]);
+                HttpServer::set_kvs_addr(username, kvs_addr[0] + ":" + kvs_addr[1], kvs_version);
 
             // set cookies on response
             FeUtils::set_cookies(res, username, sid);
@@ -13,6 +13,8 @@ vector<char> err_vec = {'-', 'E', 'R', ' '};
 
 Logger logger("Drive");
 
+const size_t download_piece_size = 1024 * 1024; // bytes of a file read from the KVS per request while streaming a download
+
 // helper to return parent path
 string split_parent_filename(const vector<string> &vec, string &filename)
 {
@@ -278,6 +280,89 @@ bool rename_subfolders(int fd, vector<char> parent_folder, vector<char> new_fold
     }
 }
 
+// parses a single "bytes=" range against a file of file_size bytes into [range_start, range_end)
+// returns 1 if range is valid, 0 if it should be ignored (whole file is sent), -1 if it can't be satisfied
+int parse_byte_range(const string &range_header, size_t file_size, size_t &range_start, size_t &range_end)
+{
+    string range = Utils::trim(range_header);
+    if (range.compare(0, 6, "bytes=") != 0)
+    {
+        return 0;
+    }
+    range = range.substr(6);
+    size_t dash = range.find('-');
+    if (dash == string::npos)
+    {
+        return 0;
+    }
+    string first = Utils::trim(range.substr(0, dash));
+    string last = Utils::trim(range.substr(dash + 1));
+
+    try
+    {
+        // suffix range (bytes=-N) - last N bytes of file
+        if (first.empty())
+        {
+            size_t suffix_len = std::stoul(last);
+            if (suffix_len == 0 || file_size == 0)
+            {
+                return -1;
+            }
+            range_start = file_size - std::min(suffix_len, file_size);
+            range_end = file_size;
+            return 1;
+        }
+
+        range_start = std::stoul(first);
+        // open-ended range (bytes=N-) or range clamped to end of file (bytes=N-M)
+        range_end = last.empty() ? file_size : std::min(std::stoul(last) + 1, file_size);
+    }
+    catch (const std::exception &e)
+    {
+        return 0;
+    }
+
+    if (range_start >= file_size)
+    {
+        return -1;
+    }
+    return range_start < range_end ? 1 : 0;
+}
+
+// writes bytes [range_start, range_end) of a file to the client, reading it from the KVS a piece at a time
+void stream_file_range(const vector<string> &kvs_addr, const vector<char> &parent_path_vec, const vector<char> &filename_vec, size_t range_start, size_t range_end, const BodyWriter &write)
+{
+    int kvs_fd = FeUtils::open_socket(kvs_addr[0], std::stoi(kvs_addr[1]));
+    if (kvs_fd < 0)
+    {
+        logger.log("Unable to connect to KVS to stream file", 40);
+        return;
+    }
+
+    size_t offset = range_start;
+    while (offset < range_end)
+    {
+        vector<char> piece = FeUtils::kv_get_range(kvs_fd, parent_path_vec, filename_vec, offset, std::min(download_piece_size, range_end - offset));
+        size_t file_size = 0;
+        size_t data_start = 0;
+
+        // file was removed/truncated or KVS failed - stop and let the server close the connection on the short body
+        if (!FeUtils::kv_parse_range(piece, file_size, data_start) || data_start >= piece.size())
+        {
+            logger.log("Failed to read file piece at offset " + std::to_string(offset) + " from KVS", 40);
+            break;
+        }
+
+        size_t piece_len = std::min(piece.size() - data_start, range_end - offset);
+        if (!write(piece.data() + data_start, piece_len))
+        {
+            break;
+        }
+        offset += piece_len;
+    }
+    close(kvs_fd);
+}
+
 // Handler opens a file or folder and displays html.
 // This is the landing page for drive that the user cna interact with
 // there are no other get requests
@@ -295,7 +380,7 @@ void open_filefolder(const HttpRequest &req, HttpResponse &res)
         // path is drive/:childpath where parent dir is the page that is being displayed
         string childpath_str = req.path.substr(7);
         vector<char> child_path(childpath_str.begin(), childpath_str.end());
-        bool present = HttpServer::check_kvs_addr(username);
+        bool present = HttpServer::check_kvs_addr(username, FeUtils::routing_version());
         std::vector<std::string> kvs_addr;
 
         // check if we know already know the KVS server address for user
@@ -331,7 +416,8 @@ void open_filefolder(const HttpRequest &req, HttpResponse &res)
         if (is_folder(child_path))
         {
 
-            vector<char> folder_content = FeUtils::kv_get_row(sockfd, child_path);
+            // fenced behind the user's last write, so a listing after upload/create/delete/move reflects it
+            vector<char> folder_content = FeUtils::kv_get_row(sockfd, child_path, cookies["kvpos"]);
 
             if (FeUtils::kv_success(folder_content))
             {
@@ -370,7 +456,7 @@ void open_filefolder(const HttpRequest &req, HttpResponse &res)
 
                     vector<char> grandparent_vec(grandparent_path.begin(), grandparent_path.end());
 
-                    vector<char> grandparent_folder = FeUtils::kv_get_row(sockfd, grandparent_vec);
+                    vector<char> grandparent_folder = FeUtils::kv_get_row(sockfd, grandparent_vec, cookies["kvpos"]);
                     if (FeUtils::kv_success(grandparent_folder))
                     {
                         grandparent_folder.erase(grandparent_folder.begin(), grandparent_folder.begin() + 4);
@@ -401,7 +487,7 @@ void open_filefolder(const HttpRequest &req, HttpResponse &res)
                             vector<char> item_vec(item.begin(), item.end());
                             vector<char> item_path = child_path;
                             item_path.insert(item_path.end(), item_vec.begin(), item_vec.end());
-                            vector<char> sibling_items = FeUtils::kv_get_row(sockfd, item_path);
+                            vector<char> sibling_items = FeUtils::kv_get_row(sockfd, item_path, cookies["kvpos"]);
                             if (FeUtils::kv_success(sibling_items))
                             {
                                 sibling_items.erase(sibling_items.begin(), sibling_items.begin() + 4);
@@ -846,29 +932,42 @@ void open_filefolder(const HttpRequest &req, HttpResponse &res)
             filename = FeUtils::urlDecode(filename);
             std::vector<char> filename_vec(filename.begin(), filename.end());
 
-            // get file content
-            std::vector<char> file_content = FeUtils::kv_get(sockfd, parent_path_vec, filename_vec);
-            if (FeUtils::kv_success(file_content))
+            // read size of file (a length of 0 only returns the size)
+            std::vector<char> size_resp = FeUtils::kv_get_range(sockfd, parent_path_vec, filename_vec, 0, 0);
+            size_t file_size = 0;
+            size_t data_start = 0;
+            if (FeUtils::kv_parse_range(size_resp, file_size, data_start))
             {
-                // get binary from 4th char onward (ignore +OK<sp>)
-                std::vector<char> file_binary(file_content.begin() + 4, file_content.end());
+                // byte range [range_start, range_end) of file to send - whole file unless a single range was requested
+                size_t range_start = 0;
+                size_t range_end = file_size;
+                std::vector<std::string> range_vals = req.get_header("Range");
+                int range_status = range_vals.size() == 1 ? parse_byte_range(range_vals[0], file_size, range_start, range_end) : 0;
 
-                // apend to body
-                res.append_body_bytes(file_binary.data(), file_binary.size());
-
-                // // octet-steam for content header @todo -- setting this type means postman can't see it
-                // std::string content_header = "Content-Type";
-                // std::string content_value = "application/octet-stream";
-                // res.set_header(content_header, content_value);
+                if (range_status < 0)
+                {
+                    res.set_code(416);
+                    res.set_header("Content-Range", "bytes */" + std::to_string(file_size));
+                }
+                else
+                {
+                    res.set_code(range_status > 0 ? 206 : 200);
+                    if (range_status > 0)
+                    {
+                        res.set_header("Content-Range", "bytes " + std::to_string(range_start) + "-" + std::to_string(range_end - 1) + "/" + std::to_string(file_size));
+                    }
+                    res.set_header("Accept-Ranges", "bytes");
+                    res.set_header("Content-Length", std::to_string(range_end - range_start));
 
-                // @PETER ADDED - reset cookies of user
-                std::string content_disposition_val = "attachment; filename=\"" + filename + "\"";
-                res.set_header("Content-Disposition", content_disposition_val);
+                    // @PETER ADDED - reset cookies of user
+                    std::string content_disposition_val = "attachment; filename=\"" + filename + "\"";
+                    res.set_header("Content-Disposition", content_disposition_val);
 
+                    // file is pulled from the KVS a piece at a time once headers are sent, so it's never held in memory whole
+                    res.stream_body([kvs_addr, parent_path_vec, filename_vec, range_start, range_end](const BodyWriter &write)
+                                    { stream_file_range(kvs_addr, parent_path_vec, filename_vec, range_start, range_end, write); });
+                }
                 FeUtils::set_cookies(res, username, sid);
-
-                // set code
-                res.set_code(200);
             }
             else
             {
@@ -895,16 +994,85 @@ void open_filefolder(const HttpRequest &req, HttpResponse &res)
     }
 }
 
-// uploads a new file
-void upload_file(const HttpRequest &req, HttpResponse &res)
+// body handler for file uploads
+// the multipart body is parsed as it arrives, and only the uploaded file's bytes are kept
+class UploadHandler : public BodyHandler
+{
+public:
+    UploadHandler(const HttpRequest &req);
+
+    void on_body_chunk(const char *data, size_t len) override;
+    void on_body_end(const HttpRequest &req, HttpResponse &res) override;
+
+private:
+    MultipartParser parser;
+    string filename;          // name of uploaded file
+    vector<char> file_binary; // contents of uploaded file
+    bool in_file_part;        // tracks if parser is currently reading the uploaded file's part
+};
+
+UploadHandler::UploadHandler(const HttpRequest &req)
+    : parser(MultipartParser::boundary_from_content_type(req.get_header("Content-Type").empty() ? "" : req.get_header("Content-Type")[0])),
+      in_file_part(false)
 {
+    // file is smaller than the body it's sent in, so reserving the content length (up to a cap, since it comes from the client) avoids regrowing the file buffer
+    vector<string> content_length = req.get_header("Content-Length");
+    if (!content_length.empty())
+    {
+        try
+        {
+            file_binary.reserve(std::min(static_cast<size_t>(std::stoul(content_length[0])), Client::BODY_PRESIZE_LIMIT));
+        }
+        catch (const std::exception &e)
+        {
+        }
+    }
 
+    parser.on_part_begin = [this](const unordered_map<string, string> &part_headers)
+    {
+        // @note: assuming we only upload 1 file at a time - only the first part with a file name is kept
+        if (!filename.empty() || part_headers.count("content-disposition") == 0)
+        {
+            return;
+        }
+        string content_disp = part_headers.at("content-disposition");
+        size_t name_start = content_disp.find("filename=\"");
+        if (name_start == string::npos)
+        {
+            return;
+        }
+        name_start += 10;
+        size_t name_end = content_disp.find('"', name_start);
+        filename = content_disp.substr(name_start, name_end == string::npos ? string::npos : name_end - name_start);
+        in_file_part = !filename.empty();
+    };
+    parser.on_part_data = [this](const char *data, size_t len)
+    {
+        if (in_file_part)
+        {
+            file_binary.insert(file_binary.end(), data, data + len);
+        }
+    };
+    parser.on_part_end = [this]()
+    {
+        in_file_part = false;
+    };
+}
+
+void UploadHandler::on_body_chunk(const char *data, size_t len)
+{
+    parser.feed(data, len);
+}
+
+// uploads a new file
+void UploadHandler::on_body_end(const HttpRequest &req, HttpResponse &res)
+{
     // Get path of parent directory where we are appending
 
     // path is /api/drive/upload/:parentpath where parent dir is the page that is being displayed
     string parentpath_str = req.path.substr(18);
     string username = get_username(parentpath_str);
-    bool present = HttpServer::check_kvs_addr(username);
+    bool present = HttpServer::check_kvs_addr(username, FeUtils::routing_version());
     std::vector<std::string> kvs_addr;
 
     // check if we know already know the KVS server address for user
@@ -937,44 +1105,9 @@ void upload_file(const HttpRequest &req, HttpResponse &res)
         return;
     }
 
-    // Check if the request contains a body
-    if (!req.body_as_bytes().empty())
+    // Check if the request contained a file
+    if (!filename.empty() && !parser.has_error())
     {
-        // ------- Get file name and clean up to get file binary ----
-        // Get the single file uploaded
-        vector<string> headers;
-
-        // Find form boundary
-        headers = req.get_header("Content-Type");
-        string header_str(headers[0]);
-        // boundary provided by form
-        vector<string> find_boundary = Utils::split_on_first_delim(header_str, "boundary=");
-        vector<char> bound_vec(find_boundary.back().begin(), find_boundary.back().end());
-
-        vector<char> line_feed = {'\r', '\n'};
-
-        // split body on boundary
-        vector<vector<char>> elements = FeUtils::split_vector(req.body_as_bytes(), bound_vec);
-        vector<char> elem1 = elements[1];
-
-        // @note: assuming we only upload 1 file at a time?
-        vector<char> file_data = split_vec_first_delim(elem1, line_feed)[1];
-
-        // split file data to separate file metadata from binary values
-        vector<vector<char>> body_elems = split_vec_first_delim(file_data, line_feed);
-
-        // parse file headers to get name of file
-        string file_headers(body_elems[0].begin(), body_elems[0].end());
-        string content_disp = Utils::split_on_first_delim(file_headers, "\n")[0];
-        string filename_toparse = Utils::split_on_first_delim(file_headers, "filename=").back();
-
-        // file name string
-        string filename = Utils::split(filename_toparse, "\"")[0];
-
-        // get file binary
-        vector<char> file_binary = split_vec_first_delim(body_elems[1], line_feed)[1];
-        file_binary = split_vec_first_delim(file_binary, line_feed)[1];
-
         if (parentpath_str.back() != '/')
         {
             res.set_code(303);
@@ -994,6 +1127,7 @@ void upload_file(const HttpRequest &req, HttpResponse &res)
             // @todo should we instead get row for the page they are on?
             res.set_code(303); // OK
             res.set_header("Location", "/drive/" + parentpath_str);
+            FeUtils::set_position_cookie(res, kvs_resp); // folder read after the redirect must see the upload
             // vector<char> folder_content = FeUtils::kv_get_row(sockfd, row_vec);
         }
         else
@@ -1006,7 +1140,7 @@ void upload_file(const HttpRequest &req, HttpResponse &res)
     }
     else
     {
-        // No body found in the request
+        // No file found in the request
         res.set_code(303); // Bad Request
         res.set_header("Location", "/400");
     }
@@ -1017,6 +1151,12 @@ void upload_file(const HttpRequest &req, HttpResponse &res)
     close(sockfd);
 }
 
+// creates handler that uploads a new file as its body arrives
+std::shared_ptr<BodyHandler> upload_file(const HttpRequest &req)
+{
+    return std::make_shared<UploadHandler>(req);
+}
+
 // creates a new folder
 void create_folder(const HttpRequest &req, HttpResponse &res)
 {
@@ -1026,7 +1166,7 @@ void create_folder(const HttpRequest &req, HttpResponse &res)
     string parentpath_str = req.path.substr(18);
 
     string username = get_username(parentpath_str);
-    bool present = HttpServer::check_kvs_addr(username);
+    bool present = HttpServer::check_kvs_addr(username, FeUtils::routing_version());
     std::vector<std::string> kvs_addr;
 
     // check if we know already know the KVS server address for user
@@ -1127,6 +1267,7 @@ void create_folder(const HttpRequest &req, HttpResponse &res)
 
                 // set cookies on response
                 FeUtils::set_cookies(res, username, valid_session_id);
+                FeUtils::set_position_cookie(res, kvs_resp); // folder read after the redirect must see the new folder
             }
             else
             {
@@ -1152,7 +1293,7 @@ void delete_filefolder(const HttpRequest &req, HttpResponse &res)
     // of type /api/drive/delete/* where child directory is being served
     string childpath_str = req.path.substr(18);
     string username = get_username(childpath_str);
-    bool present = HttpServer::check_kvs_addr(username);
+    bool present = HttpServer::check_kvs_addr(username, FeUtils::routing_version());
     std::vector<std::string> kvs_addr;
 
     // check if we know already know the KVS server address for user
@@ -1196,11 +1337,13 @@ void delete_filefolder(const HttpRequest &req, HttpResponse &res)
         filename = FeUtils::urlDecode(filename);
         vector<char> filename_vec(filename.begin(), filename.end());
 
-        if (FeUtils::kv_success(FeUtils::kv_del(sockfd, parent_path_vec, filename_vec)))
+        vector<char> kvs_resp = FeUtils::kv_del(sockfd, parent_path_vec, filename_vec);
+        if (FeUtils::kv_success(kvs_resp))
         {
 
             res.set_code(303);
             res.set_header("Location", "/drive/" + parentpath_str);
+            FeUtils::set_position_cookie(res, kvs_resp); // folder read after the redirect must not see the deleted file
         }
         else
         {
@@ -1232,11 +1375,13 @@ void delete_filefolder(const HttpRequest &req, HttpResponse &res)
                 vector<char> folder_name_vec(foldername.begin(), foldername.end());
 
                 // dleete the folder from the parent folder
-                if (FeUtils::kv_success(FeUtils::kv_del(sockfd, parent_path_vec, folder_name_vec)))
+                vector<char> kvs_resp = FeUtils::kv_del(sockfd, parent_path_vec, folder_name_vec);
+                if (FeUtils::kv_success(kvs_resp))
                 {
                     // redirect
                     res.set_code(303);
                     res.set_header("Location", "/drive/" + parentpath_str);
+                    FeUtils::set_position_cookie(res, kvs_resp); // folder read after the redirect must not see the deleted folder
                 }
                 else
                 {
@@ -1265,7 +1410,7 @@ void rename_filefolder(const HttpRequest &req, HttpResponse &res)
     // of type /api/drive/rename/* where child directory is being served
     string parent_path_str = req.path.substr(18);
     string username = get_username(parent_path_str);
-    bool present = HttpServer::check_kvs_addr(username);
+    bool present = HttpServer::check_kvs_addr(username, FeUtils::routing_version());
     std::vector<std::string> kvs_addr;
 
     // check if we know already know the KVS server address for user
@@ -1337,11 +1482,13 @@ void rename_filefolder(const HttpRequest &req, HttpResponse &res)
 
         vector<char> filename_vec(oldname.begin(), oldname.end());
 
-        if (FeUtils::kv_success(FeUtils::kv_rename_col(sockfd, parent_path_vec, filename_vec, newname_vec)))
+        vector<char> kvs_resp = FeUtils::kv_rename_col(sockfd, parent_path_vec, filename_vec, newname_vec);
+        if (FeUtils::kv_success(kvs_resp))
         {
 
             res.set_code(303);
             res.set_header("Location", "/drive/" + parent_path_str);
+            FeUtils::set_position_cookie(res, kvs_resp); // folder read after the redirect must see the new name
         }
         else
         {
@@ -1373,11 +1520,13 @@ void rename_filefolder(const HttpRequest &req, HttpResponse &res)
             if (rename_subfolders(sockfd, child_path, new_folderpath))
             {
                 // dleete the folder from the parent folder
-                if (FeUtils::kv_success(FeUtils::kv_rename_col(sockfd, parent_path_vec, folder_name_vec, newname_vec)))
+                vector<char> kvs_resp = FeUtils::kv_rename_col(sockfd, parent_path_vec, folder_name_vec, newname_vec);
+                if (FeUtils::kv_success(kvs_resp))
                 {
                     // redirect
                     res.set_code(303);
                     res.set_header("Location", "/drive/" + parent_path_str);
+                    FeUtils::set_position_cookie(res, kvs_resp); // folder read after the redirect must see the new name
                 }
                 else
                 {
@@ -1407,7 +1556,7 @@ void move_filefolder(const HttpRequest &req, HttpResponse &res)
     // of type /api/drive/move/* where child directory is being served
     string parentpath_str = req.path.substr(16);
     string username = get_username(parentpath_str);
-    bool present = HttpServer::check_kvs_addr(username);
+    bool present = HttpServer::check_kvs_addr(username, FeUtils::routing_version());
     std::vector<std::string> kvs_addr;
 
     // check if we know already know the KVS server address for user
@@ -1516,7 +1665,8 @@ void move_filefolder(const HttpRequest &req, HttpResponse &res)
         }
 
         // put file into new parent
-        if (!FeUtils::kv_success(FeUtils::kv_put(sockfd, newparent_vec, filename_vec, file_binary)))
+        vector<char> kvs_resp = FeUtils::kv_put(sockfd, newparent_vec, filename_vec, file_binary);
+        if (!FeUtils::kv_success(kvs_resp))
         {
             logger.log("Could not add file " + filename + " to new parent " + newparent, LOGGER_WARN);
             res.set_code(303);
@@ -1535,6 +1685,7 @@ void move_filefolder(const HttpRequest &req, HttpResponse &res)
             // @todo: redirect to new parent or current?
             res.set_code(303);
             res.set_header("Location", "/drive/" + parentpath_str);
+            FeUtils::set_position_cookie(res, kvs_resp); // folder reads after the redirect must see the move
         }
     }
     else
@@ -1571,7 +1722,8 @@ void move_filefolder(const HttpRequest &req, HttpResponse &res)
                 }
 
                 // put file into new parent
-                if (!FeUtils::kv_success(FeUtils::kv_put(sockfd, newparent_vec, folder_name_vec, {})))
+                vector<char> kvs_resp = FeUtils::kv_put(sockfd, newparent_vec, folder_name_vec, {});
+                if (!FeUtils::kv_success(kvs_resp))
                 {
                     logger.log("Could not add folder " + foldername + " to new parent " + newparent, LOGGER_WARN);
                     res.set_code(303);
@@ -1589,6 +1741,7 @@ void move_filefolder(const HttpRequest &req, HttpResponse &res)
                     // @todo: redirect to new parent or current?
                     res.set_code(303);
                     res.set_header("Location", "/drive/" + parentpath_str);
+                    FeUtils::set_position_cookie(res, kvs_resp); // folder reads after the redirect must see the move
                 }
             }
         }
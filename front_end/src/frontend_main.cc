@@ -17,15 +17,27 @@ int main(int argc, char *argv[])
 	int opt;
 	int port;
 
-	while ((opt = getopt(argc, argv, "p:")) != -1)
+	while ((opt = getopt(argc, argv, "p:ew:b:z:")) != -1)
 	{
 		switch (opt)
 		{
 		case 'p':
 			port = atoi(optarg); // Convert the port number from string to int
 			break;
+		case 'e':
+			HttpServer::reactor_mode = true; // serve clients from epoll event loop + worker pool
+			break;
+		case 'w':
+			HttpServer::num_worker_threads = atoi(optarg); // number of workers in reactor mode
+			break;
+		case 'b':
+			HttpServer::backlog = atoi(optarg); // listen backlog
+			break;
+		case 'z':
+			HttpServer::compression_level = atoi(optarg); // gzip level for dynamic pages (0 disables)
+			break;
 		default: // '?' is returned by getopt for unrecognized option
-			std::cerr << "Usage: " << argv[0] << " -p <port>\n";
+			std::cerr << "Usage: " << argv[0] << " -p <port> [-e] [-w <workers>] [-b <backlog>] [-z <gzip level>]\n";
 			return 1;
 		}
 	}
@@ -57,7 +69,7 @@ int main(int argc, char *argv[])
 	HttpServer::post("/api/update_password", update_password_handler); // update password
 
 	/* Drive Routes */
-	HttpServer::post("/api/drive/upload/*", upload_file);		// upload file
+	HttpServer::post_stream("/api/drive/upload/*", upload_file); // upload file (body is streamed)
 	HttpServer::post("/api/drive/delete/*", delete_filefolder); // delete a file or folder
 	HttpServer::post("/api/drive/create/*", create_folder);		// create a folder
 	HttpServer::post("/api/drive/rename/*", rename_filefolder);		// move a file or folder
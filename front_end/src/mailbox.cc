@@ -169,7 +169,7 @@ void forwardEmail_handler(const HttpRequest &request, HttpResponse &response)
 		std::string username = cookies["user"];
 		std::string sid = cookies["sid"];
 
-		bool present = HttpServer::check_kvs_addr(username);
+		bool present = HttpServer::check_kvs_addr(username, FeUtils::routing_version());
 		std::vector<std::string> kvs_addr;
 
 		// check if we know already know the KVS server address for user
@@ -245,6 +245,11 @@ void forwardEmail_handler(const HttpRequest &request, HttpResponse &response)
 					all_forwards_sent = false;
 					continue;
 				}
+				// mail to self lands in the user's own mailbox - fence the next inbox read behind it
+				if (FeUtils::extractUsernameFromEmailAddress(recipientEmail) == username)
+				{
+					FeUtils::set_position_cookie(response, kvsResponse);
+				}
 				close(recipient_fd);
 			}
 			else
@@ -293,7 +298,7 @@ void replyEmail_handler(const HttpRequest &request, HttpResponse &response)
 		std::string username = cookies["user"];
 		std::string sid = cookies["sid"];
 
-		bool present = HttpServer::check_kvs_addr(username);
+		bool present = HttpServer::check_kvs_addr(username, FeUtils::routing_version());
 		std::vector<std::string> kvs_addr;
 
 		// check if we know already know the KVS server address for user
@@ -373,6 +378,11 @@ void replyEmail_handler(const HttpRequest &request, HttpResponse &response)
 					all_responses_sent = false;
 					continue; // if one recipient fails, try to send response to remaining recipients
 				}
+				// mail to self lands in the user's own mailbox - fence the next inbox read behind it
+				if (FeUtils::extractUsernameFromEmailAddress(recipientEmail) == username)
+				{
+					FeUtils::set_position_cookie(response, kvsResponse);
+				}
 				close(recipient_fd);
 			}
 			else
@@ -418,7 +428,7 @@ void deleteEmail_handler(const HttpRequest &request, HttpResponse &response)
 		std::string username = cookies["user"];
 		std::string sid = cookies["sid"];
 
-		bool present = HttpServer::check_kvs_addr(username);
+		bool present = HttpServer::check_kvs_addr(username, FeUtils::routing_version());
 		std::vector<std::string> kvs_addr;
 
 		// check if we know already know the KVS server address for user
@@ -470,6 +480,7 @@ void deleteEmail_handler(const HttpRequest &request, HttpResponse &response)
 			response.set_code(303); // Success
 			response.set_header("Location", "/" + username + "/mbox");
 			FeUtils::set_cookies(response, username, valid_session_id);
+			FeUtils::set_position_cookie(response, kvsResponse); // inbox read after the redirect must not see the deleted email
 		}
 		else
 		{
@@ -499,7 +510,7 @@ void sendEmail_handler(const HttpRequest &request, HttpResponse &response)
 		std::string username = cookies["user"];
 		std::string sid = cookies["sid"];
 
-		bool present = HttpServer::check_kvs_addr(username);
+		bool present = HttpServer::check_kvs_addr(username, FeUtils::routing_version());
 		std::vector<std::string> kvs_addr;
 
 		// check if we know already know the KVS server address for user
@@ -578,6 +589,11 @@ void sendEmail_handler(const HttpRequest &request, HttpResponse &response)
 					all_emails_sent = false;
 					continue;
 				}
+				// mail to self lands in the user's own mailbox - fence the next inbox read behind it
+				if (FeUtils::extractUsernameFromEmailAddress(recipientEmail) == username)
+				{
+					FeUtils::set_position_cookie(response, kvsResponse);
+				}
 				close(recipient_fd);
 			}
 			else
@@ -626,7 +642,7 @@ void email_handler(const HttpRequest &request, HttpResponse &response)
 	{
 		string username = cookies["user"];
 		string sid = cookies["sid"];
-		bool present = HttpServer::check_kvs_addr(username);
+		bool present = HttpServer::check_kvs_addr(username, FeUtils::routing_version());
 		std::vector<std::string> kvs_addr;
 
 		// check if we know already know the KVS server address for user
@@ -664,7 +680,7 @@ void email_handler(const HttpRequest &request, HttpResponse &response)
 		vector<char> col(colKey.begin(), colKey.end());
 
 		// fetch the email from KVS
-		vector<char> kvsResponse = FeUtils::kv_get(socket_fd, row, col);
+		vector<char> kvsResponse = FeUtils::kv_get(socket_fd, row, col, cookies["kvpos"]); // fenced behind the user's last write
 
 		if (FeUtils::kv_success(kvsResponse))
 		{
@@ -965,7 +981,7 @@ void mailbox_handler(const HttpRequest &request, HttpResponse &response)
 	{
 		string username = cookies["user"];
 		string sid = cookies["sid"];
-		bool present = HttpServer::check_kvs_addr(username);
+		bool present = HttpServer::check_kvs_addr(username, FeUtils::routing_version());
 		std::vector<std::string> kvs_addr;
 
 		// check if we know already know the KVS server address for user
@@ -996,25 +1012,32 @@ void mailbox_handler(const HttpRequest &request, HttpResponse &response)
 
 		string rowKey = parseMailboxPathToRowKey(request.path);
 		vector<char> row(rowKey.begin(), rowKey.end());
-		vector<char> kvs_response = FeUtils::kv_get_row(kvs_sock, row);
+		vector<char> kvs_response = FeUtils::kv_get_row(kvs_sock, row, cookies["kvpos"]); // fenced behind the user's last write
 
 		if (FeUtils::kv_success(kvs_response))
 		{
-			// extract individual emails
+			// extract individual emails (tokens point into the inbox, so the row isn't copied again into a vector of emails)
 			string inbox(kvs_response.begin() + 4, kvs_response.end());
-			vector<string> mailbox = Utils::split(inbox, "\b");
+			Utils::Tokenizer mailbox(inbox, "\b");
+			const char *email_token;
+			size_t email_len;
 
 			string table_rows = "";
-			for (auto &email : mailbox)
+			while (mailbox.next(email_token, email_len))
 			{
+				string email(email_token, email_len);
+
 				// decode email
 				string mail = FeUtils::urlDecode(email);
-				vector<string> mail_items = Utils::split(mail, "\r");
+				Utils::Tokenizer mail_items(mail, "\r");
+				const char *item;
+				size_t item_len;
 				unordered_map<string, string> email_elements;
-				for (auto &item : mail_items)
+				while (mail_items.next(item, item_len))
 				{
-					int split_idx = item.find(':');
-					email_elements[item.substr(0, split_idx)] = (item.size() > split_idx + 2 ? item.substr(split_idx + 2) : "");
+					const char *split_pos = static_cast<const char *>(memchr(item, ':', item_len));
+					size_t split_idx = split_pos == nullptr ? item_len : split_pos - item;
+					email_elements[string(item, split_idx)] = (item_len > split_idx + 2 ? string(item + split_idx + 2, item_len - split_idx - 2) : "");
 				}
 				vector<string> recipients = Utils::split(email_elements.at("to"), ",");
 				string recipient_list = "";
@@ -1295,7 +1318,7 @@ void compose_email(const HttpRequest &request, HttpResponse &response)
 	{
 		string username = cookies["user"];
 		string sid = cookies["sid"];
-		bool present = HttpServer::check_kvs_addr(username);
+		bool present = HttpServer::check_kvs_addr(username, FeUtils::routing_version());
 		std::vector<std::string> kvs_addr;
 
 		// check if we know already know the KVS server address for user
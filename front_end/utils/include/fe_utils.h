@@ -17,6 +17,7 @@
 #include <iomanip>
 #include <sstream>
 #include "../../../http_server/include/http_request.h"
+#include "../../../http_server/include/http_metrics.h"
 #include "../../../utils/include/utils.h"
 #include "../../include/email_data.h"
 
@@ -33,6 +34,9 @@ size_t writeto_kvs(const std::vector<char> &data, int fd);
 // Helper function for all reads from kvs responses
 std::vector<char> readfrom_kvs(int fd);
 
+// Helper function for reads of responses to an operation on row - refreshes the routing version if row was migrated away from the server
+std::vector<char> readfrom_kvs(int fd, const std::vector<char> &row);
+
 namespace FeUtils
 {
     // creates socket, connects to kvs server and returns fd
@@ -41,15 +45,41 @@ namespace FeUtils
 
     /// @brief helper function that queries coordinator for KVS server address given a path
     /// @param path file/folder path for which the associated KVS server address should be retrieved
-    /// @return returns the server address as a vector of strings <ip,port>
+    /// @return returns the server address as a vector of strings <ip,port> (empty if the coordinator can't be reached)
+    /// @note each thread keeps a persistent connection to the coordinator, which is reopened if it fails
     std::vector<std::string> query_coordinator(std::string &path);
 
+    /// @brief same as query_coordinator, but also returns the routing version the address was looked up at
+    /// @param path file/folder path for which the associated KVS server address should be retrieved
+    /// @param version set to the coordinator's routing version (0 if the coordinator can't be reached)
+    /// @return returns the server address as a vector of strings <ip,port>
+    std::vector<std::string> query_coordinator(std::string &path, uint64_t &version);
+
+    /// @brief newest routing version seen in a coordinator response - addresses cached at an older version may be stale
+    /// @return the version, or 0 if no lookup has been answered yet
+    uint64_t routing_version();
+
     // pass a fd and row, col values to perform GET(r,c), returns value
     std::vector<char> kv_get(int fd, std::vector<char> row, std::vector<char> col);
 
     // pass a fd and row to get all column values of row "RGET(r)"
     std::vector<char> kv_get_row(int fd, std::vector<char> row);
 
+    // same as kv_get, but a secondary only serves the read once it has committed min_position (returned by a previous write) - plain GET if min_position is empty
+    std::vector<char> kv_get(int fd, std::vector<char> row, std::vector<char> col, const std::string &min_position);
+
+    // same as kv_get_row, but a secondary only serves the read once it has committed min_position (returned by a previous write) - plain GETR if min_position is empty
+    std::vector<char> kv_get_row(int fd, std::vector<char> row, const std::string &min_position);
+
+    // pass a fd and row, col values to read up to length bytes of the value starting at offset "GETP(r,c,o,l)" - a length of 0 only reads the value's size
+    std::vector<char> kv_get_range(int fd, std::vector<char> row, std::vector<char> col, size_t offset, size_t length);
+
+    // parses a kv_get_range response into the full size of the value and the index in vec where the returned bytes start
+    bool kv_parse_range(const std::vector<char> &vec, size_t &total_size, size_t &data_start);
+
+    // extracts the committed position (CP#:SEQ#) from a successful write response, empty string otherwise
+    std::string kv_position(const std::vector<char> &vec);
+
     // pass a fd and row, col, value to perform PUT(r,c,v)
     std::vector<char> kv_put(int fd, std::vector<char> row, std::vector<char> col, std::vector<char> val);
 
@@ -94,6 +124,11 @@ namespace FeUtils
     /// @param sid session ID associated with the current session
     void expire_cookies(HttpResponse &res, std::string username, std::string sid);
 
+    /// @brief remembers the committed position of the user's write in the "kvpos" cookie, so the next page read is fenced behind it
+    /// @param res HttpResponse object
+    /// @param kvs_response response of a write to the user's own KVS group
+    void set_position_cookie(HttpResponse &res, const std::vector<char> &kvs_response);
+
     /// @brief validates the session id for the current user
     /// @param kvs_fd file descriptor for KVS server
     /// @param username username associatd with the current session to be validated
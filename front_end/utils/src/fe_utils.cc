@@ -19,6 +19,9 @@ void insert_arg(std::vector<char> &curr_vec, std::vector<char> arg)
 // Helper function for all writes to kvs
 size_t writeto_kvs(std::vector<char> &msg, int fd)
 {
+    // time spent talking to the KVS is reported separately from the rest of the route handler
+    auto kvs_start = std::chrono::steady_clock::now();
+
     // Send data to kvs using fd
     uint32_t msg_size = htonl(msg.size());
 
@@ -37,12 +40,14 @@ size_t writeto_kvs(std::vector<char> &msg, int fd)
         total_bytes_sent += bytes_sent;
     }
 
+    HttpMetrics::add_kvs_wait(HttpMetrics::elapsed_ns(kvs_start));
     return total_bytes_sent;
 }
 
 // Helper function for all reads from kvs responses
 std::vector<char> readfrom_kvs(int fd)
 {
+    auto kvs_start = std::chrono::steady_clock::now();
     std::vector<char> kvs_data;
     char buffer[4096];
     uint32_t data_size = 0;
@@ -106,6 +111,23 @@ std::vector<char> readfrom_kvs(int fd)
         }
     }
 
+    HttpMetrics::add_kvs_wait(HttpMetrics::elapsed_ns(kvs_start));
+    return kvs_data;
+}
+
+// Helper function for reads of responses to an operation on row. A server that no longer manages the row (its range was migrated to
+// another group) rejects the operation - looking the row up again advances the routing version, so addresses cached before the
+// migration are dropped and the next request for the row goes to its new group.
+std::vector<char> readfrom_kvs(int fd, const std::vector<char> &row)
+{
+    std::vector<char> kvs_data = readfrom_kvs(fd);
+    std::string not_managed = "-ER Row not managed by this server";
+    if (kvs_data.size() >= not_managed.size() && std::equal(not_managed.begin(), not_managed.end(), kvs_data.begin()))
+    {
+        std::string path(row.begin(), row.end());
+        fe_utils_logger.log("KVS server no longer manages " + path + " - refreshing routing", 30);
+        FeUtils::query_coordinator(path);
+    }
     return kvs_data;
 }
 
@@ -140,33 +162,139 @@ int FeUtils::open_socket(const std::string s_addr, const int s_port)
     return sockfd;
 }
 
+// Newest routing version the coordinator has answered a lookup with
+static std::atomic<uint64_t> latest_routing_version(0);
+
+// Persistent connection to the coordinator, one per thread (closed when the thread exits)
+struct CoordinatorConnection
+{
+    int fd = -1;
+
+    ~CoordinatorConnection()
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+};
+
+// Helper function to send a lookup frame and read the coordinator's response frame. Returns false if the connection failed.
+bool lookup_on_connection(int fd, const std::string &path, std::string &response)
+{
+    // request frame: [4-byte size][path]
+    uint32_t path_size = htonl(path.size());
+    std::string frame((char *)&path_size, sizeof(uint32_t));
+    frame += path;
+    size_t total_bytes_sent = 0;
+    while (total_bytes_sent < frame.size())
+    {
+        int bytes_sent = send(fd, &frame[total_bytes_sent], frame.size() - total_bytes_sent, 0);
+        if (bytes_sent <= 0)
+        {
+            return false;
+        }
+        total_bytes_sent += bytes_sent;
+    }
+
+    // response frame: [4-byte size][status][8-byte routing version][ip:port or error message]
+    uint32_t response_size;
+    char *size_ptr = (char *)&response_size;
+    for (size_t recvd = 0; recvd < sizeof(uint32_t);)
+    {
+        int bytes_recvd = recv(fd, size_ptr + recvd, sizeof(uint32_t) - recvd, 0);
+        if (bytes_recvd <= 0)
+        {
+            return false;
+        }
+        recvd += bytes_recvd;
+    }
+    response.resize(ntohl(response_size));
+    for (size_t recvd = 0; recvd < response.size();)
+    {
+        int bytes_recvd = recv(fd, &response[recvd], response.size() - recvd, 0);
+        if (bytes_recvd <= 0)
+        {
+            return false;
+        }
+        recvd += bytes_recvd;
+    }
+    return response.size() >= 9;
+}
+
 /// @brief helper function that queries coordinator for KVS server address given a path
 /// @param path file/folder path for which the associated KVS server address should be retrieved
 /// @return returns the server address as a vector of strings <ip,port>
 std::vector<std::string> FeUtils::query_coordinator(std::string &path)
 {
+    uint64_t version;
+    return FeUtils::query_coordinator(path, version);
+}
+
+/// @brief helper function that queries coordinator for KVS server address given a path
+/// @param path file/folder path for which the associated KVS server address should be retrieved
+/// @param version set to the routing version the coordinator answered with (0 if the coordinator can't be reached)
+/// @return returns the server address as a vector of strings <ip,port>
+std::vector<std::string> FeUtils::query_coordinator(std::string &path, uint64_t &version)
+{
+    version = 0;
+
     // set ip:port for coordinator
     std::string ip_addr = "127.0.0.1";
     int port = 4999;
 
-    // open socket for coordinator
-    int coord_sock = FeUtils::open_socket(ip_addr, port);
+    // each thread keeps its connection to the coordinator open across lookups
+    static thread_local CoordinatorConnection coordinator;
 
-    // set buffer
+    // a failed lookup is retried once on a new connection (coordinator may have restarted since the connection was opened)
     std::string resp;
-    resp.resize(100);
-    int rlen = 0;
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        if (coordinator.fd < 0)
+        {
+            coordinator.fd = FeUtils::open_socket(ip_addr, port);
+            std::string hello = "LKUP\r\n";
+            if (coordinator.fd < 0)
+            {
+                break;
+            }
+            if (send(coordinator.fd, &hello[0], hello.size(), 0) != (int)hello.size())
+            {
+                close(coordinator.fd);
+                coordinator.fd = -1;
+                continue;
+            }
+        }
+
+        if (lookup_on_connection(coordinator.fd, path, resp))
+        {
+            for (int i = 1; i < 9; i++)
+            {
+                version = (version << 8) | (unsigned char)resp[i];
+            }
 
-    // send request and retrieve response
-    send(coord_sock, &path[0], path.size(), 0);
-    rlen = recv(coord_sock, &resp[0], resp.size(), 0);
-    resp.resize(rlen);
-    std::vector<std::string> kvs_addr = Utils::split(resp, ":");
+            // remember the newest version, so addresses cached under an older one are looked up again
+            uint64_t latest = latest_routing_version.load(std::memory_order_relaxed);
+            while (latest < version && !latest_routing_version.compare_exchange_weak(latest, version, std::memory_order_relaxed))
+            {
+            }
+
+            // drop status byte and version - error messages are returned to the caller as before
+            return Utils::split(resp.substr(9), ":");
+        }
+        close(coordinator.fd);
+        coordinator.fd = -1;
+    }
 
-    // close socket for coordinator
-    close(coord_sock);
+    fe_utils_logger.log("Unable to query coordinator for " + path, 40);
+    return std::vector<std::string>();
+}
 
-    return kvs_addr;
+/// @brief newest routing version seen in a coordinator response
+/// @return the version, or 0 if no lookup has been answered yet
+uint64_t FeUtils::routing_version()
+{
+    return latest_routing_version.load(std::memory_order_relaxed);
 }
 
 // Function for KV GET(row, col). Returns value as vector<char> to user
@@ -189,7 +317,7 @@ std::vector<char> FeUtils::kv_get(int fd, std::vector<char> row, std::vector<cha
     }
 
     // wait to recv response from kvs
-    response = readfrom_kvs(fd);
+    response = readfrom_kvs(fd, row);
 
     // return value
     return response;
@@ -216,7 +344,7 @@ std::vector<char> FeUtils::kv_put(int fd, std::vector<char> row, std::vector<cha
     }
 
     // wait to recv response from kvs
-    response = readfrom_kvs(fd);
+    response = readfrom_kvs(fd, row);
 
     // return value
     return response;
@@ -241,12 +369,138 @@ std::vector<char> FeUtils::kv_get_row(int fd, std::vector<char> row)
     }
 
     // wait to recv response from kvs
-    response = readfrom_kvs(fd);
+    response = readfrom_kvs(fd, row);
 
     // return value
     return response;
 }
 
+// Gets value at row, col once the kvs has committed min_position, using fenced GET(r,c)
+std::vector<char> FeUtils::kv_get(int fd, std::vector<char> row, std::vector<char> col, const std::string &min_position)
+{
+    // no write to wait for
+    if (min_position.empty())
+    {
+        return kv_get(fd, row, col);
+    }
+
+    // string to send  COMMAND + \b + position + \b + row + \b + col....
+    std::string cmd = "FGTV";
+    std::vector<char> fn_string(cmd.begin(), cmd.end());
+    insert_arg(fn_string, std::vector<char>(min_position.begin(), min_position.end()));
+    insert_arg(fn_string, row);
+    insert_arg(fn_string, col);
+    std::vector<char> response = {};
+
+    // send message to kvs and check for error
+    if (writeto_kvs(fn_string, fd) == 0)
+    {
+        fe_utils_logger.log("Unable to write to KVS server", 40);
+        response = {'-', 'E', 'R'};
+        return response;
+    }
+
+    // wait to recv response from kvs
+    response = readfrom_kvs(fd, row);
+
+    // return value
+    return response;
+}
+
+// Gets all columns in row once the kvs has committed min_position, using fenced RGET(r)
+std::vector<char> FeUtils::kv_get_row(int fd, std::vector<char> row, const std::string &min_position)
+{
+    // no write to wait for
+    if (min_position.empty())
+    {
+        return kv_get_row(fd, row);
+    }
+
+    // string to send  COMMAND + \b + position + \b + row
+    std::string cmd = "FGTR";
+    std::vector<char> fn_string(cmd.begin(), cmd.end());
+    insert_arg(fn_string, std::vector<char>(min_position.begin(), min_position.end()));
+    insert_arg(fn_string, row);
+    std::vector<char> response = {};
+
+    // send message to kvs and check for error
+    if (writeto_kvs(fn_string, fd) == 0)
+    {
+        fe_utils_logger.log("Unable to write to KVS server", 40);
+        response = {'-', 'E', 'R'};
+        return response;
+    }
+
+    // wait to recv response from kvs
+    response = readfrom_kvs(fd, row);
+
+    // return value
+    return response;
+}
+
+// Gets part of a value from kvs using GETP(r,c,o,l), so large values can be read in pieces
+std::vector<char> FeUtils::kv_get_range(int fd, std::vector<char> row, std::vector<char> col, size_t offset, size_t length)
+{
+    // string to send  COMMAND + \b + row + \b + col + \b + offset + \b + length
+    std::string cmd = "GETP";
+    std::vector<char> fn_string(cmd.begin(), cmd.end());
+    std::string offset_str = std::to_string(offset);
+    std::string length_str = std::to_string(length);
+    insert_arg(fn_string, row);
+    insert_arg(fn_string, col);
+    insert_arg(fn_string, std::vector<char>(offset_str.begin(), offset_str.end()));
+    insert_arg(fn_string, std::vector<char>(length_str.begin(), length_str.end()));
+    std::vector<char> response = {};
+
+    // send message to kvs and check for error
+    if (writeto_kvs(fn_string, fd) == 0)
+    {
+        fe_utils_logger.log("Unable to write to KVS server", 40);
+        response = {'-', 'E', 'R'};
+        return response;
+    }
+
+    // wait to recv response from kvs
+    response = readfrom_kvs(fd, row);
+
+    // return value
+    return response;
+}
+
+// Parses a range response of the form "+OK SIZE\bBYTES"
+bool FeUtils::kv_parse_range(const std::vector<char> &vec, size_t &total_size, size_t &data_start)
+{
+    if (!kv_success(vec) || vec.size() <= 4)
+    {
+        return false;
+    }
+    auto size_end = std::find(vec.begin() + 4, vec.end(), '\b');
+    if (size_end == vec.end())
+    {
+        return false;
+    }
+    try
+    {
+        total_size = std::stoul(std::string(vec.begin() + 4, size_end));
+    }
+    catch (const std::exception &e)
+    {
+        return false;
+    }
+    data_start = size_end - vec.begin() + 1;
+    return true;
+}
+
+// Extracts committed position from a write response of the form "+OK CP#:SEQ#"
+std::string FeUtils::kv_position(const std::vector<char> &vec)
+{
+    if (!kv_success(vec) || vec.size() <= 4)
+    {
+        return "";
+    }
+    return std::string(vec.begin() + 4, vec.end());
+}
+
 // Puts a row, col, value into kvs using CPUT(r,c,v1,v2), returns 0 or 1 as status
 std::vector<char> FeUtils::kv_cput(int fd, std::vector<char> row, std::vector<char> col, std::vector<char> val1, std::vector<char> val2)
 {
@@ -269,7 +523,7 @@ std::vector<char> FeUtils::kv_cput(int fd, std::vector<char> row, std::vector<ch
     }
 
     // wait to recv response from kvs
-    response = readfrom_kvs(fd);
+    response = readfrom_kvs(fd, row);
 
     // return value
     return response;
@@ -297,7 +551,7 @@ std::vector<char> FeUtils::kv_del(int fd, std::vector<char> row, std::vector<cha
     }
 
     // wait to recv response from kvs
-    response = readfrom_kvs(fd);
+    response = readfrom_kvs(fd, row);
 
     // return value
     return response;
@@ -359,6 +613,18 @@ void FeUtils::expire_cookies(HttpResponse &res, std::string username, std::strin
     res.set_cookie(key2, sid, "0");
 }
 
+/// @brief remembers the committed position of the user's write in the "kvpos" cookie, so the next page read is fenced behind it
+/// @param res HttpResponse object
+/// @param kvs_response response of a write to the user's own KVS group
+void FeUtils::set_position_cookie(HttpResponse &res, const std::vector<char> &kvs_response)
+{
+    std::string position = kv_position(kvs_response);
+    if (!position.empty())
+    {
+        res.set_cookie("kvpos", position);
+    }
+}
+
 /// @brief validates the session id of the current user
 /// @param kvs_fd file descriptor for KVS server
 /// @param username username associatd with the current session to be validated
@@ -520,7 +786,7 @@ std::vector<char> FeUtils::kv_del_row(int fd, std::vector<char> row)
     }
 
     // wait to recv response from kvs
-    response = readfrom_kvs(fd);
+    response = readfrom_kvs(fd, row);
 
     // return value
     return response;
@@ -550,7 +816,7 @@ std::vector<char> FeUtils::kv_rename_row(int fd, std::vector<char> oldrow, std::
     }
 
     // wait to recv response from kvs
-    response = readfrom_kvs(fd);
+    response = readfrom_kvs(fd, oldrow);
 
     // return value
     return response;
@@ -580,7 +846,7 @@ std::vector<char> FeUtils::kv_rename_col(int fd, std::vector<char> row, std::vec
     }
 
     // wait to recv response from kvs
-    response = readfrom_kvs(fd);
+    response = readfrom_kvs(fd, row);
 
     // return value
     return response;
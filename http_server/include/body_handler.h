@@ -0,0 +1,21 @@
+#ifndef BODY_HANDLER_H
+#define BODY_HANDLER_H
+
+#include <cstddef>
+
+#include "http_request.h"
+#include "http_response.h"
+
+// Interface for streaming routes - a body handler receives the request body in chunks as it arrives, instead of after
+// the whole body has been buffered into the request
+// A new handler is created for each request by the factory registered with the route (see HttpServer::post_stream)
+class BodyHandler
+{
+public:
+    virtual ~BodyHandler() {}
+
+    virtual void on_body_chunk(const char *data, size_t len) = 0;          // called with each chunk of body, in order, as it is received
+    virtual void on_body_end(const HttpRequest &req, HttpResponse &res) = 0; // called once the whole body was received - constructs response
+};
+
+#endif
@@ -8,10 +8,24 @@
 #include <unistd.h>     // close
 #include <fstream>
 #include <sstream>
+#include <cstring>   // memchr
+#include <algorithm> // std::find
+#include <cctype>    // tolower, isspace
+#include <cerrno>    // errno
+#include <fcntl.h>   // open
+#include <sys/uio.h> // writev
+#include <cstdio>    // snprintf
+#ifdef __linux__
+#include <sys/sendfile.h> // sendfile
+#endif
 
 #include "http_response.h"
 #include "http_request.h"
 #include "http_server.h"
+#include "body_handler.h"
+#include "static_file_cache.h"
+#include "http_compression.h"
+#include "http_metrics.h"
 #include "../../utils/include/utils.h"
 
 class Client
@@ -20,6 +34,7 @@ class Client
 public:
     static const std::string CRLF;
     static const std::string DOUBLE_CRLF;
+    static const size_t BODY_PRESIZE_LIMIT; // most bytes reserved for a body from its content length alone
     // note that requests/responses for a client are sequential, so after a response is sent, both req and res must be cleared
     HttpRequest req;     // current request
     HttpResponse res;    // response for current request
@@ -28,27 +43,45 @@ public:
     bool close_connection;
 
 private:
-    int client_fd; // client's bound fd
+    int client_fd;                                  // client's bound fd
+    std::shared_ptr<BodyHandler> body_handler;      // handler receiving current request's body (streaming routes only)
+    std::string client_stream;                      // bytes received from client that have not been consumed by a request yet
+    size_t scan_offset;                             // bytes of client_stream already searched for a double CRLF (avoids rescanning on each recv)
+    std::shared_ptr<const StaticFile> static_file;  // cached file for current request (static requests only)
+    std::shared_ptr<std::vector<char>> static_body; // cached bytes sent as body of static response (nullptr if file is streamed from disk)
+    int metrics_route;                              // route slot current request is counted under in metrics (-1 until request is routed)
+    uint64_t stage_ns[HttpMetrics::NUM_STAGES];     // time spent in each stage of current request
 
     // methods
 public:
     // client initialized with an associated file descriptor
     Client(int client_fd) : response_ready(false), remaining_body_len(0),
-                            close_connection(false), client_fd(client_fd) {}
+                            close_connection(false), client_fd(client_fd), scan_offset(0), metrics_route(-1), stage_ns() {}
     // disable default constructor - Client should only be created with an associated fd
     Client() = delete;
 
     void read_from_network(); // run server
+    bool read_available();    // read without blocking until no bytes are available (reactor mode). Returns false if connection should be closed.
     void send_response();
 
 private:
-    void parse_req(std::string &client_stream);
-    void parse_req_line(std::string &req_line);
-    void parse_headers(std::vector<std::string> &headers);
+    // request line + headers are parsed in place from the receive buffer ([begin, end) spans through the last header's CRLF)
+    void parse_req(const char *begin, const char *end);
+    void parse_req_line(const char *begin, const char *end);
+    void parse_headers(const char *begin, const char *end);
+    void handle_bytes(const char *data, size_t len); // consume received bytes, responding to each request they complete
+    void prepare_body();                             // allocate body, or create body handler for streaming routes, once headers are parsed
+    void respond_to_req();                           // construct and send response once request body is complete
     void handle_req();
     void set_req_type();
     void construct_error_response(int err_code);
     void construct_response();
+    bool etag_matches();                                 // checks If-None-Match header against static file's etag
+    void compress_response();                            // gzip dynamic response body if client accepts it
+    bool send_all(const char *data, size_t len);         // send bytes to client. Returns false if connection failed.
+    bool send_iov(struct iovec *iov, int iov_count);     // send buffers to client with writev (iov is modified). Returns false if connection failed.
+    bool send_chunk(const char *data, size_t len);       // send data as one chunk of chunked body. Returns false if connection failed.
+    bool send_file(const std::string &path, size_t len); // send file contents to client (sendfile where available). Returns false on failure.
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,26 @@
+#ifndef HTTP_COMPRESSION_H
+#define HTTP_COMPRESSION_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdlib> // atof
+#include <zlib.h>
+
+#include "http_request.h"
+
+class HttpCompression
+{
+    // methods
+public:
+    // gzip data into out at the supplied zlib level (1-9). Returns false if compression failed.
+    static bool gzip(const char *data, size_t len, int level, std::vector<char> &out);
+    static bool accepts_gzip(const HttpRequest &req);                  // checks Accept-Encoding of request for gzip
+    static bool is_compressible_type(const std::string &content_type); // text-based content types worth compressing
+
+private:
+    // make default constructor private
+    HttpCompression() {}
+};
+
+#endif
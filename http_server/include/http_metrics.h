@@ -0,0 +1,112 @@
+#ifndef HTTP_METRICS_H
+#define HTTP_METRICS_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <algorithm> // std::min
+#include <cstdio>    // snprintf
+
+#include "http_request.h"
+#include "http_response.h"
+
+// Per-route request counters and latency histograms, exposed in Prometheus text format at /metrics
+// Each thread records into its own shard of counters (no locks or shared cache lines on the request path), and
+// shards are summed when metrics are scraped. Shards of finished threads are reused by new threads.
+class HttpMetrics
+{
+    // fields
+public:
+    // stages of a request that are timed
+    enum Stage
+    {
+        PARSE = 0, // request line + headers parsed and routed
+        HANDLER,   // response constructed (route handler or static file)
+        KVS_WAIT,  // time handler spent waiting on the KVS (part of handler stage)
+        SEND,      // response written to client
+        NUM_STAGES
+    };
+
+    static const int num_buckets = 27;     // log2 latency buckets (bucket i counts durations <= 2^i microseconds) - last bucket is +Inf
+    static const std::string metrics_path; // path metrics are served on
+
+private:
+    // histogram of durations for a single route and stage
+    struct Histogram
+    {
+        std::atomic<uint64_t> buckets[num_buckets]; // bucket counts
+        std::atomic<uint64_t> count;                // number of durations recorded
+        std::atomic<uint64_t> sum_ns;               // sum of durations recorded
+    };
+
+    struct RouteStats
+    {
+        std::atomic<uint64_t> requests; // number of requests served
+        Histogram stages[NUM_STAGES];   // duration histogram of each stage
+    };
+
+    // counters owned by one thread at a time
+    struct Shard
+    {
+        std::unique_ptr<RouteStats[]> routes; // indexed by route slot
+        size_t num_routes;                    // number of route slots in shard
+    };
+
+    static std::vector<Shard *> shards;      // every shard ever created (never freed, since scrapes may read them at any time)
+    static std::vector<Shard *> free_shards; // shards of threads that have exited
+    static std::mutex shards_lock;           // lock for shards and free shards (only taken when a thread first records or exits)
+
+    // methods
+public:
+    // route slots - routes in routing table occupy the first slots, followed by these
+    static int static_route_slot();    // static file requests
+    static int unmatched_route_slot(); // requests that matched no route and no static file
+    static int metrics_route_slot();   // requests for /metrics
+
+    static void record_request(int route_slot, const uint64_t stage_ns[NUM_STAGES]);    // record stage durations of a completed request
+    static std::vector<uint64_t> stage_buckets(Stage stage);                            // bucket counts of a stage summed across every route and thread
+    static uint64_t quantile_us(const std::vector<uint64_t> &buckets, double quantile); // upper bound (microseconds) of bucket holding quantile (0 if buckets are empty)
+
+    static void metrics_handler(const HttpRequest &req, HttpResponse &res); // serve metrics in Prometheus text format
+
+    // KVS wait accounting is defined inline, so binaries that share fe_utils without the HTTP server library (coordinator, admin console, relay) still link
+    static void add_kvs_wait(uint64_t ns) { thread_kvs_wait_ns() += ns; } // add KVS wait time to request being handled on this thread
+
+    // get and reset KVS wait time recorded on this thread
+    static uint64_t take_kvs_wait()
+    {
+        uint64_t ns = thread_kvs_wait_ns();
+        thread_kvs_wait_ns() = 0;
+        return ns;
+    }
+
+    // nanoseconds since start
+    static uint64_t elapsed_ns(const std::chrono::steady_clock::time_point &start)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    // make default constructor private
+    HttpMetrics() {}
+
+    static Shard *thread_shard();                              // shard of calling thread (assigned on first use)
+    static void release_shard(Shard *shard);                   // return shard of exiting thread for reuse
+    static std::string escape_label(const std::string &value); // escape label value for Prometheus text format
+
+    // KVS wait accumulated by the request currently being handled on this thread
+    static uint64_t &thread_kvs_wait_ns()
+    {
+        static thread_local uint64_t kvs_wait_ns = 0;
+        return kvs_wait_ns;
+    }
+
+    friend struct ShardHolder;
+};
+
+#endif
@@ -5,8 +5,11 @@
 #include <vector>
 #include <unordered_map>
 #include <functional>
+#include <memory>
 
 #include "http_response.h"
+
+class BodyHandler;
 #include "../../utils/include/utils.h"
 
 struct HttpRequest
@@ -22,16 +25,19 @@ public:
     std::string method;  // HTTP method (GET, POST, ...)
     std::string path;    // request URL
     std::string version; // HTTP version (HTTP/1.1)
+    std::string target;  // request URL as received, including its query string
 
 private:
     // Request metadata
     bool is_static;
     std::string static_resource_path;
     std::function<void(const HttpRequest &, HttpResponse &)> dynamic_route;
+    std::function<std::shared_ptr<BodyHandler>(const HttpRequest &)> streaming_route; // creates body handler for request (streaming routes only)
 
     std::unordered_map<std::string, std::vector<std::string>> headers;
     std::vector<char> body; // store data directly as bytes
     std::unordered_map<std::string, std::string> query_params;
+    std::unordered_map<std::string, std::string> path_params; // values of ":param" segments in matched route
 
     // reset data fields after transaction is complete - for internal http server use only
     void reset()
@@ -39,17 +45,30 @@ private:
         method.clear();
         path.clear();
         version.clear();
+        target.clear();
         headers.clear();
         body.clear();
         query_params.clear();
+        path_params.clear();
         is_static = true;
         static_resource_path.clear();
         dynamic_route = nullptr;
+        streaming_route = nullptr;
     }
 
     friend class Client;
 
 public:
+    // get the value captured for a ":param" segment of the matched route (param name is given without ":")
+    std::string get_path_param(const std::string &path_param_key) const
+    {
+        if (path_params.count(path_param_key) == 0)
+        {
+            return "";
+        }
+        return path_params.at(path_param_key);
+    }
+
     // get a vector of header values for a header
     // Note that this returns a vector because a header is allowed to have multiple associated values
     std::string get_qparam(const std::string &q_param_key) const
@@ -86,6 +105,18 @@ public:
         }
     }
 
+    // get every header with its values (header names are lowercase) - used to forward requests as-is
+    const std::unordered_map<std::string, std::vector<std::string>> &get_headers() const
+    {
+        return headers;
+    }
+
+    // get every query parameter with its value - used to forward requests as-is
+    const std::unordered_map<std::string, std::string> &get_qparams() const
+    {
+        return query_params;
+    }
+
     // returns the response body represented as a string
     std::string body_as_string() const
     {
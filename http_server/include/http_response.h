@@ -5,6 +5,10 @@
 #include <unordered_map>
 #include <vector>
 #include <iostream>
+#include <functional>
+
+// writes part of a streamed response body to the client. Returns false if the connection failed (producer should stop writing).
+typedef std::function<bool(const char *data, size_t len)> BodyWriter;
 
 struct HttpResponse
 {
@@ -20,6 +24,7 @@ private:
     std::string version;
     int code;
     std::string reason;
+    std::function<void(const BodyWriter &)> body_producer; // writes body incrementally after headers are sent (streamed responses only)
 
     // reset data fields - for internal http server use only
     void reset()
@@ -29,6 +34,7 @@ private:
         reason.clear();
         headers.clear();
         body.clear();
+        body_producer = nullptr;
     }
 
     friend class Client;
@@ -49,7 +55,9 @@ public:
         const std::unordered_map<int, std::string> response_codes = {
             {200, "OK"},
             {201, "Created"},            // new content created
+            {206, "Partial Content"},    // byte range of a file (Range request)
             {303, "See Other"},          // redirect after POST so that refreshing the result page doesn't retrigger the operation
+            {304, "Not Modified"},       // client's cached copy of a static file is current
             {307, "Temporary Redirect"}, // load balancer
             {400, "Bad Request"},        // request is not as the API expects
             {401, "Unauthorized"},       // no credentials or invalid credentials
@@ -57,6 +65,8 @@ public:
             {404, "Not Found"},
             {405, "Method Not Allowed"},
             {409, "Conflict"}, // request conflict with current state of resource (e.g., signing up as a user that already exists)
+            {413, "Payload Too Large"},     // request body is larger than the server buffers
+            {416, "Range Not Satisfiable"}, // requested byte range is outside the file
             {500, "Internal Server Error"},
             {501, "Not Implemented"},
             {502, "Bad Gateway"}, // for email relay
@@ -88,6 +98,14 @@ public:
         }
     }
 
+    // stream body instead of buffering it - producer is called once headers have been sent and writes the body in pieces
+    // body is sent with chunked transfer encoding, unless the handler sets Content-Length (then producer must write exactly that many bytes)
+    // body set with append_body_* is ignored for streamed responses
+    void stream_body(const std::function<void(const BodyWriter &)> &producer)
+    {
+        body_producer = producer;
+    }
+
     size_t getBodySize()
     {
         size_t sizeInBytes = body.size() * sizeof(char);
@@ -11,24 +11,42 @@
 #include <netinet/in.h> // sockaddr_in
 #include <arpa/inet.h>  // inet_pton
 #include <thread>
+#include <queue>
+#include <condition_variable>
+#include <fcntl.h> // fcntl
+#include <csignal> // signal
+#ifdef __linux__
+#include <sys/epoll.h> // epoll (reactor mode)
+#endif
 
 #include "client.h"
 #include "http_request.h"
 #include "http_response.h"
+#include "body_handler.h"
+#include "multipart_parser.h"
+#include "route_trie.h"
+#include "http_metrics.h"
 #include "../../utils/include/utils.h"
 
 #include "../../loadbalancer/include/loadbalancer.h"
 
+class Client;
+
 struct RouteTableEntry
 {
     std::string method;
     std::string path;
     std::function<void(const HttpRequest &, HttpResponse &)> route;
+    std::function<std::shared_ptr<BodyHandler>(const HttpRequest &)> streaming_route; // set instead of route for streaming routes
 
     // constructor
     RouteTableEntry(const std::string &method, const std::string &path,
                     const std::function<void(const HttpRequest &, HttpResponse &)> &route)
-        : method(method), path(path), route(route) {}
+        : method(method), path(path), route(route), streaming_route(nullptr) {}
+    // constructor (streaming route)
+    RouteTableEntry(const std::string &method, const std::string &path,
+                    const std::function<std::shared_ptr<BodyHandler>(const HttpRequest &)> &streaming_route)
+        : method(method), path(path), route(nullptr), streaming_route(streaming_route) {}
     // delete default constructor
     RouteTableEntry() = delete;
 };
@@ -40,13 +58,24 @@ public:
     // constants
     static const std::string version;                               // HTTP version (HTTP/1.1)
     static const std::unordered_set<std::string> supported_methods; // GET, HEAD, POST, PUT
+    static const int heartbeat_interval_ms;                         // time between heartbeats sent to load balancer
 
     // server fields
-    static int port;                                   // port server runs on
-    static int admin_port;                             // port admin connections are serviced on
-    static std::string static_dir;                     // location of static files that server may wish to serve
-    static std::vector<RouteTableEntry> routing_table; // routing table entries for server - order in which routes are registered matters when matching routes
-    static std::atomic<bool> is_dead;                  // tracks if the server is currently dead (from an admin kill command)
+    static int port;                                               // port server runs on
+    static int admin_port;                                         // port admin connections are serviced on
+    static std::string static_dir;                                 // location of static files that server may wish to serve
+    static std::vector<RouteTableEntry> routing_table;             // routing table entries for server - order in which routes are registered matters when matching routes
+    static std::unordered_map<std::string, RouteTrie> route_tries; // routing table compiled per method (trie values are indices into routing table)
+    static std::atomic<bool> is_dead;                              // tracks if the server is currently dead (from an admin kill command)
+    static std::atomic<int> active_requests;                       // requests currently being handled or sent (reported to load balancer in each heartbeat)
+    static std::atomic<int> open_connections;                      // client connections currently open (reported to load balancer in each heartbeat)
+    static int backlog;                                            // max pending connections on listening sockets - may be set before run
+    static bool reactor_mode;                                      // serve clients from an epoll event loop + worker pool instead of a thread per connection - may be set before run
+    static int num_worker_threads;                                 // number of threads handling requests in reactor mode - may be set before run
+    static int compression_level;                                  // gzip level for dynamic responses (1-9, 0 disables compression) - may be set before run
+    static size_t compression_min_size;                            // dynamic responses smaller than this are sent uncompressed - may be set before run
+    static bool metrics_enabled;                                   // record per-route latency histograms and serve them at /metrics - may be set before run
+    static size_t max_body_size;                                   // request bodies larger than this are rejected with 413 (streamed ones too) - may be set before run
 
     // active connection fields (clients)
     static std::unordered_map<pthread_t, std::atomic<bool>> client_connections;
@@ -55,6 +84,15 @@ public:
 private:
     static std::shared_timed_mutex kvs_mutex;                                              // mutex for client kvs addresses
     static std::unordered_map<std::string, std::vector<std::string>> client_kvs_addresses; // map for user kvs addresses
+    static std::unordered_map<std::string, uint64_t> client_kvs_versions;                  // coordinator routing version each user's address was looked up at
+
+    // reactor mode fields
+    static int epoll_fd;                                                     // epoll instance watching listening socket and idle client connections
+    static std::unordered_map<int, std::shared_ptr<Client>> reactor_clients; // open client connections (keyed by fd)
+    static std::mutex reactor_clients_lock;                                  // lock for open client connections
+    static std::queue<int> ready_clients;                                    // fds of connections with bytes to read, waiting for a worker
+    static std::mutex ready_clients_lock;                                    // lock for ready clients
+    static std::condition_variable ready_clients_cv;                         // notifies workers that a connection is ready
 
     // methods
 public:
@@ -64,6 +102,8 @@ public:
     // route handlers
     static void get(const std::string &path, const std::function<void(const HttpRequest &, HttpResponse &)> &route);  // register GET route with handler
     static void post(const std::string &path, const std::function<void(const HttpRequest &, HttpResponse &)> &route); // register POST route with handler
+    // register POST route whose body is streamed to a body handler created for each request (instead of buffered in the request)
+    static void post_stream(const std::string &path, const std::function<std::shared_ptr<BodyHandler>(const HttpRequest &)> &streaming_route);
 
     // Admin communication
     static int dispatch_admin_listener_thread();                 // dispatch thread to read from admin
@@ -72,21 +112,31 @@ public:
     static void admin_live();                                    // handles live command from admin console
 
     // helper functions to safely access client kvs addresses
-    static bool check_kvs_addr(std::string username);
+    static bool check_kvs_addr(std::string username, uint64_t min_version = 0); // cached addresses looked up before min_version count as missing
     static bool delete_kvs_addr(std::string username);
     static std::vector<std::string> get_kvs_addr(std::string username);
-    static bool set_kvs_addr(std::string username, std::string kvs_address);
+    static bool set_kvs_addr(std::string username, std::string kvs_address, uint64_t version = 0);
 
     // send heartbeat to LOAD BALANCER
     static void start_heartbeat_thread(int lb_port, int server_port);
-    static void send_heartbeat(int lb_port, int server_port);
+    // send one heartbeat datagram carrying server's load (latency buckets seen by the previous heartbeat are updated, so p99 covers the last interval)
+    static void send_heartbeat(int heartbeat_sock_fd, int server_port, std::vector<uint64_t> &prev_latency_buckets);
+    static int queued_connections(); // connections waiting for a worker (reactor mode only)
 
 private:
     // make default constructor private
     HttpServer() {}
 
-    static int bind_socket(int port);        // bind port to socket
-    static void accept_and_handle_clients(); // main server loop to accept and handle clients
+    static int bind_socket(int port);                         // bind port to socket
+    static void register_route(const RouteTableEntry &entry); // add route to routing table and route trie
+    static void accept_and_handle_clients();                  // main server loop to accept and handle clients
+
+#ifdef __linux__
+    // Reactor mode methods
+    static void run_event_loop(int client_comm_sock_fd);         // accept clients and queue readable connections for workers
+    static void accept_reactor_clients(int client_comm_sock_fd); // accept every pending connection and register it with epoll
+    static void handle_ready_clients();                          // worker loop to read and respond to queued connections
+#endif
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,58 @@
+#ifndef MULTIPART_PARSER_H
+#define MULTIPART_PARSER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <cstddef>
+#include <algorithm>
+
+#include "../../utils/include/utils.h"
+
+// Incremental multipart/form-data parser
+// Body chunks are fed in as they arrive, and each part is reported through callbacks, so only a delimiter's worth of
+// the body (plus the headers of the current part) is buffered at any time
+class MultipartParser
+{
+    // fields
+public:
+    std::function<void(const std::unordered_map<std::string, std::string> &)> on_part_begin; // part headers (lowercase names) have been parsed
+    std::function<void(const char *, size_t)> on_part_data;                                  // next chunk of the current part's data
+    std::function<void()> on_part_end;                                                       // current part's data is complete
+
+private:
+    static const size_t max_part_headers_len; // part headers longer than this are rejected
+
+    enum class State
+    {
+        PREAMBLE,   // before first delimiter
+        PART_START, // after a delimiter - expecting CRLF (another part) or "--" (end of body)
+        HEADERS,    // reading part headers
+        DATA,       // reading part data
+        EPILOGUE,   // after close delimiter - remaining bytes are ignored
+        ERROR       // malformed body - remaining bytes are ignored
+    };
+
+    std::string delimiter;     // CRLF + "--" + boundary
+    size_t skip_table[256];    // Boyer-Moore-Horspool shift for each byte value
+    std::vector<char> pending; // bytes received that could not be consumed yet (possible partial delimiter or partial headers)
+    State state;               // current position in multipart body
+
+    // methods
+public:
+    MultipartParser(const std::string &boundary);
+    MultipartParser() = delete;
+
+    static std::string boundary_from_content_type(const std::string &content_type); // extract boundary from Content-Type header value (empty if not present)
+
+    void feed(const char *data, size_t len); // parse next chunk of body
+    bool is_complete() const;                // close delimiter has been parsed
+    bool has_error() const;                  // body was malformed
+
+private:
+    size_t find_delimiter(size_t start) const;   // Boyer-Moore-Horspool search of pending for delimiter. Returns pending size if not found.
+    bool parse_part_headers(size_t headers_end); // parse part headers at the front of pending and report them
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef ROUTE_TRIE_H
+#define ROUTE_TRIE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <unordered_map>
+
+// Routes for one method compiled into a trie of path segments
+// Each node's children are literal segments (sorted for binary search), a ":param" child and a "*" terminal that matches
+// the rest of the path. A path matches the route that was registered first among all routes matching it, which is the
+// same result as scanning the routing table in registration order.
+class RouteTrie
+{
+    // fields
+private:
+    struct Node
+    {
+        std::vector<std::pair<std::string, std::unique_ptr<Node>>> literal_children; // sorted by segment
+        std::unique_ptr<Node> param_child;                                           // child matching any segment (":param")
+        int route_index;                                                             // route ending at this node (-1 if none)
+        std::vector<std::string> route_params;                                       // param names of route ending at this node
+        int wildcard_route_index;                                                    // route with "*" after this node - matches 1+ remaining segments (-1 if none)
+        std::vector<std::string> wildcard_route_params;                              // param names of wildcard route
+
+        Node() : route_index(-1), wildcard_route_index(-1) {}
+    };
+
+    // best match found while searching trie
+    struct Match
+    {
+        int route_index;                                 // -1 if no route matched
+        const std::vector<std::string> *route_params;    // param names of matched route
+        std::vector<std::pair<size_t, size_t>> captures; // offset and length in path of each param value
+    };
+
+    Node root;                 // node for empty path ("/")
+    int match_all_route_index; // route registered with path "*" (matches every path, -1 if none)
+
+    // methods
+public:
+    RouteTrie() : root(), match_all_route_index(-1) {}
+
+    void insert(const std::string &path, int route_index); // compile route path into trie
+    // find first registered route matching path (-1 if none) and store its param values (keyed without ":") in params
+    int match(const std::string &path, std::unordered_map<std::string, std::string> &params) const;
+
+private:
+    void match_node(const Node *node, const std::string &path, size_t pos, std::vector<std::pair<size_t, size_t>> &captures, Match &best) const;
+    static bool segment_less(const std::string &segment, const char *data, size_t len); // compares stored segment to path segment without copying it
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef STATIC_FILE_CACHE_H
+#define STATIC_FILE_CACHE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <shared_mutex>
+#include <fstream>
+#include <cstdint>
+#include <sstream>
+#include <sys/stat.h> // stat
+
+#include "http_compression.h"
+
+// static file along with metadata computed when the file is loaded
+struct StaticFile
+{
+    std::string path;                           // path of file on disk
+    size_t size;                                // size of file in bytes
+    int64_t mtime_ns;                           // last modification time of file (used to detect changes)
+    std::string etag;                           // entity tag derived from size and modification time
+    std::string content_type;                   // content type derived from file extension
+    std::shared_ptr<std::vector<char>> data;    // file contents (nullptr if file is too large to cache - it's streamed from disk)
+    std::shared_ptr<std::vector<char>> gzipped; // gzip encoded file contents (nullptr if file is not compressible or compressing didn't help)
+};
+
+class StaticFileCache
+{
+    // fields
+public:
+    static const size_t max_cached_file_size; // files larger than this are not held in memory
+    static const size_t max_cache_size;       // total bytes of file contents held in memory
+    static bool validate_mtime;               // stat file on every lookup and reload it if it changed (otherwise files are cached until restart) - may be set before run
+
+private:
+    static std::unordered_map<std::string, std::shared_ptr<const StaticFile>> entries; // cached files keyed by path
+    static size_t cache_size;                                                         // total bytes of file contents currently held in memory
+    static std::shared_timed_mutex cache_lock;                                        // read-write lock for entries and cache size
+
+    // methods
+public:
+    static std::shared_ptr<const StaticFile> lookup(const std::string &path); // get file at path, loading it if needed. Returns nullptr if file is not a readable regular file.
+
+private:
+    // make default constructor private
+    StaticFileCache() {}
+
+    static std::shared_ptr<StaticFile> load(const std::string &path, const struct stat &file_stat, bool cache_contents); // read file and compute its metadata
+    static std::string content_type_for(const std::string &path);                                                     // content type of file based on its extension
+    static int64_t mtime_ns_of(const struct stat &file_stat);                                                          // modification time from stat in nanoseconds
+};
+
+#endif
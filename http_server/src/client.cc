@@ -2,15 +2,96 @@
 
 const std::string Client::CRLF = "\r\n";
 const std::string Client::DOUBLE_CRLF = "\r\n\r\n";
+const size_t Client::BODY_PRESIZE_LIMIT = 1024 * 1024;
 
 Logger http_client_logger("HTTP Client");
 
+// locate the next CRLF in [begin, end) - returns end if none is found
+// memchr lets libc scan the buffer a word (or vector register) at a time instead of byte by byte
+static const char *find_crlf(const char *begin, const char *end)
+{
+    while (begin < end)
+    {
+        const char *cr = static_cast<const char *>(std::memchr(begin, '\r', end - begin));
+        if (cr == nullptr || cr + 1 >= end)
+        {
+            return end;
+        }
+        if (cr[1] == '\n')
+        {
+            return cr;
+        }
+        begin = cr + 1;
+    }
+    return end;
+}
+
+// trim whitespace from both ends of [begin, end) in place
+static void trim_bounds(const char *&begin, const char *&end)
+{
+    while (begin < end && std::isspace(static_cast<unsigned char>(*begin)))
+    {
+        begin++;
+    }
+    while (end > begin && std::isspace(static_cast<unsigned char>(*(end - 1))))
+    {
+        end--;
+    }
+}
+
 void Client::read_from_network()
 {
-    std::string client_stream;
+    HttpServer::open_connections++;
     int bytes_recvd;
     while (true)
     {
+        // body of current request is still pending and every buffered byte was consumed - receive directly into the body
+        if (remaining_body_len > 0)
+        {
+            // streaming route - body is handed to route's body handler a chunk at a time
+            char body_chunk[16384];
+            if (body_handler != nullptr)
+            {
+                bytes_recvd = recv(client_fd, body_chunk, std::min(sizeof(body_chunk), static_cast<size_t>(remaining_body_len)), 0);
+            }
+            else
+            {
+                // body grows as bytes arrive, so memory is only committed for bytes the client actually sent
+                size_t body_offset = req.body.size();
+                size_t chunk_len = std::min(sizeof(body_chunk), static_cast<size_t>(remaining_body_len));
+                req.body.resize(body_offset + chunk_len);
+                bytes_recvd = recv(client_fd, req.body.data() + body_offset, chunk_len, 0);
+                req.body.resize(body_offset + std::max(bytes_recvd, 0));
+            }
+
+            if (bytes_recvd < 0)
+            {
+                http_client_logger.log("Error reading from client", 40);
+                break;
+            }
+            else if (bytes_recvd == 0)
+            {
+                http_client_logger.log("Client closed connection", LOGGER_INFO);
+                break;
+            }
+            if (body_handler != nullptr)
+            {
+                body_handler->on_body_chunk(body_chunk, bytes_recvd);
+            }
+            remaining_body_len -= bytes_recvd;
+
+            // req is complete - prepare and send response
+            if (remaining_body_len == 0)
+            {
+                respond_to_req();
+                if (close_connection)
+                {
+                    break;
+                }
+            }
+            continue;
+        }
+
         char buf[4096];
         bytes_recvd = recv(client_fd, buf, 4096, 0);
         if (bytes_recvd < 0)
@@ -23,83 +104,190 @@ void Client::read_from_network()
             http_client_logger.log("Client closed connection", LOGGER_INFO);
             break;
         }
+        handle_bytes(buf, bytes_recvd);
+        if (close_connection)
+        {
+            break;
+        }
+    }
+    // set this thread's flag to false to indicate that thread should be joined
+    HttpServer::client_connections[pthread_self()] = false;
+    HttpServer::open_connections--;
+    close(client_fd);
+}
+
+void Client::handle_bytes(const char *data, size_t len)
+{
+    client_stream.append(data, len);
 
-        for (int i = 0; i < bytes_recvd; i++)
+    // consume as many complete requests (or request body bytes) as the stream holds
+    size_t consumed = 0;
+    while (consumed < client_stream.size() && !close_connection)
+    {
+        // bytes are part of request body
+        if (remaining_body_len > 0)
         {
-            // byte is part of request body
-            if (remaining_body_len > 0)
+            size_t body_bytes = std::min(static_cast<size_t>(remaining_body_len), client_stream.size() - consumed);
+            if (body_handler != nullptr)
             {
-                req.body.push_back(buf[i]);
-                remaining_body_len--;
-
-                // prev req is complete - prepare and send response
-                if (remaining_body_len == 0)
-                {
-                    handle_req();
-                    if (!response_ready)
-                    {
-                        construct_response();
-                    }
-                    send_response();
-
-                    if (close_connection)
-                    {
-                        break;
-                    }
-                }
+                body_handler->on_body_chunk(client_stream.data() + consumed, body_bytes);
             }
-            // byte is part of client_stream (building request)
             else
             {
-                client_stream += buf[i];
-                // double CRLF indicates a full http request WITHOUT the body (if present)
-                if (client_stream.length() >= 4 && client_stream.substr(client_stream.length() - 4) == DOUBLE_CRLF)
-                {
-                    // build http request from client stream and then clear current stream
-                    parse_req(client_stream);
-                    client_stream.clear();
-
-                    // request had content-length of 0
-                    if (remaining_body_len == 0)
-                    {
-                        handle_req();
-                        if (!response_ready)
-                        {
-                            construct_response();
-                        }
-                        send_response();
-                        if (close_connection)
-                        {
-                            break;
-                        }
-                    }
-                }
+                req.body.insert(req.body.end(), client_stream.data() + consumed, client_stream.data() + consumed + body_bytes);
             }
+            consumed += body_bytes;
+            remaining_body_len -= body_bytes;
+
+            // prev req is complete - prepare and send response
+            if (remaining_body_len == 0)
+            {
+                respond_to_req();
+            }
+            continue;
         }
 
-        if (close_connection)
+        // bytes are part of request line + headers
+        // double CRLF indicates a full http request WITHOUT the body (if present)
+        size_t header_end = client_stream.find(DOUBLE_CRLF, std::max(consumed, scan_offset));
+        if (header_end == std::string::npos)
         {
+            // double CRLF may straddle this recv and the next, so the last 3 bytes must be rescanned
+            scan_offset = std::max(consumed, client_stream.size() < 3 ? 0 : client_stream.size() - 3);
             break;
         }
+
+        // build http request directly from client stream (last header's CRLF is included)
+        auto parse_start = std::chrono::steady_clock::now();
+        parse_req(client_stream.data() + consumed, client_stream.data() + header_end + 2);
+        consumed = header_end + DOUBLE_CRLF.length();
+        scan_offset = consumed;
+
+        // request line + headers are all that's needed to route the request, so it's routed before its body arrives
+        handle_req();
+        prepare_body();
+        stage_ns[HttpMetrics::PARSE] = HttpMetrics::elapsed_ns(parse_start);
+
+        // request had content-length of 0
+        if (remaining_body_len == 0)
+        {
+            respond_to_req();
+        }
     }
-    // set this thread's flag to false to indicate that thread should be joined
-    HttpServer::client_connections[pthread_self()] = false;
-    close(client_fd);
+
+    // drop consumed bytes once per recv rather than once per request
+    client_stream.erase(0, consumed);
+    scan_offset = scan_offset > consumed ? scan_offset - consumed : 0;
+}
+
+/// @brief reads every byte currently available on the connection without blocking (reactor mode). Returns false once the connection should be closed.
+bool Client::read_available()
+{
+    while (true)
+    {
+        char buf[16384];
+        int bytes_recvd = recv(client_fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (bytes_recvd < 0)
+        {
+            // all available bytes were read - connection waits for next readiness event
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return true;
+            }
+            else if (errno == EINTR)
+            {
+                continue;
+            }
+            http_client_logger.log("Error reading from client", 40);
+            return false;
+        }
+        else if (bytes_recvd == 0)
+        {
+            http_client_logger.log("Client closed connection", LOGGER_INFO);
+            return false;
+        }
+
+        handle_bytes(buf, bytes_recvd);
+        if (close_connection)
+        {
+            return false;
+        }
+    }
+}
+
+void Client::prepare_body()
+{
+    if (remaining_body_len <= 0)
+    {
+        return;
+    }
+
+    // refuse bodies over the limit before buffering them or handing them to a streaming route's handler
+    // (the unread body can't be skipped, so the connection is closed after the response)
+    if (!response_ready && static_cast<size_t>(remaining_body_len) > HttpServer::max_body_size)
+    {
+        http_client_logger.log("(413) Request body of " + std::to_string(remaining_body_len) + " bytes exceeds limit", 40);
+        construct_error_response(413);
+        close_connection = true;
+        remaining_body_len = 0;
+        return;
+    }
+
+    // streaming route - create the handler that the body will be fed to (never more than content length bytes)
+    if (!response_ready && req.streaming_route)
+    {
+        body_handler = req.streaming_route(req);
+        return;
+    }
+
+    // reserve up to a cap from content length so most bodies don't reallocate - larger bodies grow as their bytes arrive
+    req.body.reserve(std::min(static_cast<size_t>(remaining_body_len), BODY_PRESIZE_LIMIT));
+}
+
+void Client::respond_to_req()
+{
+    HttpServer::active_requests++;
+
+    // KVS wait is only attributed to the handler it occurred in
+    auto handler_start = std::chrono::steady_clock::now();
+    HttpMetrics::take_kvs_wait();
+    if (!response_ready)
+    {
+        construct_response();
+    }
+    stage_ns[HttpMetrics::HANDLER] = HttpMetrics::elapsed_ns(handler_start);
+    stage_ns[HttpMetrics::KVS_WAIT] = HttpMetrics::take_kvs_wait();
+
+    auto send_start = std::chrono::steady_clock::now();
+    send_response();
+    stage_ns[HttpMetrics::SEND] = HttpMetrics::elapsed_ns(send_start);
+
+    if (HttpServer::metrics_enabled)
+    {
+        HttpMetrics::record_request(metrics_route, stage_ns);
+    }
+    metrics_route = -1;
+    HttpServer::active_requests--;
 }
 
-void Client::parse_req(std::string &client_stream)
+void Client::parse_req(const char *begin, const char *end)
 {
-    std::vector<std::string> msg_lines = Utils::split(client_stream, CRLF);
+    // skip empty lines preceding the request line
+    const char *line_end = find_crlf(begin, end);
+    while (line_end == begin && begin < end)
+    {
+        begin += CRLF.length();
+        line_end = find_crlf(begin, end);
+    }
 
-    parse_req_line(msg_lines.at(0));
+    parse_req_line(begin, line_end);
     // Error occurred while parsing req line - this is the only acceptable early exit
     if (response_ready)
     {
         return;
     }
 
-    msg_lines.erase(msg_lines.begin());
-    parse_headers(msg_lines);
+    parse_headers(std::min(line_end + CRLF.length(), end), end);
 
     // check if http message has a body
     std::vector<std::string> content_length_vals = req.get_header("content-length");
@@ -125,50 +313,88 @@ void Client::parse_req(std::string &client_stream)
                 construct_error_response(400);
                 return;
             }
+
         }
     }
 }
 
-void Client::parse_req_line(std::string &req_line)
+void Client::parse_req_line(const char *begin, const char *end)
 {
-    std::vector<std::string> req_line_components = Utils::split(req_line, " ");
+    // split request line on " " (consecutive spaces are skipped)
+    std::string *req_line_components[3] = {&req.method, &req.path, &req.version};
+    size_t num_components = 0;
+    const char *token_start = begin;
+    while (token_start < end)
+    {
+        const char *token_end = std::find(token_start, end, ' ');
+        if (token_end != token_start)
+        {
+            // preliminary validation - request line has more than 3 components
+            if (num_components == 3)
+            {
+                num_components++;
+                break;
+            }
+            req_line_components[num_components++]->assign(token_start, token_end);
+        }
+        token_start = token_end + 1;
+    }
 
     // preliminary validation - request line does NOT have 3 components
-    if (req_line_components.size() != 3)
+    if (num_components != 3)
     {
         http_client_logger.log("(400) Malformed request line", 40);
         construct_error_response(400);
         return;
     }
-    req.method = req_line_components.at(0);
-    req.path = req_line_components.at(1);
-    req.version = req_line_components.at(2);
 }
 
-void Client::parse_headers(std::vector<std::string> &headers)
+void Client::parse_headers(const char *begin, const char *end)
 {
-    for (std::string &header : headers)
+    while (begin < end)
     {
-        std::vector<std::string> header_components = Utils::split_on_first_delim(header, ":");
+        const char *line_end = find_crlf(begin, end);
+        const char *line_start = begin;
+        begin = std::min(line_end + CRLF.length(), end);
+
+        // skip empty lines
+        if (line_end == line_start)
+        {
+            continue;
+        }
 
         // malformed header - header type and value(s) are not separated by ":"
-        if (header_components.size() != 2)
+        const char *colon = static_cast<const char *>(std::memchr(line_start, ':', line_end - line_start));
+        if (colon == nullptr || colon == line_start || colon + 1 == line_end)
         {
             http_client_logger.log("(400) Malformed header", 40);
             construct_error_response(400);
-            // do not return, since content length header may still need to be parsed
+            // do not continue parsing this line, since content length header may still need to be parsed
             // if content length header is not provided or malformed, then behavior is undefined
             continue;
         }
-        std::string header_key = Utils::to_lowercase(header_components.at(0));
-        std::string header_values = Utils::trim(header_components.at(1));
+        std::string header_key(line_start, colon);
+        for (char &c : header_key)
+        {
+            c = std::tolower(c);
+        }
+        std::vector<std::string> &header_values = req.headers[header_key];
 
-        // split header_values on ",", trim each value, and add it to the vector for the header_key
-        std::vector<std::string> header_values_vec = Utils::split(header_values, ",");
-        for (std::string &value : header_values_vec)
+        // split values on ",", trim each value, and add it to the vector for the header_key
+        const char *values_start = colon + 1;
+        const char *values_end = line_end;
+        trim_bounds(values_start, values_end);
+        while (values_start < values_end)
         {
-            value = Utils::trim(value);
-            req.headers[header_key].push_back(value);
+            const char *value_end = std::find(values_start, values_end, ',');
+            if (value_end != values_start)
+            {
+                const char *value_start = values_start;
+                const char *trimmed_end = value_end;
+                trim_bounds(value_start, trimmed_end);
+                header_values.emplace_back(value_start, trimmed_end);
+            }
+            values_start = value_end + 1;
         }
     }
 
@@ -222,6 +448,9 @@ void Client::handle_req()
 
 void Client::set_req_type()
 {
+    // keep the target as received, since query parameters are split off path below
+    req.target = req.path;
+
     // parse query parameters
     size_t param_start = req.path.find_first_of('?');
     if (param_start != std::string::npos)
@@ -240,79 +469,27 @@ void Client::set_req_type()
         req.path = req.path.substr(0, param_start + 1);
     }
 
-    // match incoming request path to stored dynamic routes
-    std::vector<std::string> req_path_tokens = Utils::split(req.path, "/");
-
-    // check routes in routing table
-    for (RouteTableEntry &route : HttpServer::routing_table)
+    // metrics are served ahead of every registered route (including a catch-all route)
+    if (HttpServer::metrics_enabled && (req.method == "GET" || req.method == "HEAD") && req.path == HttpMetrics::metrics_path)
     {
-        // methods must match for the request to match the route
-        if (route.method != req.method)
-        {
-            continue;
-        }
-
-        // handle special wildcard route - this matches any route
-        if (route.path == "*")
-        {
-            req.dynamic_route = route.route;
-            req.is_static = false;
-            break;
-        }
-
-        // split path in routing table on "/"
-        std::vector<std::string> route_path_tokens = Utils::split(route.path, "/");
-
-        // we have two options
-        // Option 1 - route path does NOT have a wildcard as the last token
-        // lengths must match exactly
-        // Option 2 - route path has a wildcard as the last token
-        // lengths don't need to match BUT req path must be >= route path
-
-        // check if the route has a wildcard
-        // note that the tokens must be non-empty for us to check this, so we use a conditional here
-        bool route_has_wildcard = route_path_tokens.size() != 0 ? route_path_tokens.back() == "*" : false;
-
-        // route does NOT contain wildcard - size of tokens must match directly
-        if (!route_has_wildcard && route_path_tokens.size() != req_path_tokens.size())
-        {
-            continue;
-        }
-        // route contains wildcard - number of request tokens must AT LEAST be as long as the route
-        if (route_has_wildcard && req_path_tokens.size() < route_path_tokens.size())
-        {
-            continue;
-        }
-
-        // iterate route path tokens and check if there's a match for each token
-        bool dynamic_route_found = true;
-        for (size_t i = 0; i < route_path_tokens.size(); i++)
-        {
-            std::string route_token = route_path_tokens.at(i);
-            std::string req_token = req_path_tokens.at(i);
-
-            // tokens are a direct match OR
-            // route token starts with ":" which matches any value
-            if (req_token == route_token || route_token.front() == ':')
-            {
-                continue;
-            }
-            // route token is *, in which case we're done and we can break since * catches everything
-            else if (route_token == "*")
-            {
-                break;
-            }
-            else
-            {
-                dynamic_route_found = false;
-            }
-        }
+        req.dynamic_route = HttpMetrics::metrics_handler;
+        req.is_static = false;
+        metrics_route = HttpMetrics::metrics_route_slot();
+        return;
+    }
 
-        if (dynamic_route_found)
+    // match incoming request path against routes compiled for the request's method
+    auto route_trie = HttpServer::route_tries.find(req.method);
+    if (route_trie != HttpServer::route_tries.end())
+    {
+        int route_index = route_trie->second.match(req.path, req.path_params);
+        if (route_index != -1)
         {
+            RouteTableEntry &route = HttpServer::routing_table.at(route_index);
             req.dynamic_route = route.route;
+            req.streaming_route = route.streaming_route;
             req.is_static = false;
-            break;
+            metrics_route = route_index;
         }
     }
 
@@ -328,21 +505,20 @@ void Client::set_req_type()
         // set resource path for current request
         req.static_resource_path = HttpServer::static_dir + req.path;
 
-        // verify that the file can be opened (file exists)
-        std::ifstream resource(req.static_resource_path);
-        if (!resource.is_open())
+        // check if user is trying to access server files (checked before the file is looked up so it's never loaded)
+        if (req.static_resource_path.find("..") != std::string::npos)
         {
-            http_client_logger.log("(404) Failed to open static file", 40);
-            construct_error_response(404);
+            http_client_logger.log("(403) Accessing forbidden files", 40);
+            construct_error_response(403);
             return;
         }
-        resource.close();
 
-        // check if user is trying to access server files
-        if (req.static_resource_path.find("..") != std::string::npos)
+        // look up file in static file cache (file is loaded on first request)
+        static_file = StaticFileCache::lookup(req.static_resource_path);
+        if (static_file == nullptr)
         {
-            http_client_logger.log("(403) Accessing forbidden files", 40);
-            construct_error_response(403);
+            http_client_logger.log("(404) Failed to open static file", 40);
+            construct_error_response(404);
             return;
         }
 
@@ -353,6 +529,7 @@ void Client::set_req_type()
             construct_error_response(405);
             return;
         }
+        metrics_route = HttpMetrics::static_route_slot();
     }
 }
 
@@ -380,64 +557,154 @@ void Client::construct_response()
     // static response
     if (req.is_static)
     {
-        // set content-type header
-        std::string content_type = "application/octet-stream"; // default content type
-        size_t pos = req.path.find_last_of('.');
-        if (pos != std::string::npos)
+        // set headers precomputed when file was cached
+        res.set_header("Content-Type", static_file->content_type);
+        res.set_header("ETag", static_file->etag);
+        if (static_file->gzipped != nullptr)
         {
-            std::string extension = req.path.substr(pos + 1);
-            if (extension == "txt")
-            {
-                content_type = "text/plain";
-            }
-            else if (extension == "jpeg" || extension == "jpg")
-            {
-                content_type = "image/jpeg";
-            }
-            else if (extension == "html")
-            {
-                content_type = "text/html";
-            }
+            res.set_header("Vary", "Accept-Encoding");
         }
-        res.set_header("Content-Type", content_type);
 
-        // write body
-        // open file in binary form and write bytes to body
-        std::ifstream resource(req.static_resource_path, std::ios::binary);
+        // client's copy of the file is current - no body is sent
+        if (etag_matches())
+        {
+            res.set_code(304);
+            response_ready = true;
+            return;
+        }
 
-        std::vector<char> buffer(1024);
-        while (resource.read(buffer.data(), 1024))
+        // body is sent straight from the cache (or from disk if file is too large to cache) rather than copied into response
+        if (static_file->gzipped != nullptr && HttpCompression::accepts_gzip(req))
+        {
+            res.set_header("Content-Encoding", "gzip");
+            static_body = static_file->gzipped;
+        }
+        else
         {
-            res.append_body_bytes(buffer.data(), resource.gcount());
+            static_body = static_file->data;
         }
-        res.append_body_bytes(buffer.data(), resource.gcount());
-        resource.close();
     }
     // dynamic response
     else
     {
-        req.dynamic_route(req, res);
+        // streaming route - handler constructs response once it has seen the whole body
+        if (req.streaming_route)
+        {
+            // handler is only created ahead of time if the request has a body
+            if (body_handler == nullptr)
+            {
+                body_handler = req.streaming_route(req);
+            }
+            body_handler->on_body_end(req, res);
+        }
+        else
+        {
+            req.dynamic_route(req, res);
+        }
     }
 
     // response is ready to send back to client
     response_ready = true;
 }
 
+/// @brief gzips body of a dynamic response if the client accepts it and the body is large enough to benefit
+/// Compression runs on the thread sending the response - a connection thread, or a pool worker in reactor mode (never the event loop).
+void Client::compress_response()
+{
+    // static files are precompressed when cached, streamed bodies aren't available here, and non-200 bodies are short error pages
+    if (req.is_static || res.body_producer != nullptr || res.code != 200)
+    {
+        return;
+    }
+    if (HttpServer::compression_level <= 0 || res.body.size() < HttpServer::compression_min_size || res.headers.count("Content-Encoding") != 0)
+    {
+        return;
+    }
+    // handlers that don't set a content type build html/text pages
+    auto content_type = res.headers.find("Content-Type");
+    if (content_type != res.headers.end() && !HttpCompression::is_compressible_type(content_type->second.front()))
+    {
+        return;
+    }
+
+    // response varies on Accept-Encoding whether or not this client gets it compressed
+    res.set_header("Vary", "Accept-Encoding");
+    if (!HttpCompression::accepts_gzip(req))
+    {
+        return;
+    }
+
+    std::vector<char> compressed_body;
+    if (!HttpCompression::gzip(res.body.data(), res.body.size(), HttpServer::compression_level, compressed_body) || compressed_body.size() >= res.body.size())
+    {
+        return;
+    }
+    res.body.swap(compressed_body);
+    res.set_header("Content-Encoding", "gzip");
+}
+
+/// @brief checks if an If-None-Match header on the request matches the static file's etag
+bool Client::etag_matches()
+{
+    for (std::string etag : req.get_header("if-none-match"))
+    {
+        // weak comparison - W/ prefix is ignored
+        if (etag.compare(0, 2, "W/") == 0)
+        {
+            etag = etag.substr(2);
+        }
+        if (etag == "*" || etag == static_file->etag)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 void Client::send_response()
 {
+    // compress dynamic body before its length is recorded
+    compress_response();
+
+    // static file bodies are sent from the cache or from disk instead of from the response body
+    const char *body_data = res.body.data();
+    size_t body_len = res.body.size();
+    bool body_from_disk = false;
+    if (static_file != nullptr && res.code == 200)
+    {
+        body_from_disk = static_body == nullptr;
+        body_data = body_from_disk ? nullptr : static_body->data();
+        body_len = body_from_disk ? static_file->size : static_body->size();
+    }
+
+    // streamed responses are chunked unless handler provided the length of the body
+    bool streamed = res.body_producer != nullptr;
+    bool chunked = streamed && res.headers.count("Content-Length") == 0;
+
     // add standard headers to maintain consistent in responses
-    res.set_header("Server", "5050-Web-Server/1.0");                   // server identity
-    res.set_header("Content-Length", std::to_string(res.body.size())); // content-length
+    res.set_header("Server", "5050-Web-Server/1.0"); // server identity
+    if (chunked)
+    {
+        res.set_header("Transfer-Encoding", "chunked");
+    }
+    else if (!streamed && res.code != 304)
+    {
+        res.set_header("Content-Length", std::to_string(body_len)); // content-length
+    }
 
-    // clear body if it's a head request
-    if (req.method == "HEAD")
+    // no body is sent if it's a head request
+    bool send_body = req.method != "HEAD";
+    if (!send_body || streamed)
     {
-        res.body.clear();
+        body_len = 0;
     }
 
-    // log request metadata (reconstruct request line from parsed parameters to ensure correct parsing)
-    std::string log_str = req.method + " " + req.path + " " + std::to_string(res.code) + " - " + std::to_string(res.body.size());
-    req.is_static ? http_client_logger.log("[static] " + log_str, 20) : http_client_logger.log("[dynamic] " + log_str, 20);
+    // log request metadata (reconstruct request line from parsed parameters to ensure correct parsing) - line is only built if it will be logged
+    if (Logger::enabled(20))
+    {
+        std::string log_str = req.method + " " + req.path + " " + std::to_string(res.code) + " - " + (streamed && send_body ? "streamed" : std::to_string(body_len));
+        req.is_static ? http_client_logger.log("[static] " + log_str, 20) : http_client_logger.log("[dynamic] " + log_str, 20);
+    }
 
     std::ostringstream response_msg;
 
@@ -453,25 +720,173 @@ void Client::send_response()
         }
     }
     response_msg << CRLF;
-
-    // Allocate buffer for complete response
-    std::vector<char> response_buffer(response_msg.str().length() + res.body.size());
-    std::memcpy(response_buffer.data(), response_msg.str().c_str(), response_msg.str().length());
-    if (!res.body.empty())
+    std::string response_head = response_msg.str();
+
+    // write head and in-memory body with one gathered write, so the body is never copied into a combined buffer
+    struct iovec response_iov[2];
+    response_iov[0].iov_base = const_cast<char *>(response_head.data());
+    response_iov[0].iov_len = response_head.length();
+    response_iov[1].iov_base = const_cast<char *>(body_data);
+    response_iov[1].iov_len = body_from_disk ? 0 : body_len;
+    bool sent = send_iov(response_iov, 2);
+
+    // bodies streamed from disk or produced by the handler follow the head
+    if (sent && body_from_disk && body_len > 0)
     {
-        std::memcpy(response_buffer.data() + response_msg.str().length(), res.body.data(), res.body.size());
+        sent = send_file(static_file->path, body_len);
+    }
+    else if (sent && streamed && send_body)
+    {
+        bool connection_ok = true;
+        if (chunked)
+        {
+            res.body_producer([this, &connection_ok](const char *data, size_t len)
+                              { return connection_ok = connection_ok && send_chunk(data, len); });
+            // last chunk is empty
+            connection_ok = connection_ok && send_chunk(nullptr, 0);
+        }
+        else
+        {
+            size_t bytes_written = 0;
+            res.body_producer([this, &connection_ok, &bytes_written](const char *data, size_t len)
+                              {
+                                  connection_ok = connection_ok && send_all(data, len);
+                                  bytes_written += connection_ok ? len : 0;
+                                  return connection_ok; });
+
+            // producer stopped short of the Content-Length it promised - the client can't find the end of this response, so the connection can't be reused
+            if (res.headers.at("Content-Length").front() != std::to_string(bytes_written))
+            {
+                http_client_logger.log("Streamed body did not match Content-Length - closing connection", 40);
+                connection_ok = false;
+            }
+        }
+        sent = connection_ok;
     }
 
-    // write response to client as bytes
-    size_t total_bytes_sent = 0;
-    while (total_bytes_sent < response_buffer.size())
+    // connection is unusable once a response was only partially sent
+    if (!sent)
     {
-        int bytes_sent = send(client_fd, response_buffer.data() + total_bytes_sent, response_buffer.size() - total_bytes_sent, 0);
-        total_bytes_sent += bytes_sent;
+        close_connection = true;
     }
 
     // clear all fields related to transaction
     req.reset();
     res.reset();
+    body_handler.reset();
+    static_file.reset();
+    static_body.reset();
     response_ready = false;
 }
+
+/// @brief sends len bytes of data to client. Returns false if the connection failed.
+bool Client::send_all(const char *data, size_t len)
+{
+    struct iovec data_iov;
+    data_iov.iov_base = const_cast<char *>(data);
+    data_iov.iov_len = len;
+    return send_iov(&data_iov, 1);
+}
+
+/// @brief sends every buffer in iov to client with writev, resuming after partial writes. Returns false if the connection failed.
+bool Client::send_iov(struct iovec *iov, int iov_count)
+{
+    while (iov_count > 0)
+    {
+        // skip buffers that were fully sent
+        if (iov->iov_len == 0)
+        {
+            iov++;
+            iov_count--;
+            continue;
+        }
+
+        ssize_t bytes_sent = writev(client_fd, iov, iov_count);
+        if (bytes_sent < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            http_client_logger.log("Error sending response to client", 40);
+            return false;
+        }
+
+        // advance past bytes that were sent
+        size_t remaining = bytes_sent;
+        while (iov_count > 0 && remaining >= iov->iov_len)
+        {
+            remaining -= iov->iov_len;
+            iov++;
+            iov_count--;
+        }
+        if (iov_count > 0)
+        {
+            iov->iov_base = static_cast<char *>(iov->iov_base) + remaining;
+            iov->iov_len -= remaining;
+        }
+    }
+    return true;
+}
+
+/// @brief sends data as one chunk of a chunked body (a 0 length chunk ends the body). Returns false if the connection failed.
+bool Client::send_chunk(const char *data, size_t len)
+{
+    // empty writes from producer must not end the body early
+    if (len == 0 && data != nullptr)
+    {
+        return true;
+    }
+
+    char chunk_size[20];
+    int chunk_size_len = snprintf(chunk_size, sizeof(chunk_size), "%zx\r\n", len);
+
+    struct iovec chunk_iov[3];
+    chunk_iov[0].iov_base = chunk_size;
+    chunk_iov[0].iov_len = chunk_size_len;
+    chunk_iov[1].iov_base = const_cast<char *>(data);
+    chunk_iov[1].iov_len = len;
+    chunk_iov[2].iov_base = const_cast<char *>(CRLF.data());
+    chunk_iov[2].iov_len = CRLF.length();
+    return send_iov(chunk_iov, 3);
+}
+
+/// @brief sends first len bytes of file at path to client without copying them through a user-space buffer where possible. Returns false if sending failed.
+bool Client::send_file(const std::string &path, size_t len)
+{
+    int file_fd = open(path.c_str(), O_RDONLY);
+    if (file_fd < 0)
+    {
+        http_client_logger.log("Unable to open static file for sending", 40);
+        return false;
+    }
+
+    size_t total_bytes_sent = 0;
+    while (total_bytes_sent < len)
+    {
+#ifdef __linux__
+        ssize_t bytes_sent = sendfile(client_fd, file_fd, nullptr, len - total_bytes_sent);
+#else
+        char buf[65536];
+        ssize_t bytes_sent = read(file_fd, buf, std::min(sizeof(buf), len - total_bytes_sent));
+        if (bytes_sent > 0 && !send_all(buf, bytes_sent))
+        {
+            bytes_sent = -1;
+        }
+#endif
+        if (bytes_sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        // file shrank after it was looked up, or the connection failed
+        if (bytes_sent <= 0)
+        {
+            http_client_logger.log("Error sending static file to client", 40);
+            close(file_fd);
+            return false;
+        }
+        total_bytes_sent += bytes_sent;
+    }
+    close(file_fd);
+    return true;
+}
@@ -0,0 +1,58 @@
+#include "../include/http_compression.h"
+
+bool HttpCompression::gzip(const char *data, size_t len, int level, std::vector<char> &out)
+{
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+
+    // window bits of 15 + 16 writes a gzip header and trailer instead of a zlib wrapper
+    if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return false;
+    }
+
+    out.resize(deflateBound(&stream, len));
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    stream.avail_in = len;
+    stream.next_out = reinterpret_cast<Bytef *>(out.data());
+    stream.avail_out = out.size();
+
+    // output buffer is sized to the bound, so a single call completes the stream
+    int status = deflate(&stream, Z_FINISH);
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return status == Z_STREAM_END;
+}
+
+bool HttpCompression::accepts_gzip(const HttpRequest &req)
+{
+    for (const std::string &encoding : req.get_header("accept-encoding"))
+    {
+        // encoding may carry a quality value (gzip;q=0.5) - q=0 means the encoding is refused
+        std::vector<std::string> params = Utils::split(encoding, ";");
+        if (params.empty() || Utils::to_lowercase(Utils::trim(params.at(0))) != "gzip")
+        {
+            continue;
+        }
+        for (size_t i = 1; i < params.size(); i++)
+        {
+            std::string param = Utils::trim(params.at(i));
+            if (param.compare(0, 2, "q=") == 0 && std::atof(param.c_str() + 2) == 0)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+bool HttpCompression::is_compressible_type(const std::string &content_type)
+{
+    return content_type.compare(0, 5, "text/") == 0 ||
+           content_type.find("json") != std::string::npos ||
+           content_type.find("javascript") != std::string::npos ||
+           content_type.find("xml") != std::string::npos;
+}
@@ -0,0 +1,289 @@
+#include "../include/http_metrics.h"
+#include "../include/http_server.h"
+
+// *********************************************
+// CONSTANTS
+// *********************************************
+
+const int HttpMetrics::num_buckets;
+const std::string HttpMetrics::metrics_path = "/metrics";
+
+// *********************************************
+// STATIC FIELD INITIALIZATION
+// *********************************************
+
+std::vector<HttpMetrics::Shard *> HttpMetrics::shards;
+std::vector<HttpMetrics::Shard *> HttpMetrics::free_shards;
+std::mutex HttpMetrics::shards_lock;
+
+// label value of each stage
+static const char *stage_names[HttpMetrics::NUM_STAGES] = {"parse", "handler", "kvs_wait", "send"};
+
+// *********************************************
+// THREAD SHARDS
+// *********************************************
+
+// owns the calling thread's shard, handing it back for reuse when the thread exits
+struct ShardHolder
+{
+    HttpMetrics::Shard *shard = nullptr;
+
+    ~ShardHolder()
+    {
+        if (shard != nullptr)
+        {
+            HttpMetrics::release_shard(shard);
+        }
+    }
+};
+
+/// @brief returns the calling thread's shard, assigning one (reused if possible) on first use
+HttpMetrics::Shard *HttpMetrics::thread_shard()
+{
+    static thread_local ShardHolder holder;
+    if (holder.shard != nullptr)
+    {
+        return holder.shard;
+    }
+
+    std::lock_guard<std::mutex> lock(shards_lock);
+    if (!free_shards.empty())
+    {
+        holder.shard = free_shards.back();
+        free_shards.pop_back();
+        return holder.shard;
+    }
+
+    // routing table is fixed once the server runs, so every shard has the same slots
+    Shard *shard = new Shard();
+    shard->num_routes = metrics_route_slot() + 1;
+    shard->routes.reset(new RouteStats[shard->num_routes]()); // value-initialized (all counters start at 0)
+    shards.push_back(shard);
+    holder.shard = shard;
+    return shard;
+}
+
+void HttpMetrics::release_shard(Shard *shard)
+{
+    std::lock_guard<std::mutex> lock(shards_lock);
+    free_shards.push_back(shard);
+}
+
+// *********************************************
+// RECORDING
+// *********************************************
+
+int HttpMetrics::static_route_slot()
+{
+    return HttpServer::routing_table.size();
+}
+
+int HttpMetrics::unmatched_route_slot()
+{
+    return HttpServer::routing_table.size() + 1;
+}
+
+int HttpMetrics::metrics_route_slot()
+{
+    return HttpServer::routing_table.size() + 2;
+}
+
+/// @brief records the stage durations of a completed request under the route slot it matched
+void HttpMetrics::record_request(int route_slot, const uint64_t stage_ns[NUM_STAGES])
+{
+    Shard *shard = thread_shard();
+    if (route_slot < 0 || static_cast<size_t>(route_slot) >= shard->num_routes)
+    {
+        route_slot = unmatched_route_slot();
+    }
+    RouteStats &stats = shard->routes[route_slot];
+
+    // only the owning thread writes to a shard, so counters are bumped with a plain load + store (no locked read-modify-write)
+    // scrapes read them with relaxed loads and may see a request's stages partially recorded, which is acceptable for metrics
+    stats.requests.store(stats.requests.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    for (int stage = 0; stage < NUM_STAGES; stage++)
+    {
+        // requests that never touched the KVS are left out of the KVS wait histogram
+        if (stage == KVS_WAIT && stage_ns[stage] == 0)
+        {
+            continue;
+        }
+
+        // bucket i holds durations in (2^(i-1), 2^i] microseconds
+        uint64_t us = stage_ns[stage] / 1000;
+        int bucket = us <= 1 ? 0 : 64 - __builtin_clzll(us - 1);
+        bucket = std::min(bucket, num_buckets - 1);
+
+        Histogram &histogram = stats.stages[stage];
+        histogram.buckets[bucket].store(histogram.buckets[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        histogram.count.store(histogram.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        histogram.sum_ns.store(histogram.sum_ns.load(std::memory_order_relaxed) + stage_ns[stage], std::memory_order_relaxed);
+    }
+}
+
+/// @brief sums a stage's buckets across every route slot of every shard
+std::vector<uint64_t> HttpMetrics::stage_buckets(Stage stage)
+{
+    std::vector<uint64_t> buckets(num_buckets, 0);
+    std::lock_guard<std::mutex> lock(shards_lock);
+    for (Shard *shard : shards)
+    {
+        for (size_t route = 0; route < shard->num_routes; route++)
+        {
+            Histogram &histogram = shard->routes[route].stages[stage];
+            for (int bucket = 0; bucket < num_buckets; bucket++)
+            {
+                buckets[bucket] += histogram.buckets[bucket].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    return buckets;
+}
+
+uint64_t HttpMetrics::quantile_us(const std::vector<uint64_t> &buckets, double quantile)
+{
+    uint64_t total = 0;
+    for (uint64_t count : buckets)
+    {
+        total += count;
+    }
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    // first bucket whose cumulative count reaches the quantile (+Inf bucket reports the largest finite bound)
+    uint64_t rank = static_cast<uint64_t>(quantile * total);
+    uint64_t cumulative = 0;
+    for (size_t bucket = 0; bucket < buckets.size(); bucket++)
+    {
+        cumulative += buckets[bucket];
+        if (cumulative >= rank && cumulative > 0)
+        {
+            return 1ULL << std::min(bucket, static_cast<size_t>(num_buckets - 2));
+        }
+    }
+    return 1ULL << (num_buckets - 2);
+}
+
+// *********************************************
+// EXPOSITION
+// *********************************************
+
+std::string HttpMetrics::escape_label(const std::string &value)
+{
+    std::string escaped;
+    for (char c : value)
+    {
+        if (c == '\\' || c == '"')
+        {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (c == '\n')
+        {
+            escaped += "\\n";
+        }
+        else
+        {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+/// @brief sums every thread's shard and writes the totals to the response in Prometheus text format
+void HttpMetrics::metrics_handler(const HttpRequest &, HttpResponse &res)
+{
+    size_t num_routes = metrics_route_slot() + 1;
+
+    // totals across shards (plain integers, since only this thread reads them)
+    std::vector<uint64_t> requests(num_routes, 0);
+    std::vector<uint64_t> buckets(num_routes * NUM_STAGES * num_buckets, 0);
+    std::vector<uint64_t> counts(num_routes * NUM_STAGES, 0);
+    std::vector<uint64_t> sums_ns(num_routes * NUM_STAGES, 0);
+    {
+        std::lock_guard<std::mutex> lock(shards_lock);
+        for (Shard *shard : shards)
+        {
+            for (size_t route = 0; route < std::min(num_routes, shard->num_routes); route++)
+            {
+                RouteStats &stats = shard->routes[route];
+                requests[route] += stats.requests.load(std::memory_order_relaxed);
+                for (int stage = 0; stage < NUM_STAGES; stage++)
+                {
+                    Histogram &histogram = stats.stages[stage];
+                    size_t stage_index = route * NUM_STAGES + stage;
+                    for (int bucket = 0; bucket < num_buckets; bucket++)
+                    {
+                        buckets[stage_index * num_buckets + bucket] += histogram.buckets[bucket].load(std::memory_order_relaxed);
+                    }
+                    counts[stage_index] += histogram.count.load(std::memory_order_relaxed);
+                    sums_ns[stage_index] += histogram.sum_ns.load(std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+
+    // labels of each route slot
+    std::vector<std::string> labels(num_routes);
+    for (size_t route = 0; route < HttpServer::routing_table.size(); route++)
+    {
+        RouteTableEntry &entry = HttpServer::routing_table.at(route);
+        labels[route] = "method=\"" + escape_label(entry.method) + "\",route=\"" + escape_label(entry.path) + "\"";
+    }
+    labels[static_route_slot()] = "method=\"GET\",route=\"static\"";
+    labels[unmatched_route_slot()] = "method=\"\",route=\"unmatched\"";
+    labels[metrics_route_slot()] = "method=\"GET\",route=\"" + metrics_path + "\"";
+
+    std::ostringstream body;
+    body << "# HELP http_requests_total Requests served by route.\n";
+    body << "# TYPE http_requests_total counter\n";
+    for (size_t route = 0; route < num_routes; route++)
+    {
+        if (requests[route] > 0)
+        {
+            body << "http_requests_total{" << labels[route] << "} " << requests[route] << "\n";
+        }
+    }
+
+    body << "# HELP http_request_stage_seconds Time spent in each stage of a request by route.\n";
+    body << "# TYPE http_request_stage_seconds histogram\n";
+    for (size_t route = 0; route < num_routes; route++)
+    {
+        if (requests[route] == 0)
+        {
+            continue;
+        }
+        for (int stage = 0; stage < NUM_STAGES; stage++)
+        {
+            size_t stage_index = route * NUM_STAGES + stage;
+            if (counts[stage_index] == 0)
+            {
+                continue;
+            }
+            std::string stage_labels = labels[route] + ",stage=\"" + stage_names[stage] + "\"";
+
+            // prometheus buckets are cumulative
+            uint64_t cumulative = 0;
+            for (int bucket = 0; bucket < num_buckets; bucket++)
+            {
+                cumulative += buckets[stage_index * num_buckets + bucket];
+                std::string le = "+Inf";
+                if (bucket < num_buckets - 1)
+                {
+                    char bound[32];
+                    snprintf(bound, sizeof(bound), "%g", static_cast<double>(1ULL << bucket) / 1e6);
+                    le = bound;
+                }
+                body << "http_request_stage_seconds_bucket{" << stage_labels << ",le=\"" << le << "\"} " << cumulative << "\n";
+            }
+            body << "http_request_stage_seconds_sum{" << stage_labels << "} " << static_cast<double>(sums_ns[stage_index]) / 1e9 << "\n";
+            body << "http_request_stage_seconds_count{" << stage_labels << "} " << counts[stage_index] << "\n";
+        }
+    }
+
+    res.set_code(200);
+    res.set_header("Content-Type", "text/plain; version=0.0.4");
+    res.append_body_str(body.str());
+}
@@ -6,6 +6,7 @@
 
 const std::string HttpServer::version = "HTTP/1.1";
 const std::unordered_set<std::string> HttpServer::supported_methods = {"GET", "HEAD", "POST"};
+const int HttpServer::heartbeat_interval_ms = 500;
 
 // *********************************************
 // STATIC FIELD INITIALIZATION
@@ -15,13 +16,31 @@ int HttpServer::port = -1;
 int HttpServer::admin_port = -1;
 std::string HttpServer::static_dir = "";
 std::vector<RouteTableEntry> HttpServer::routing_table;
+std::unordered_map<std::string, RouteTrie> HttpServer::route_tries;
 std::atomic<bool> HttpServer::is_dead(false);
+std::atomic<int> HttpServer::active_requests(0);
+std::atomic<int> HttpServer::open_connections(0);
+int HttpServer::backlog = 20;
+bool HttpServer::reactor_mode = false;
+int HttpServer::num_worker_threads = 8;
+int HttpServer::compression_level = 6;
+size_t HttpServer::compression_min_size = 1024;
+bool HttpServer::metrics_enabled = true;
+size_t HttpServer::max_body_size = 64 * 1024 * 1024;
 
 std::unordered_map<pthread_t, std::atomic<bool>> HttpServer::client_connections;
 std::mutex HttpServer::client_connections_lock;
 
 std::shared_timed_mutex HttpServer::kvs_mutex;
 std::unordered_map<std::string, std::vector<std::string>> HttpServer::client_kvs_addresses;
+std::unordered_map<std::string, uint64_t> HttpServer::client_kvs_versions;
+
+int HttpServer::epoll_fd = -1;
+std::unordered_map<int, std::shared_ptr<Client>> HttpServer::reactor_clients;
+std::mutex HttpServer::reactor_clients_lock;
+std::queue<int> HttpServer::ready_clients;
+std::mutex HttpServer::ready_clients_lock;
+std::condition_variable HttpServer::ready_clients_cv;
 
 // http server logger
 Logger http_logger("HTTP Server");
@@ -34,6 +53,7 @@ void *client_thread_adapter(void *obj)
 {
     Client *client = static_cast<Client *>(obj);
     client->read_from_network();
+    delete client;
     return nullptr;
 }
 
@@ -47,6 +67,10 @@ void HttpServer::run(int port, std::string static_dir)
     HttpServer::admin_port = port + 3000;
     HttpServer::static_dir = static_dir;
 
+    // a client closing its connection mid-response must fail the send (EPIPE) rather than kill the server
+    // writev and sendfile have no MSG_NOSIGNAL flag, so SIGPIPE is ignored for the whole process
+    signal(SIGPIPE, SIG_IGN);
+
     // given that a load balancer is also an http server, we neeed to make sure that the load balancer is not PINGing itself!
     // check that HTTP port is not LOAD BALANCER's client_listen_port
     // excludes load balancer and admin from receiving pings and opening connection with admin console
@@ -101,8 +125,7 @@ int HttpServer::bind_socket(int port)
     }
 
     // listen for connections on port
-    const int BACKLOG = 20;
-    if ((listen(sock_fd, BACKLOG)) < 0)
+    if ((listen(sock_fd, HttpServer::backlog)) < 0)
     {
         http_logger.log("Unable to listen for connections on bound socket.", 40);
         return -1;
@@ -123,6 +146,18 @@ void HttpServer::accept_and_handle_clients()
     }
 
     http_logger.log("HTTP server accepting clients on port " + std::to_string(port), 20);
+
+    // reactor mode - connections are multiplexed onto a fixed pool of workers
+    if (reactor_mode)
+    {
+#ifdef __linux__
+        run_event_loop(client_comm_sock_fd);
+        return;
+#else
+        http_logger.log("Reactor mode requires epoll - falling back to a thread per connection", 30);
+#endif
+    }
+
     while (true)
     {
         // accept client connections as long as the server is alive
@@ -166,12 +201,12 @@ void HttpServer::accept_and_handle_clients()
             // extract port from client connection and initialize Client object
             int client_port = ntohs(client_addr.sin_port);
 
-            // initialize Client object
-            Client client(client_fd);
+            // initialize Client object (allocated per connection, since the loop moves on to the next connection before the thread is done with it)
+            Client *client = new Client(client_fd);
 
-            http_logger.log("Accepted connection from client on port " + std::to_string(client_port), 20);
+            LOGGER_LOG(http_logger, 20, "Accepted connection from client on port " + std::to_string(client_port));
             pthread_t client_thread;
-            pthread_create(&client_thread, nullptr, client_thread_adapter, &client);
+            pthread_create(&client_thread, nullptr, client_thread_adapter, client);
 
             // add thread to map of client connections
             client_connections_lock.lock();
@@ -181,6 +216,161 @@ void HttpServer::accept_and_handle_clients()
     }
 }
 
+#ifdef __linux__
+// **************************************************
+// REACTOR MODE
+// **************************************************
+
+/// @brief event loop for reactor mode. Connections are watched with EPOLLONESHOT, so each readiness event is handed to exactly one worker, and the connection is re-armed by that worker once it has drained the socket.
+void HttpServer::run_event_loop(int client_comm_sock_fd)
+{
+    epoll_fd = epoll_create1(0);
+    if (epoll_fd < 0)
+    {
+        http_logger.log("Unable to create epoll instance. Exiting.", 40);
+        return;
+    }
+
+    // listening socket is non-blocking so that every pending connection can be accepted per event
+    fcntl(client_comm_sock_fd, F_SETFL, fcntl(client_comm_sock_fd, F_GETFL, 0) | O_NONBLOCK);
+    epoll_event listen_event;
+    listen_event.events = EPOLLIN;
+    listen_event.data.fd = client_comm_sock_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_comm_sock_fd, &listen_event) < 0)
+    {
+        http_logger.log("Unable to watch client port with epoll. Exiting.", 40);
+        return;
+    }
+
+    // dispatch worker pool
+    for (int i = 0; i < num_worker_threads; i++)
+    {
+        std::thread worker(handle_ready_clients);
+        worker.detach();
+    }
+    http_logger.log("Reactor mode serving clients with " + std::to_string(num_worker_threads) + " workers", 20);
+
+    const int max_events = 256;
+    epoll_event events[max_events];
+    while (true)
+    {
+        int num_events = epoll_wait(epoll_fd, events, max_events, -1);
+        if (num_events < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            http_logger.log("Error waiting for epoll events. Exiting.", 40);
+            return;
+        }
+
+        for (int i = 0; i < num_events; i++)
+        {
+            if (events[i].data.fd == client_comm_sock_fd)
+            {
+                accept_reactor_clients(client_comm_sock_fd);
+                continue;
+            }
+
+            // queue readable connection for a worker
+            std::unique_lock<std::mutex> lock(ready_clients_lock);
+            ready_clients.push(events[i].data.fd);
+            lock.unlock();
+            ready_clients_cv.notify_one();
+        }
+    }
+}
+
+void HttpServer::accept_reactor_clients(int client_comm_sock_fd)
+{
+    while (true)
+    {
+        int client_fd;
+        struct sockaddr_in client_addr;
+        socklen_t client_addr_size = sizeof(client_addr);
+        if ((client_fd = accept(client_comm_sock_fd, (sockaddr *)&client_addr, &client_addr_size)) < 0)
+        {
+            // error with incoming connection should NOT break the server loop
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                http_logger.log("Unable to accept incoming connection from client. Skipping", 30);
+            }
+            return;
+        }
+
+        if (is_dead)
+        {
+            close(client_fd);
+            continue;
+        }
+
+        // accepted fd stays blocking so responses are sent in full - reads are non-blocking per call (MSG_DONTWAIT)
+        reactor_clients_lock.lock();
+        reactor_clients[client_fd] = std::make_shared<Client>(client_fd);
+        reactor_clients_lock.unlock();
+        open_connections++;
+
+        epoll_event client_event;
+        client_event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        client_event.data.fd = client_fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &client_event) < 0)
+        {
+            http_logger.log("Unable to watch client connection with epoll. Closing connection.", 40);
+            reactor_clients_lock.lock();
+            reactor_clients.erase(client_fd);
+            reactor_clients_lock.unlock();
+            open_connections--;
+            close(client_fd);
+            continue;
+        }
+        LOGGER_LOG(http_logger, 20, "Accepted connection from client on port " + std::to_string(ntohs(client_addr.sin_port)));
+    }
+}
+
+void HttpServer::handle_ready_clients()
+{
+    while (true)
+    {
+        // wait for a connection to be ready
+        std::unique_lock<std::mutex> lock(ready_clients_lock);
+        ready_clients_cv.wait(lock, []
+                              { return !ready_clients.empty(); });
+        int client_fd = ready_clients.front();
+        ready_clients.pop();
+        lock.unlock();
+
+        reactor_clients_lock.lock();
+        auto it = reactor_clients.find(client_fd);
+        std::shared_ptr<Client> client = it == reactor_clients.end() ? nullptr : it->second;
+        reactor_clients_lock.unlock();
+        if (client == nullptr)
+        {
+            continue;
+        }
+
+        // read and respond to every request available on the connection
+        if (!client->read_available() || is_dead)
+        {
+            // connection is removed from epoll and the map before the fd is closed, so a new connection reusing the fd is unaffected
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client_fd, nullptr);
+            reactor_clients_lock.lock();
+            reactor_clients.erase(client_fd);
+            reactor_clients_lock.unlock();
+            open_connections--;
+            close(client_fd);
+            continue;
+        }
+
+        // re-arm connection for its next readiness event
+        epoll_event client_event;
+        client_event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        client_event.data.fd = client_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client_fd, &client_event);
+    }
+}
+#endif
+
 // **************************************************
 // ROUTE REGISTRATION
 // **************************************************
@@ -190,8 +380,8 @@ void HttpServer::get(const std::string &path, const std::function<void(const Htt
     // every GET request is also a valid HEAD request
     RouteTableEntry get_entry("GET", path, route);
     RouteTableEntry head_entry("HEAD", path, route);
-    HttpServer::routing_table.push_back(get_entry);
-    HttpServer::routing_table.push_back(head_entry);
+    register_route(get_entry);
+    register_route(head_entry);
     http_logger.log("Registered GET route at " + path, 20);
     http_logger.log("Registered HEAD route at " + path, 20);
 }
@@ -199,10 +389,24 @@ void HttpServer::get(const std::string &path, const std::function<void(const Htt
 void HttpServer::post(const std::string &path, const std::function<void(const HttpRequest &, HttpResponse &)> &route)
 {
     RouteTableEntry entry("POST", path, route);
-    HttpServer::routing_table.push_back(entry);
+    register_route(entry);
     http_logger.log("Registered POST route at " + path, 20);
 }
 
+void HttpServer::post_stream(const std::string &path, const std::function<std::shared_ptr<BodyHandler>(const HttpRequest &)> &streaming_route)
+{
+    RouteTableEntry entry("POST", path, streaming_route);
+    register_route(entry);
+    http_logger.log("Registered streaming POST route at " + path, 20);
+}
+
+/// @brief adds route to routing table and compiles its path into the trie for its method
+void HttpServer::register_route(const RouteTableEntry &entry)
+{
+    HttpServer::routing_table.push_back(entry);
+    HttpServer::route_tries[entry.method].insert(entry.path, HttpServer::routing_table.size() - 1);
+}
+
 // **************************************************
 // ADMIN COMMUNICATION
 // **************************************************
@@ -328,11 +532,12 @@ void HttpServer::admin_live()
 
 /// @brief check if the username and associated KVS server address is cached
 /// @param username username associated with current session
-/// @return returns true if the user is stored, false otherwise
-bool HttpServer::check_kvs_addr(std::string username)
+/// @param min_version oldest coordinator routing version a cached address may have been looked up at
+/// @return returns true if the user is stored at min_version or later, false otherwise
+bool HttpServer::check_kvs_addr(std::string username, uint64_t min_version)
 {
     HttpServer::kvs_mutex.lock_shared();
-    bool present = HttpServer::client_kvs_addresses.count(username);
+    bool present = HttpServer::client_kvs_addresses.count(username) && HttpServer::client_kvs_versions.at(username) >= min_version;
     HttpServer::kvs_mutex.unlock_shared();
 
     return present;
@@ -345,6 +550,7 @@ bool HttpServer::delete_kvs_addr(std::string username)
 {
     HttpServer::kvs_mutex.lock();
     HttpServer::client_kvs_addresses.erase(username);
+    HttpServer::client_kvs_versions.erase(username);
     HttpServer::kvs_mutex.unlock();
 
     return true;
@@ -367,11 +573,13 @@ std::vector<std::string> HttpServer::get_kvs_addr(std::string username)
 /// @brief set the KVS address of the user
 /// @param username username associated with current session
 /// @param kvs_address address of the user's associated KVS server
+/// @param version coordinator routing version the address was looked up at
 /// @return return true after operation is completed successfully
-bool HttpServer::set_kvs_addr(std::string username, std::string kvs_address)
+bool HttpServer::set_kvs_addr(std::string username, std::string kvs_address, uint64_t version)
 {
     HttpServer::kvs_mutex.lock();
     HttpServer::client_kvs_addresses[username] = Utils::split(kvs_address, ":");
+    HttpServer::client_kvs_versions[username] = version;
     HttpServer::kvs_mutex.unlock();
 
     return true;
@@ -381,47 +589,65 @@ bool HttpServer::set_kvs_addr(std::string username, std::string kvs_address)
 // LOAD BALANCER COMMUNICATION
 // **************************************************
 
-// send heartbeat to LOAD BALANCER
-void HttpServer::send_heartbeat(int lb_port, int server_port)
+/// @brief sends one heartbeat to the load balancer over the heartbeat socket (connected UDP socket)
+void HttpServer::send_heartbeat(int heartbeat_sock_fd, int server_port, std::vector<uint64_t> &prev_latency_buckets)
 {
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0)
+    // p99 of handler latency over the last interval (difference between cumulative buckets now and at the last heartbeat)
+    std::vector<uint64_t> latency_buckets = HttpMetrics::stage_buckets(HttpMetrics::HANDLER);
+    std::vector<uint64_t> interval_buckets(latency_buckets.size(), 0);
+    for (size_t i = 0; i < latency_buckets.size() && i < prev_latency_buckets.size(); i++)
+    {
+        interval_buckets[i] = latency_buckets[i] - prev_latency_buckets[i];
+    }
+    prev_latency_buckets.swap(latency_buckets);
+    uint64_t p99_us = HttpMetrics::quantile_us(interval_buckets, 0.99);
+
+    // Expected message format: "PING<SP>PORT<SP>LOAD<SP>CONNECTIONS<SP>QUEUE_DEPTH<SP>P99_US\r\n"
+    // load is the number of requests in flight, queue depth is the number of connections waiting for a worker, p99 is in microseconds
+    std::string message = "PING " + std::to_string(server_port) + " " + std::to_string(active_requests.load()) + " " +
+                          std::to_string(open_connections.load()) + " " + std::to_string(queued_connections()) + " " + std::to_string(p99_us) + "\r\n";
+
+    // a lost datagram is covered by the next heartbeat, and send fails (ECONNREFUSED) while the load balancer isn't running - neither is an error worth logging each tick
+    send(heartbeat_sock_fd, message.c_str(), message.length(), 0);
+}
+
+int HttpServer::queued_connections()
+{
+    std::lock_guard<std::mutex> lock(ready_clients_lock);
+    return ready_clients.size();
+}
+
+void HttpServer::start_heartbeat_thread(int lb_port, int server_port)
+{
+    // heartbeats are datagrams on one socket, rather than a new TCP connection per heartbeat that the load balancer must accept and close
+    int heartbeat_sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (heartbeat_sock_fd < 0)
     {
         http_logger.log("Could not create socket for heartbeat", 40);
         return;
     }
 
+    // connecting a UDP socket only fixes its destination, so it succeeds even if the load balancer isn't running yet
     struct sockaddr_in lb_addr;
     memset(&lb_addr, 0, sizeof(lb_addr));
     lb_addr.sin_family = AF_INET;
     lb_addr.sin_port = htons(lb_port);
     lb_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
-
-    if (connect(sock, (struct sockaddr *)&lb_addr, sizeof(lb_addr)) < 0)
+    if (connect(heartbeat_sock_fd, (struct sockaddr *)&lb_addr, sizeof(lb_addr)) < 0)
     {
-        http_logger.log("Failed to connect to load balancer for heartbeat", 40);
-        close(sock);
+        http_logger.log("Failed to set load balancer as heartbeat destination", 40);
+        close(heartbeat_sock_fd);
         return;
     }
 
-    // http_logger.log("PING sent from FE server (PORT " + std::to_string(port) + ") to Load Balancer", 20);
-    // Expected message format: "PING<SP>PORT\r\n"
-    std::string message = "PING " + std::to_string(server_port) + "\r\n";
-    send(sock, message.c_str(), message.length(), 0);
-    close(sock);
-}
-
-void HttpServer::start_heartbeat_thread(int lb_port, int server_port)
-{
-    {
-        std::thread([=]()
-                    {
+    std::thread([=]()
+                {
+        std::vector<uint64_t> prev_latency_buckets;
         while (true) {
             if (!is_dead) {
-                send_heartbeat(lb_port, server_port);
-                std::this_thread::sleep_for(std::chrono::seconds(1));  // send a heartbeat every second
+                send_heartbeat(heartbeat_sock_fd, server_port, prev_latency_buckets);
             }
+            std::this_thread::sleep_for(std::chrono::milliseconds(heartbeat_interval_ms));
         } })
-            .detach();
-    }
+        .detach();
 }
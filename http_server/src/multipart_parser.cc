@@ -0,0 +1,235 @@
+#include "../include/multipart_parser.h"
+
+// *********************************************
+// CONSTANTS
+// *********************************************
+
+const size_t MultipartParser::max_part_headers_len = 8192;
+
+// *********************************************
+// CONSTRUCTOR
+// *********************************************
+
+MultipartParser::MultipartParser(const std::string &boundary)
+    : delimiter("\r\n--" + boundary), state(State::PREAMBLE)
+{
+    // bytes not in the delimiter shift the search window by the full delimiter length
+    for (size_t &shift : skip_table)
+    {
+        shift = delimiter.length();
+    }
+    // last byte of the delimiter is excluded so a shift is never 0
+    for (size_t i = 0; i + 1 < delimiter.length(); i++)
+    {
+        skip_table[static_cast<unsigned char>(delimiter[i])] = delimiter.length() - 1 - i;
+    }
+
+    // first boundary of a body is not preceded by a CRLF - prime stream with one so every boundary matches delimiter
+    pending.push_back('\r');
+    pending.push_back('\n');
+}
+
+// *********************************************
+// PARSING
+// *********************************************
+
+/// @brief extracts boundary parameter from a multipart Content-Type header value
+std::string MultipartParser::boundary_from_content_type(const std::string &content_type)
+{
+    size_t param_start = Utils::to_lowercase(content_type).find("boundary=");
+    if (param_start == std::string::npos)
+    {
+        return "";
+    }
+    param_start += 9;
+    size_t param_end = content_type.find(';', param_start);
+    std::string boundary = Utils::trim(content_type.substr(param_start, param_end == std::string::npos ? std::string::npos : param_end - param_start));
+
+    // boundary may be quoted
+    if (boundary.length() >= 2 && boundary.front() == '"' && boundary.back() == '"')
+    {
+        boundary = boundary.substr(1, boundary.length() - 2);
+    }
+    return boundary;
+}
+
+/// @brief parses next chunk of body, reporting parts through callbacks as soon as their bytes are known
+void MultipartParser::feed(const char *data, size_t len)
+{
+    if (state == State::EPILOGUE || state == State::ERROR)
+    {
+        return;
+    }
+    pending.insert(pending.end(), data, data + len);
+
+    size_t consumed = 0;
+    bool need_more = false;
+    while (!need_more && state != State::EPILOGUE && state != State::ERROR)
+    {
+        switch (state)
+        {
+        case State::PREAMBLE:
+        case State::DATA:
+        {
+            size_t delimiter_pos = find_delimiter(consumed);
+            if (delimiter_pos != pending.size())
+            {
+                if (state == State::DATA)
+                {
+                    if (delimiter_pos > consumed && on_part_data)
+                    {
+                        on_part_data(pending.data() + consumed, delimiter_pos - consumed);
+                    }
+                    if (on_part_end)
+                    {
+                        on_part_end();
+                    }
+                }
+                consumed = delimiter_pos + delimiter.length();
+                state = State::PART_START;
+                break;
+            }
+
+            // no delimiter - every byte except a possible partial delimiter at the end can be released
+            size_t safe_end = pending.size() >= delimiter.length() ? pending.size() - delimiter.length() + 1 : 0;
+            if (safe_end > consumed)
+            {
+                if (state == State::DATA && on_part_data)
+                {
+                    on_part_data(pending.data() + consumed, safe_end - consumed);
+                }
+                consumed = safe_end;
+            }
+            need_more = true;
+            break;
+        }
+        case State::PART_START:
+        {
+            // skip transport padding after boundary
+            while (consumed < pending.size() && (pending[consumed] == ' ' || pending[consumed] == '\t'))
+            {
+                consumed++;
+            }
+            if (pending.size() - consumed < 2)
+            {
+                need_more = true;
+            }
+            else if (pending[consumed] == '-' && pending[consumed + 1] == '-')
+            {
+                // close delimiter - anything after it is epilogue
+                consumed = pending.size();
+                state = State::EPILOGUE;
+            }
+            else if (pending[consumed] == '\r' && pending[consumed + 1] == '\n')
+            {
+                consumed += 2;
+                state = State::HEADERS;
+            }
+            else
+            {
+                state = State::ERROR;
+            }
+            break;
+        }
+        case State::HEADERS:
+        {
+            // part without headers
+            if (pending.size() - consumed >= 2 && pending[consumed] == '\r' && pending[consumed + 1] == '\n')
+            {
+                std::unordered_map<std::string, std::string> part_headers;
+                if (on_part_begin)
+                {
+                    on_part_begin(part_headers);
+                }
+                consumed += 2;
+                state = State::DATA;
+                break;
+            }
+
+            static const char headers_end[] = "\r\n\r\n";
+            auto end_it = std::search(pending.begin() + consumed, pending.end(), headers_end, headers_end + 4);
+            if (end_it == pending.end())
+            {
+                if (pending.size() - consumed > max_part_headers_len)
+                {
+                    state = State::ERROR;
+                }
+                need_more = true;
+                break;
+            }
+
+            // pending before consumed is no longer needed - drop it so headers start at the front
+            size_t headers_len = end_it - pending.begin() - consumed;
+            pending.erase(pending.begin(), pending.begin() + consumed);
+            consumed = 0;
+            if (!parse_part_headers(headers_len + 2))
+            {
+                state = State::ERROR;
+                break;
+            }
+            consumed = headers_len + 4;
+            state = State::DATA;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // keep only bytes that could not be consumed
+    pending.erase(pending.begin(), pending.begin() + std::min(consumed, pending.size()));
+}
+
+bool MultipartParser::is_complete() const
+{
+    return state == State::EPILOGUE;
+}
+
+bool MultipartParser::has_error() const
+{
+    return state == State::ERROR;
+}
+
+/// @brief Boyer-Moore-Horspool search for delimiter in pending, starting at start
+size_t MultipartParser::find_delimiter(size_t start) const
+{
+    size_t delimiter_len = delimiter.length();
+    size_t pos = start;
+    while (pos + delimiter_len <= pending.size())
+    {
+        // compare window right to left
+        size_t i = delimiter_len - 1;
+        while (pending[pos + i] == delimiter[i])
+        {
+            if (i == 0)
+            {
+                return pos;
+            }
+            i--;
+        }
+        pos += skip_table[static_cast<unsigned char>(pending[pos + delimiter_len - 1])];
+    }
+    return pending.size();
+}
+
+/// @brief parses header lines at the front of pending (headers_end includes the last line's CRLF) and reports them
+bool MultipartParser::parse_part_headers(size_t headers_end)
+{
+    std::unordered_map<std::string, std::string> part_headers;
+    std::string headers_block(pending.begin(), pending.begin() + headers_end);
+    for (std::string &line : Utils::split(headers_block, "\r\n"))
+    {
+        size_t colon = line.find(':');
+        if (colon == std::string::npos || colon == 0)
+        {
+            return false;
+        }
+        part_headers[Utils::to_lowercase(line.substr(0, colon))] = Utils::trim(line.substr(colon + 1));
+    }
+
+    if (on_part_begin)
+    {
+        on_part_begin(part_headers);
+    }
+    return true;
+}
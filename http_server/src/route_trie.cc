@@ -0,0 +1,150 @@
+#include "../include/route_trie.h"
+#include "../../utils/include/utils.h"
+
+#include <algorithm>
+
+// *********************************************
+// ROUTE REGISTRATION
+// *********************************************
+
+/// @brief compiles route path into trie. If an identical path was registered earlier, the earlier route is kept.
+void RouteTrie::insert(const std::string &path, int route_index)
+{
+    // special wildcard route - this matches any path
+    if (path == "*")
+    {
+        if (match_all_route_index == -1)
+        {
+            match_all_route_index = route_index;
+        }
+        return;
+    }
+
+    Node *node = &root;
+    std::vector<std::string> route_params;
+    for (std::string &token : Utils::split(path, "/"))
+    {
+        // * catches everything after it, so any tokens after it are ignored
+        if (token == "*")
+        {
+            if (node->wildcard_route_index == -1)
+            {
+                node->wildcard_route_index = route_index;
+                node->wildcard_route_params = route_params;
+            }
+            return;
+        }
+        // token starting with ":" matches any segment
+        else if (token.front() == ':')
+        {
+            if (node->param_child == nullptr)
+            {
+                node->param_child.reset(new Node());
+            }
+            route_params.push_back(token.substr(1));
+            node = node->param_child.get();
+        }
+        // literal token - children are kept sorted so they can be binary searched
+        else
+        {
+            auto it = std::lower_bound(node->literal_children.begin(), node->literal_children.end(), token,
+                                       [](const std::pair<std::string, std::unique_ptr<Node>> &child, const std::string &segment)
+                                       { return child.first < segment; });
+            if (it == node->literal_children.end() || it->first != token)
+            {
+                it = node->literal_children.insert(it, std::make_pair(token, std::unique_ptr<Node>(new Node())));
+            }
+            node = it->second.get();
+        }
+    }
+
+    if (node->route_index == -1)
+    {
+        node->route_index = route_index;
+        node->route_params = route_params;
+    }
+}
+
+// *********************************************
+// ROUTE MATCHING
+// *********************************************
+
+int RouteTrie::match(const std::string &path, std::unordered_map<std::string, std::string> &params) const
+{
+    Match best;
+    best.route_index = match_all_route_index;
+    best.route_params = nullptr;
+
+    std::vector<std::pair<size_t, size_t>> captures;
+    match_node(&root, path, 0, captures, best);
+
+    // store values of matched route's params
+    if (best.route_params != nullptr)
+    {
+        for (size_t i = 0; i < best.route_params->size() && i < best.captures.size(); i++)
+        {
+            params[best.route_params->at(i)] = path.substr(best.captures[i].first, best.captures[i].second);
+        }
+    }
+    return best.route_index;
+}
+
+/// @brief walks the trie from node for the path starting at pos. Every branch is explored so the earliest registered match wins.
+void RouteTrie::match_node(const Node *node, const std::string &path, size_t pos, std::vector<std::pair<size_t, size_t>> &captures, Match &best) const
+{
+    // skip "/" separators (consecutive separators produce no segments)
+    while (pos < path.length() && path[pos] == '/')
+    {
+        pos++;
+    }
+
+    // end of path - match route ending at this node
+    if (pos == path.length())
+    {
+        if (node->route_index != -1 && (best.route_index == -1 || node->route_index < best.route_index))
+        {
+            best.route_index = node->route_index;
+            best.route_params = &node->route_params;
+            best.captures = captures;
+        }
+        return;
+    }
+
+    size_t segment_end = path.find('/', pos);
+    if (segment_end == std::string::npos)
+    {
+        segment_end = path.length();
+    }
+    size_t segment_len = segment_end - pos;
+
+    // wildcard route catches this segment and everything after it
+    if (node->wildcard_route_index != -1 && (best.route_index == -1 || node->wildcard_route_index < best.route_index))
+    {
+        best.route_index = node->wildcard_route_index;
+        best.route_params = &node->wildcard_route_params;
+        best.captures = captures;
+    }
+
+    // literal child
+    const char *segment = path.data() + pos;
+    auto it = std::lower_bound(node->literal_children.begin(), node->literal_children.end(), segment,
+                               [segment_len](const std::pair<std::string, std::unique_ptr<Node>> &child, const char *segment)
+                               { return segment_less(child.first, segment, segment_len); });
+    if (it != node->literal_children.end() && it->first.compare(0, std::string::npos, segment, segment_len) == 0)
+    {
+        match_node(it->second.get(), path, segment_end, captures, best);
+    }
+
+    // param child
+    if (node->param_child != nullptr)
+    {
+        captures.push_back(std::make_pair(pos, segment_len));
+        match_node(node->param_child.get(), path, segment_end, captures, best);
+        captures.pop_back();
+    }
+}
+
+bool RouteTrie::segment_less(const std::string &segment, const char *data, size_t len)
+{
+    return segment.compare(0, std::string::npos, data, len) < 0;
+}
@@ -0,0 +1,167 @@
+#include "../include/static_file_cache.h"
+
+// *********************************************
+// CONSTANTS
+// *********************************************
+
+const size_t StaticFileCache::max_cached_file_size = 1024 * 1024; // 1 MB
+const size_t StaticFileCache::max_cache_size = 64 * 1024 * 1024;  // 64 MB
+
+// *********************************************
+// STATIC FIELD INITIALIZATION
+// *********************************************
+
+bool StaticFileCache::validate_mtime = true;
+std::unordered_map<std::string, std::shared_ptr<const StaticFile>> StaticFileCache::entries;
+size_t StaticFileCache::cache_size = 0;
+std::shared_timed_mutex StaticFileCache::cache_lock;
+
+// *********************************************
+// LOOKUP
+// *********************************************
+
+std::shared_ptr<const StaticFile> StaticFileCache::lookup(const std::string &path)
+{
+    std::shared_ptr<const StaticFile> cached;
+    {
+        std::shared_lock<std::shared_timed_mutex> lock(cache_lock);
+        auto it = entries.find(path);
+        if (it != entries.end())
+        {
+            cached = it->second;
+        }
+    }
+
+    // files are trusted until restart if they aren't validated
+    if (cached != nullptr && !validate_mtime)
+    {
+        return cached;
+    }
+
+    // verify that the file exists and is a regular file (directories can't be served)
+    struct stat file_stat;
+    if (stat(path.c_str(), &file_stat) < 0 || !S_ISREG(file_stat.st_mode))
+    {
+        if (cached != nullptr)
+        {
+            std::unique_lock<std::shared_timed_mutex> lock(cache_lock);
+            auto it = entries.find(path);
+            if (it != entries.end() && it->second == cached)
+            {
+                cache_size -= cached->data != nullptr ? cached->data->size() : 0;
+                cache_size -= cached->gzipped != nullptr ? cached->gzipped->size() : 0;
+                entries.erase(it);
+            }
+        }
+        return nullptr;
+    }
+
+    // cached file is current
+    if (cached != nullptr && cached->size == static_cast<size_t>(file_stat.st_size) && cached->mtime_ns == mtime_ns_of(file_stat))
+    {
+        return cached;
+    }
+
+    // (re)load file - large files only have their metadata cached, since their contents are streamed from disk
+    std::shared_ptr<StaticFile> file = load(path, file_stat, static_cast<size_t>(file_stat.st_size) <= max_cached_file_size);
+    if (file == nullptr)
+    {
+        return nullptr;
+    }
+    size_t file_cache_size = (file->data != nullptr ? file->data->size() : 0) + (file->gzipped != nullptr ? file->gzipped->size() : 0);
+
+    std::unique_lock<std::shared_timed_mutex> lock(cache_lock);
+    auto it = entries.find(path);
+    if (it != entries.end())
+    {
+        cache_size -= it->second->data != nullptr ? it->second->data->size() : 0;
+        cache_size -= it->second->gzipped != nullptr ? it->second->gzipped->size() : 0;
+        entries.erase(it);
+    }
+    // cache is full - file is still served, it just isn't kept
+    if (cache_size + file_cache_size > max_cache_size)
+    {
+        return file;
+    }
+    entries[path] = file;
+    cache_size += file_cache_size;
+    return file;
+}
+
+// *********************************************
+// LOADING
+// *********************************************
+
+std::shared_ptr<StaticFile> StaticFileCache::load(const std::string &path, const struct stat &file_stat, bool cache_contents)
+{
+    std::shared_ptr<StaticFile> file = std::make_shared<StaticFile>();
+    file->path = path;
+    file->size = file_stat.st_size;
+    file->mtime_ns = mtime_ns_of(file_stat);
+    file->content_type = content_type_for(path);
+
+    // etag changes whenever the file's size or modification time changes
+    std::ostringstream etag;
+    etag << "\"" << std::hex << file->size << "-" << file->mtime_ns << "\"";
+    file->etag = etag.str();
+
+    if (!cache_contents)
+    {
+        return file;
+    }
+
+    // open file in binary form and read its bytes
+    std::ifstream resource(path, std::ios::binary);
+    if (!resource.is_open())
+    {
+        return nullptr;
+    }
+    file->data = std::make_shared<std::vector<char>>(file->size);
+    resource.read(file->data->data(), file->size);
+    file->data->resize(resource.gcount());
+    file->size = file->data->size();
+    resource.close();
+
+    // precompress text files once so every request for them can be served compressed
+    if (HttpCompression::is_compressible_type(file->content_type))
+    {
+        std::shared_ptr<std::vector<char>> gzipped = std::make_shared<std::vector<char>>();
+        if (HttpCompression::gzip(file->data->data(), file->data->size(), Z_BEST_COMPRESSION, *gzipped) && gzipped->size() < file->data->size())
+        {
+            file->gzipped = gzipped;
+        }
+    }
+    return file;
+}
+
+std::string StaticFileCache::content_type_for(const std::string &path)
+{
+    std::string content_type = "application/octet-stream"; // default content type
+    size_t pos = path.find_last_of('.');
+    if (pos != std::string::npos)
+    {
+        std::string extension = path.substr(pos + 1);
+        if (extension == "txt")
+        {
+            content_type = "text/plain";
+        }
+        else if (extension == "jpeg" || extension == "jpg")
+        {
+            content_type = "image/jpeg";
+        }
+        else if (extension == "html")
+        {
+            content_type = "text/html";
+        }
+    }
+    return content_type;
+}
+
+int64_t StaticFileCache::mtime_ns_of(const struct stat &file_stat)
+{
+#ifdef __APPLE__
+    return static_cast<int64_t>(file_stat.st_mtimespec.tv_sec) * 1000000000 + file_stat.st_mtimespec.tv_nsec;
+#else
+    return static_cast<int64_t>(file_stat.st_mtim.tv_sec) * 1000000000 + file_stat.st_mtim.tv_nsec;
+#endif
+}
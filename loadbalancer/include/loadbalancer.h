@@ -7,6 +7,7 @@
 #include <thread>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h> // TCP_NODELAY
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <cstring>
@@ -15,6 +16,14 @@
 #include <list>
 #include <random>
 #include <map>
+#include <atomic>
+#include <sstream>
+#include <condition_variable>
+#include <algorithm> // std::find
+#include <memory>
+#include <functional> // std::hash
+#include <cerrno>     // errno
+#include <sys/time.h> // timeval (upstream socket timeouts)
 #include "../../http_server/include/http_request.h"
 #include "../../http_server/include/http_response.h"
 #include "../../http_server/include/http_server.h"
@@ -26,7 +35,21 @@ namespace LoadBalancer
     {
         std::chrono::steady_clock::time_point lastHeartbeat; // value for last received heartbeat of server
         bool isActive;                                       // boolean if server is up/down
+        int load;                                            // requests in flight on server, reported in its last heartbeat
+        int connections;                                     // client connections open on server, reported in its last heartbeat
+        int queueDepth;                                      // connections waiting for a worker on server (reactor mode), reported in its last heartbeat
+        long long p99Micros;                                 // p99 handler latency over server's last heartbeat interval, reported in its last heartbeat
     };
+
+    // policy used to pick a server for a client (or for a request in proxy mode)
+    enum class Policy
+    {
+        RANDOM,               // uniformly random server
+        LEAST_OUTSTANDING,    // server with fewest requests proxied to it by the LB that haven't completed (proxy mode only)
+        WEIGHTED_ROUND_ROBIN, // round robin where each server gets a share of clients proportional to its weight
+        POWER_OF_TWO_CHOICES  // less loaded of two random servers (heartbeat load + outstanding requests)
+    };
+
     // Variables
     extern std::map<int, ServerData> servers;       // iterator for round-robin server selection, key is server port number
     extern std::vector<int> activeServers;          // vector of active server port numbers
@@ -35,15 +58,83 @@ namespace LoadBalancer
     extern int client_listen_port;                  // the port number on which the LB listens to client connections
     extern int server_listen_port;                  // the port number on which the LB listens to front end server connections
 
+    // health checking
+    extern const int heartbeat_timeout_ms;    // server is marked down if no heartbeat arrives within this time
+    extern std::mutex health_mutex;           // mutex for server revived flag
+    extern std::condition_variable health_cv; // wakes health check when a server comes back up
+    extern bool server_revived;               // set when a server that was down sends a heartbeat
+
+    // reverse proxy mode
+    extern bool proxy_mode;                                   // forward requests to front end servers instead of redirecting clients to them
+    extern const int max_proxy_attempts;                      // servers a proxied request is tried on before it fails
+    extern const size_t max_idle_upstream_connections;        // idle keep-alive connections pooled per front end server
+    extern const int upstream_timeout_s;                      // time a front end server has to accept, answer or stream a request
+    extern std::map<int, std::vector<int>> idle_upstream_fds; // idle keep-alive connections to each front end server, key is server port number
+    extern std::mutex upstream_pool_mutex;                    // mutex for idle upstream connections
+
+    // balancing policy
+    extern Policy balancingPolicy;                              // policy used to select servers - provided at startup
+    extern std::map<int, int> serverWeights;                    // weight of each server (weighted round robin), key is server port number
+    extern std::map<int, int> currentWeights;                   // running weight of each server (smooth weighted round robin), key is server port number
+    extern std::mutex weights_mutex;                            // mutex for running weights
+    extern std::map<int, std::atomic<int>> outstandingRequests; // requests proxied to each server that haven't completed, key is server port number
+
+    // keep-alive connection to a front end server that a proxied request is forwarded over
+    struct UpstreamConnection
+    {
+        int port;                                                 // front end server's port
+        int fd;                                                   // connection fd (-1 once the connection is closed or returned to the pool)
+        std::string buffer;                                       // bytes received from the front end that haven't been consumed yet
+        int code;                                                 // response code of the front end's response
+        std::vector<std::pair<std::string, std::string>> headers; // response headers (in the order they were received)
+        long long content_length;                                 // length of response body (-1 if the body isn't delimited by Content-Length)
+        bool chunked;                                             // response body is sent with chunked transfer encoding
+        bool keep_alive;                                          // front end keeps connection open after the response
+
+        // each connection in use carries one request, so it's counted as an outstanding request on its server while it exists
+        UpstreamConnection(int port, int fd) : port(port), fd(fd), code(0), content_length(-1), chunked(false), keep_alive(true)
+        {
+            outstandingRequests.at(port)++;
+        }
+        // closes the connection if it wasn't returned to the pool
+        ~UpstreamConnection()
+        {
+            outstandingRequests.at(port)--;
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+        }
+    };
+
     // Functions
     int create_socket(int port);                               // Set up TCP socket bound to specified port
+    int create_udp_socket(int port);                           // Set up UDP socket bound to specified port
     void initialize_servers(int numServers, int startingPort); // initialize # of servers
-    std::string select_server();                               // Select an active server using round-robin scheduling
+    std::string select_server();                               // Select an active server using the balancing policy
+    int pick_server(const std::vector<int> &candidates);       // select one of candidates using the balancing policy
+    int server_load(int port);                                 // heartbeat load + outstanding requests of a server
+    std::mt19937 &thread_rng();                                // random number generator of calling thread (seeded once per thread)
+    // select an active server that isn't excluded - requests of a session always map to the same server while it's alive. Returns -1 if none is available.
+    int select_sticky_server(const std::string &session_id, const std::vector<int> &excluded);
     void receive_heartbeat();                                  // Receive and handle heartbeat from servers
     void health_check();                                       // Check health of all servers and mark them as active or inactive based on heartbeat
+    // mark servers with expired heartbeats as down. Returns time at which the next heartbeat expires.
+    std::chrono::steady_clock::time_point refresh_active_servers();
 
     // handlers
     void client_handler(const HttpRequest &request, HttpResponse &response);
+    void proxy_handler(const HttpRequest &request, HttpResponse &response); // forward request to a front end server and stream its response back (proxy mode)
+
+    // upstream connection pool (proxy mode)
+    std::shared_ptr<UpstreamConnection> open_upstream(int port);                      // connect to front end server
+    std::shared_ptr<UpstreamConnection> acquire_upstream(int port, bool &reused);     // take idle connection to front end server from pool, or open a new one
+    void release_upstream(UpstreamConnection &upstream);                              // return connection to pool once its response has been fully read
+    std::string build_upstream_request(const HttpRequest &request, size_t body_len);  // request line + headers forwarded to front end server
+    // send request and read response head. Returns nullptr if the server failed (request_delivered is set if it failed after receiving the whole request).
+    std::shared_ptr<UpstreamConnection> forward_request(int port, const std::string &request_head, const std::vector<char> &body, bool idempotent, bool &request_delivered);
+    bool read_upstream_head(UpstreamConnection &upstream);                            // read and parse front end server's response line + headers
+    bool relay_upstream_body(UpstreamConnection &upstream, const BodyWriter &writer); // read response body from front end server and write it to client
 
     // admin console
     void lb_to_admin(int admin_port);
@@ -6,11 +6,15 @@
  *
  * The LB:
  * 1. Accepts the initial HTTP request on PORT 5000 from the client
- * 2. Receives heartbeats from FrontEnd servers on PORT 4000
+ * 2. Receives heartbeats (UDP datagrams carrying load statistics) from FrontEnd servers on PORT 4000
  * 3. Determines the best server to handle the request based on load and server availability
  * 4. Client is redirected  to the frontend server for all subsequent requests
  * 4. If there is a frontend server failure, client is redirected to the LB to be assigned a new server
  *
+ * In proxy mode, the LB instead forwards every request to a frontend server over pooled keep-alive connections and
+ * streams the response back. Requests carrying a session cookie stick to one server, and a request whose server
+ * dies before answering is retried on another server.
+ *
  */
 
 #include "../include/loadbalancer.h"
@@ -26,6 +30,24 @@ namespace LoadBalancer
     int client_listen_port;
     int server_listen_port;
 
+    bool proxy_mode = false;
+    const int max_proxy_attempts = 3;
+    const size_t max_idle_upstream_connections = 16;
+    const int upstream_timeout_s = 30;
+    std::map<int, std::vector<int>> idle_upstream_fds;
+    std::mutex upstream_pool_mutex;
+
+    const int heartbeat_timeout_ms = 2000;
+    std::mutex health_mutex;
+    std::condition_variable health_cv;
+    bool server_revived = false;
+
+    Policy balancingPolicy = Policy::RANDOM;
+    std::map<int, int> serverWeights;
+    std::map<int, int> currentWeights;
+    std::mutex weights_mutex;
+    std::map<int, std::atomic<int>> outstandingRequests;
+
     // logger
     Logger loadbalancer_logger("Load Balancer");
 
@@ -70,53 +92,97 @@ namespace LoadBalancer
         return sock;
     }
 
+    // set up UDP socket bound to specified port
+    int create_udp_socket(int port)
+    {
+        int sock = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock < 0)
+        {
+            loadbalancer_logger.log("Could not create socket", 40);
+            return -1;
+        }
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = INADDR_ANY;
+        address.sin_port = htons(port);
+
+        if (::bind(sock, (struct sockaddr *)&address, sizeof(address)) < 0)
+        {
+            loadbalancer_logger.log("Could not bind to port", 40);
+            close(sock);
+            return -1;
+        }
+        return sock;
+    }
+
     void initialize_servers(int numServers, int startingPort)
     {
         for (int i = 0; i < numServers; ++i)
         {
             int port = startingPort + i;
             loadbalancer_logger.log("Iniializing server on port " + to_string(port), 20);
-            servers[port] = ServerData{std::chrono::steady_clock::now(), false}; // Mark as dead initially
-            serverMutexes[port];                                                 // Create a corresponding mutex
+            servers[port] = ServerData{std::chrono::steady_clock::now(), false, 0, 0, 0, 0}; // Mark as dead initially
+            serverMutexes[port];                                                    // Create a corresponding mutex
+            outstandingRequests[port] = 0;                                          // No requests proxied to server yet
+            serverWeights.insert({port, 1});                                        // Servers are weighted equally unless a weight was provided at startup
+            currentWeights[port] = 0;
         }
     }
 
-    void health_check()
+    /// @brief marks servers whose heartbeat expired as down and rebuilds the list of active servers
+    /// @return time at which the next active server's heartbeat expires
+    std::chrono::steady_clock::time_point refresh_active_servers()
     {
-        while (true)
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(500)); // Periodic check every half second (double the ping frequency).
-            auto now = std::chrono::steady_clock::now();                 // Mark the current time.
-            std::vector<int> activeServersVec;                           // maintain a vector of active servers
+        auto now = std::chrono::steady_clock::now(); // Mark the current time.
+        auto next_expiry = now + std::chrono::hours(1);
+        std::vector<int> activeServersVec; // maintain a vector of active servers
 
-            for (auto &server : servers)
+        for (auto &server : servers)
+        {
+            serverMutexes.at(server.first).lock(); // Lock server for reading
+            auto &data = server.second;
+            auto expiry = data.lastHeartbeat + std::chrono::milliseconds(heartbeat_timeout_ms);
+            if (!data.isActive || expiry <= now)
             {
-                serverMutexes.at(server.first).lock(); // Lock server for reading
-                auto &data = server.second;
-                auto duration = std::chrono::duration_cast<std::chrono::seconds>(now - data.lastHeartbeat);
-                if (duration.count() > 2)
-                {
-                    data.isActive = false; // Mark server as down if no heartbeat in last 2 seconds.
-                }
-                else
-                {
-                    data.isActive = true;                     // Server is up.
-                    activeServersVec.push_back(server.first); // Add server ID to the active list.
-                }
-                serverMutexes.at(server.first).unlock(); // unlock server
+                data.isActive = false; // Mark server as down if no heartbeat within the timeout.
+            }
+            else
+            {
+                activeServersVec.push_back(server.first); // Add server ID to the active list.
+                next_expiry = std::min(next_expiry, expiry);
             }
+            serverMutexes.at(server.first).unlock(); // unlock server
+        }
+
+        // update vector of active servers with most recent active servers
+        server_mutex.lock(); // Lock active servers to replace it with updated list
+        activeServers = activeServersVec;
+        server_mutex.unlock();
+        return next_expiry;
+    }
 
-            // update vector of active servers with most recent active servers
-            server_mutex.lock(); // Lock active servers to replace it with updated list
-            activeServers = activeServersVec;
-            server_mutex.unlock();
+    /// @brief marks servers as down when their heartbeat expires
+    /// Rather than polling, the thread sleeps until the earliest heartbeat expiry, and is woken early when a server comes back up.
+    /// A heartbeat only ever pushes its server's expiry later, so waking at a stale expiry just finds nothing to do.
+    void health_check()
+    {
+        std::unique_lock<std::mutex> lock(health_mutex);
+        while (true)
+        {
+            lock.unlock();
+            auto next_expiry = refresh_active_servers();
+            lock.lock();
+            health_cv.wait_until(lock, next_expiry, []
+                                 { return server_revived; });
+            server_revived = false;
         }
     }
 
-    // listen_port: frontend server will contact with its pings
+    /// @brief receives heartbeat datagrams from front end servers on server_listen_port
     void receive_heartbeat()
     {
-        int sockfd = create_socket(server_listen_port);
+        int sockfd = create_udp_socket(server_listen_port);
         if (sockfd < 0)
         {
             loadbalancer_logger.log("Failed to create or bind socket on port " + to_string(server_listen_port), 40);
@@ -127,60 +193,143 @@ namespace LoadBalancer
 
         while (true)
         {
-            struct sockaddr_in cliaddr;
-            socklen_t len = sizeof(cliaddr);
-            int connfd = accept(sockfd, (struct sockaddr *)&cliaddr, &len);
-            if (connfd < 0)
+            char buffer[1024];
+            ssize_t n = recv(sockfd, buffer, sizeof(buffer), 0); // Read the heartbeat datagram
+            if (n <= 0)
             {
-                loadbalancer_logger.log("Failed to accept connection", 20);
-                continue; // Continue to accept the next connection
+                continue;
             }
 
-            char buffer[1024] = {0};
-            ssize_t n = read(connfd, buffer, sizeof(buffer)); // Read the heartbeat message
-            if (n > 0)
+            std::string msg(buffer, n);
+            // Expected message format: "PING<SP>PORT<SP>LOAD<SP>CONNECTIONS<SP>QUEUE_DEPTH<SP>P99_US\r\n" (load statistics are omitted by older servers)
+            if (msg.find("PING ") != 0 || msg.rfind("\r\n") != msg.size() - 2) // check if message starts with PING and ends with CRLF
             {
-                std::string msg(buffer, n);
-                // Expected message format: "PING<SP>PORT\r\n"
-                if (msg.find("PING ") == 0 && msg.rfind("\r\n") == msg.size() - 2) // check if message starts with PING and ends with CRLF
-                {
-                    std::string port_str = msg.substr(5, msg.size() - 7);
-                    int server_port = std::stoi(port_str);
-                    serverMutexes.at(server_port).lock();                                     // Lock server mutex
-                    servers.at(server_port).lastHeartbeat = std::chrono::steady_clock::now(); // Update last heartbeat time and mark as active
-                    servers.at(server_port).isActive = true;                                  // mark server as active in case it was previously dead
-                    serverMutexes.at(server_port).unlock();                                   // Unlock server mutex
-                    loadbalancer_logger.log("PING received from FE server (PORT " + port_str + ")", 20);
-                }
+                continue;
             }
-            close(connfd); // Close the connection socket
+            std::istringstream ping(msg.substr(5, msg.size() - 7));
+            int server_port = -1;
+            ServerData heartbeat = ServerData{std::chrono::steady_clock::now(), true, 0, 0, 0, 0};
+            ping >> server_port >> heartbeat.load >> heartbeat.connections >> heartbeat.queueDepth >> heartbeat.p99Micros;
+            if (servers.count(server_port) == 0)
+            {
+                loadbalancer_logger.log("PING received from unknown FE server (PORT " + to_string(server_port) + ")", 30);
+                continue;
+            }
+
+            serverMutexes.at(server_port).lock(); // Lock server mutex
+            bool was_active = servers.at(server_port).isActive;
+            servers.at(server_port) = heartbeat; // Update last heartbeat time, load statistics and mark as active
+            serverMutexes.at(server_port).unlock(); // Unlock server mutex
+
+            // server that was down is made available right away instead of at the next health check
+            if (!was_active)
+            {
+                loadbalancer_logger.log("FE server (PORT " + to_string(server_port) + ") is up", 20);
+                std::lock_guard<std::mutex> lock(health_mutex);
+                server_revived = true;
+                health_cv.notify_one();
+            }
+            LOGGER_LOG(loadbalancer_logger, LOGGER_INFO, "PING received from FE server (PORT " + to_string(server_port) + ", LOAD " + to_string(heartbeat.load) + ", QUEUE " + to_string(heartbeat.queueDepth) + ", P99 " + to_string(heartbeat.p99Micros) + "us)");
         }
     }
 
     std::string select_server()
     {
         server_mutex.lock(); // Lock active servers for thread safety
+        std::vector<int> candidates = activeServers;
+        server_mutex.unlock(); // unlock active servers
 
-        loadbalancer_logger.log("Number of active servers - " + std::to_string(activeServers.size()), LOGGER_INFO);
+        loadbalancer_logger.log("Number of active servers - " + std::to_string(candidates.size()), LOGGER_INFO);
 
         // Check if no active servers exist
-        if (activeServers.empty())
+        if (candidates.empty())
         {
-            server_mutex.unlock();
             return "No active server available";
         }
 
-        // Generate a random index
-        std::mt19937 generator(std::random_device{}());
-        std::uniform_int_distribution<> dis(0, activeServers.size() - 1);
-        int randomIndex = dis(generator);
+        // Return the port number of the selected server as a string
+        return std::to_string(pick_server(candidates));
+    }
 
-        // Retrieve the server associated with the random index
-        int server_port = activeServers.at(randomIndex);
-        server_mutex.unlock(); // unlock active servers
+    /// @brief returns the calling thread's random number generator. It's seeded once per thread, since seeding from random_device costs far more than drawing a number.
+    std::mt19937 &thread_rng()
+    {
+        static thread_local std::mt19937 generator(std::random_device{}());
+        return generator;
+    }
+
+    int server_load(int port)
+    {
+        serverMutexes.at(port).lock();
+        int load = servers.at(port).load + servers.at(port).queueDepth;
+        serverMutexes.at(port).unlock();
+        return load + outstandingRequests.at(port).load();
+    }
 
-        // Return the port number of the current server as a string
-        return std::to_string(server_port);
+    /// @brief selects one of candidates (which must not be empty) using the balancing policy
+    int pick_server(const std::vector<int> &candidates)
+    {
+        std::uniform_int_distribution<size_t> dis(0, candidates.size() - 1);
+        switch (balancingPolicy)
+        {
+        case Policy::LEAST_OUTSTANDING:
+        {
+            // scan starts at a random server so ties (e.g. every server idle) don't all go to the first server
+            size_t start = dis(thread_rng());
+            int selected_port = candidates.at(start);
+            int fewest_requests = outstandingRequests.at(selected_port).load();
+            for (size_t i = 1; i < candidates.size(); i++)
+            {
+                int server_port = candidates.at((start + i) % candidates.size());
+                int requests = outstandingRequests.at(server_port).load();
+                if (requests < fewest_requests)
+                {
+                    selected_port = server_port;
+                    fewest_requests = requests;
+                }
+            }
+            return selected_port;
+        }
+        case Policy::WEIGHTED_ROUND_ROBIN:
+        {
+            // smooth weighted round robin - every server gains its weight, the server with the highest running weight is selected and pays back the total
+            // this interleaves servers (weights 3:1 give a a b a, not a a a b)
+            std::lock_guard<std::mutex> lock(weights_mutex);
+            int total_weight = 0;
+            int selected_port = -1;
+            for (int server_port : candidates)
+            {
+                currentWeights.at(server_port) += serverWeights.at(server_port);
+                total_weight += serverWeights.at(server_port);
+                if (selected_port == -1 || currentWeights.at(server_port) > currentWeights.at(selected_port))
+                {
+                    selected_port = server_port;
+                }
+            }
+            currentWeights.at(selected_port) -= total_weight;
+            return selected_port;
+        }
+        case Policy::POWER_OF_TWO_CHOICES:
+        {
+            // comparing two random servers avoids herding every request onto the single least loaded server between heartbeats
+            if (candidates.size() == 1)
+            {
+                return candidates.front();
+            }
+            size_t first = dis(thread_rng());
+            size_t second = std::uniform_int_distribution<size_t>(0, candidates.size() - 2)(thread_rng());
+            if (second >= first)
+            {
+                second++;
+            }
+            int first_port = candidates.at(first);
+            int second_port = candidates.at(second);
+            return server_load(second_port) < server_load(first_port) ? second_port : first_port;
+        }
+        case Policy::RANDOM:
+        default:
+            return candidates.at(dis(thread_rng()));
+        }
     }
 
     void client_handler(const HttpRequest &request, HttpResponse &response)
@@ -210,6 +359,491 @@ namespace LoadBalancer
         }
     }
 
+    /// @brief selects an active server that isn't excluded. Returns -1 if no server is available.
+    /// Requests with a session id are mapped with rendezvous hashing: the session goes to the server with the highest hash of (session, port),
+    /// so a session stays on its server while that server is alive, and only the sessions of a server that dies are moved.
+    int select_sticky_server(const std::string &session_id, const std::vector<int> &excluded)
+    {
+        std::vector<int> candidates;
+        server_mutex.lock(); // Lock active servers for thread safety
+        for (int server_port : activeServers)
+        {
+            if (std::find(excluded.begin(), excluded.end(), server_port) == excluded.end())
+            {
+                candidates.push_back(server_port);
+            }
+        }
+        server_mutex.unlock(); // unlock active servers
+
+        if (candidates.empty())
+        {
+            return -1;
+        }
+
+        // client without a session can go to any server
+        if (session_id.empty())
+        {
+            return pick_server(candidates);
+        }
+
+        int selected_port = -1;
+        size_t selected_weight = 0;
+        for (int server_port : candidates)
+        {
+            size_t weight = std::hash<std::string>{}(session_id + ":" + std::to_string(server_port));
+            if (selected_port == -1 || weight > selected_weight)
+            {
+                selected_port = server_port;
+                selected_weight = weight;
+            }
+        }
+        return selected_port;
+    }
+
+    // *********************************************
+    // REVERSE PROXY
+    // *********************************************
+
+    // send len bytes to fd. Returns false if the connection failed.
+    static bool send_all_bytes(int fd, const char *data, size_t len)
+    {
+        int flags = 0;
+#ifdef MSG_NOSIGNAL
+        flags = MSG_NOSIGNAL; // a front end that died must not kill the LB with SIGPIPE
+#endif
+        size_t total_bytes_sent = 0;
+        while (total_bytes_sent < len)
+        {
+            ssize_t bytes_sent = send(fd, data + total_bytes_sent, len - total_bytes_sent, flags);
+            if (bytes_sent < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (bytes_sent <= 0)
+            {
+                return false;
+            }
+            total_bytes_sent += bytes_sent;
+        }
+        return true;
+    }
+
+    // append next bytes received from front end to upstream's buffer. Returns false if the connection closed, failed or timed out.
+    static bool recv_upstream(UpstreamConnection &upstream)
+    {
+        char buffer[16384];
+        while (true)
+        {
+            ssize_t bytes_recvd = recv(upstream.fd, buffer, sizeof(buffer), 0);
+            if (bytes_recvd < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (bytes_recvd <= 0)
+            {
+                return false;
+            }
+            upstream.buffer.append(buffer, bytes_recvd);
+            return true;
+        }
+    }
+
+    // write the next len bytes of the front end's response to client. Returns false if either connection failed.
+    static bool relay_bytes(UpstreamConnection &upstream, size_t len, const BodyWriter &writer)
+    {
+        while (len > 0)
+        {
+            if (upstream.buffer.empty() && !recv_upstream(upstream))
+            {
+                return false;
+            }
+            size_t relay_len = std::min(len, upstream.buffer.size());
+            if (!writer(upstream.buffer.data(), relay_len))
+            {
+                return false;
+            }
+            upstream.buffer.erase(0, relay_len);
+            len -= relay_len;
+        }
+        return true;
+    }
+
+    // read the next CRLF-terminated line of the front end's response (CRLF is consumed but not returned). Returns false if the connection failed.
+    static bool read_upstream_line(UpstreamConnection &upstream, std::string &line)
+    {
+        size_t line_end;
+        while ((line_end = upstream.buffer.find("\r\n")) == std::string::npos)
+        {
+            if (!recv_upstream(upstream))
+            {
+                return false;
+            }
+        }
+        line = upstream.buffer.substr(0, line_end);
+        upstream.buffer.erase(0, line_end + 2);
+        return true;
+    }
+
+    std::shared_ptr<UpstreamConnection> open_upstream(int port)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            loadbalancer_logger.log("Could not create socket for front end server", 40);
+            return nullptr;
+        }
+
+        // bound every read and write so a hung front end can't hold a client's request forever
+        struct timeval timeout;
+        timeout.tv_sec = upstream_timeout_s;
+        timeout.tv_usec = 0;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        // request head and body are sent separately, so they shouldn't wait on each other's ACKs
+        int opt = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+#ifdef SO_NOSIGPIPE
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &opt, sizeof(opt));
+#endif
+
+        struct sockaddr_in server_addr;
+        memset(&server_addr, 0, sizeof(server_addr));
+        server_addr.sin_family = AF_INET;
+        server_addr.sin_port = htons(port);
+        server_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+        if (connect(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+        {
+            loadbalancer_logger.log("Failed to connect to front end server (PORT " + to_string(port) + ")", 40);
+            close(fd);
+            return nullptr;
+        }
+        return std::make_shared<UpstreamConnection>(port, fd);
+    }
+
+    std::shared_ptr<UpstreamConnection> acquire_upstream(int port, bool &reused)
+    {
+        reused = false;
+        while (true)
+        {
+            int fd = -1;
+            upstream_pool_mutex.lock();
+            std::vector<int> &idle_fds = idle_upstream_fds[port];
+            if (!idle_fds.empty())
+            {
+                fd = idle_fds.back();
+                idle_fds.pop_back();
+            }
+            upstream_pool_mutex.unlock();
+
+            if (fd < 0)
+            {
+                return open_upstream(port);
+            }
+
+            // an idle connection should have nothing to read - EOF means the front end closed it while it sat in the pool
+            char probe;
+            if (recv(fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT) < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                reused = true;
+                return std::make_shared<UpstreamConnection>(port, fd);
+            }
+            close(fd);
+        }
+    }
+
+    void release_upstream(UpstreamConnection &upstream)
+    {
+        // connection is closed (by destructor) if the front end won't reuse it or the pool is full
+        if (!upstream.keep_alive || upstream.fd < 0)
+        {
+            return;
+        }
+        upstream_pool_mutex.lock();
+        std::vector<int> &idle_fds = idle_upstream_fds[upstream.port];
+        if (idle_fds.size() < max_idle_upstream_connections)
+        {
+            idle_fds.push_back(upstream.fd);
+            upstream.fd = -1;
+        }
+        upstream_pool_mutex.unlock();
+    }
+
+    std::string build_upstream_request(const HttpRequest &request, size_t body_len)
+    {
+        // forward the target exactly as the client sent it (query parameters are split off path when the request is parsed)
+        std::string request_head = request.method + " " + request.target + " " + request.version + "\r\n";
+        for (const auto &header : request.get_headers())
+        {
+            // hop-by-hop headers describe the client's connection to the LB, and the body is re-framed with its own Content-Length
+            const std::string &name = header.first;
+            if (name == "connection" || name == "keep-alive" || name == "transfer-encoding" || name == "content-length" ||
+                name == "te" || name == "upgrade" || name == "proxy-connection")
+            {
+                continue;
+            }
+
+            // header values were split on "," when the request was parsed
+            std::string value;
+            for (size_t i = 0; i < header.second.size(); i++)
+            {
+                value += (i == 0 ? "" : ", ") + header.second[i];
+            }
+            request_head += name + ": " + value + "\r\n";
+        }
+        if (body_len > 0 || request.method == "POST")
+        {
+            request_head += "content-length: " + to_string(body_len) + "\r\n";
+        }
+        request_head += "\r\n";
+        return request_head;
+    }
+
+    std::shared_ptr<UpstreamConnection> forward_request(int port, const std::string &request_head, const std::vector<char> &body, bool idempotent, bool &request_delivered)
+    {
+        request_delivered = false;
+        bool reused = false;
+        std::shared_ptr<UpstreamConnection> upstream = acquire_upstream(port, reused);
+        while (upstream != nullptr)
+        {
+            if (send_all_bytes(upstream->fd, request_head.data(), request_head.size()) &&
+                send_all_bytes(upstream->fd, body.data(), body.size()))
+            {
+                if (read_upstream_head(*upstream))
+                {
+                    return upstream;
+                }
+                // front end has the whole request and may have acted on it before failing to answer
+                request_delivered = true;
+            }
+
+            // front end may have closed a pooled connection just as it was taken - only a fresh connection failing means the server is down
+            // a request that isn't idempotent is never resent once delivered, since it may already have taken effect
+            if (!reused || (request_delivered && !idempotent))
+            {
+                break;
+            }
+            upstream = open_upstream(port);
+            reused = false;
+        }
+        return nullptr;
+    }
+
+    bool read_upstream_head(UpstreamConnection &upstream)
+    {
+        // response line (HTTP/1.1 200 OK)
+        std::string line;
+        if (!read_upstream_line(upstream, line))
+        {
+            return false;
+        }
+        size_t code_start = line.find(' ');
+        if (code_start == std::string::npos)
+        {
+            return false;
+        }
+        upstream.code = atoi(line.c_str() + code_start + 1);
+        upstream.keep_alive = line.compare(0, code_start, "HTTP/1.1") == 0;
+
+        // headers (up to empty line)
+        while (true)
+        {
+            if (!read_upstream_line(upstream, line))
+            {
+                return false;
+            }
+            if (line.empty())
+            {
+                break;
+            }
+            size_t colon = line.find(':');
+            if (colon == std::string::npos)
+            {
+                continue;
+            }
+            std::string name = line.substr(0, colon);
+            size_t value_start = line.find_first_not_of(' ', colon + 1);
+            std::string value = value_start == std::string::npos ? "" : line.substr(value_start);
+            upstream.headers.push_back(std::make_pair(name, value));
+
+            std::string lowercase_name = Utils::to_lowercase(name);
+            if (lowercase_name == "content-length")
+            {
+                upstream.content_length = atoll(value.c_str());
+            }
+            else if (lowercase_name == "transfer-encoding" && Utils::to_lowercase(value).find("chunked") != std::string::npos)
+            {
+                upstream.chunked = true;
+            }
+            else if (lowercase_name == "connection" && Utils::to_lowercase(value) == "close")
+            {
+                upstream.keep_alive = false;
+            }
+        }
+        return upstream.code > 0;
+    }
+
+    bool relay_upstream_body(UpstreamConnection &upstream, const BodyWriter &writer)
+    {
+        // chunked body - chunks are decoded here and the server re-chunks what it writes to the client
+        if (upstream.chunked)
+        {
+            std::string line;
+            while (true)
+            {
+                if (!read_upstream_line(upstream, line))
+                {
+                    return false;
+                }
+                size_t chunk_len = strtoul(line.c_str(), nullptr, 16); // chunk extensions after ';' are ignored
+                if (chunk_len == 0)
+                {
+                    break;
+                }
+                if (!relay_bytes(upstream, chunk_len, writer) || !read_upstream_line(upstream, line))
+                {
+                    return false;
+                }
+            }
+            // skip trailers up to the empty line that ends the body
+            while (read_upstream_line(upstream, line))
+            {
+                if (line.empty())
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        if (upstream.content_length >= 0)
+        {
+            return relay_bytes(upstream, upstream.content_length, writer);
+        }
+
+        // body ends when the front end closes the connection
+        upstream.keep_alive = false;
+        while (true)
+        {
+            if (!upstream.buffer.empty())
+            {
+                if (!writer(upstream.buffer.data(), upstream.buffer.size()))
+                {
+                    return false;
+                }
+                upstream.buffer.clear();
+            }
+            if (!recv_upstream(upstream))
+            {
+                return true;
+            }
+        }
+    }
+
+    void proxy_handler(const HttpRequest &request, HttpResponse &response)
+    {
+        // session cookie keeps a logged in client on the same front end
+        std::string session_id;
+        // browsers send every cookie in one header ("user=...; sid=..."), and header values were only split on ","
+        for (const std::string &cookies : request.get_header("cookie"))
+        {
+            for (const std::string &pair : Utils::split(cookies, ";"))
+            {
+                std::string cookie = Utils::trim(pair);
+                if (cookie.compare(0, 4, "sid=") == 0)
+                {
+                    session_id = cookie.substr(4);
+                }
+            }
+        }
+
+        std::vector<char> body = request.body_as_bytes();
+        std::string request_head = build_upstream_request(request, body.size());
+
+        // nothing has been sent to the client until a front end answers, so a request whose server died is retried on another server
+        // (unless it isn't idempotent and the failed server received all of it - e.g. a POST may have been carried out before the server died)
+        bool idempotent = request.method == "GET" || request.method == "HEAD";
+        std::vector<int> failed_servers;
+        std::shared_ptr<UpstreamConnection> upstream;
+        for (int attempt = 0; attempt < max_proxy_attempts && upstream == nullptr; attempt++)
+        {
+            int server_port = select_sticky_server(session_id, failed_servers);
+            if (server_port < 0)
+            {
+                break;
+            }
+            bool request_delivered = false;
+            upstream = forward_request(server_port, request_head, body, idempotent, request_delivered);
+            if (upstream == nullptr)
+            {
+                loadbalancer_logger.log("Front end server (PORT " + to_string(server_port) + ") failed to answer " + request.method + " " + request.path, 30);
+                failed_servers.push_back(server_port);
+                if (request_delivered && !idempotent)
+                {
+                    loadbalancer_logger.log("Not retrying " + request.method + " " + request.path + " - front end may have already carried it out", 30);
+                    break;
+                }
+            }
+        }
+
+        if (upstream == nullptr)
+        {
+            int code = failed_servers.empty() ? 503 : 502;
+            loadbalancer_logger.log(failed_servers.empty() ? "No active server available" : "No front end server answered request", 30);
+            response.set_code(code);
+            response.set_header("Content-Type", "text/html");
+            response.append_body_str(code == 503 ? "503 Service Unavailable" : "502 Bad Gateway");
+            return;
+        }
+
+        try
+        {
+            response.set_code(upstream->code);
+        }
+        catch (const std::out_of_range &)
+        {
+            loadbalancer_logger.log("Front end server responded with unsupported code " + to_string(upstream->code), 40);
+            response.set_code(502);
+            response.append_body_str("502 Bad Gateway");
+            return;
+        }
+
+        for (const auto &header : upstream->headers)
+        {
+            // framing and connection headers are set by the LB's own server for its connection to the client
+            std::string name = Utils::to_lowercase(header.first);
+            if (name == "connection" || name == "keep-alive" || name == "transfer-encoding" || name == "content-length" || name == "server")
+            {
+                continue;
+            }
+            response.set_header(header.first, header.second);
+        }
+
+        // responses without a body are complete once their head is read
+        if (request.method == "HEAD" || upstream->code == 304 || upstream->code < 200)
+        {
+            release_upstream(*upstream);
+            // keep front end's Content-Length for HEAD (an empty streamed body stops the server from replacing it)
+            if (request.method == "HEAD" && upstream->content_length >= 0)
+            {
+                response.set_header("Content-Length", to_string(upstream->content_length));
+                response.stream_body([](const BodyWriter &) {});
+            }
+            return;
+        }
+
+        // body is streamed to the client as it arrives from the front end
+        if (upstream->content_length >= 0)
+        {
+            response.set_header("Content-Length", to_string(upstream->content_length));
+        }
+        response.stream_body([upstream](const BodyWriter &writer)
+                             {
+                                 if (relay_upstream_body(*upstream, writer))
+                                 {
+                                     release_upstream(*upstream);
+                                 } });
+    }
+
     //TO DO: change server map to ordered map on Key {8000 : ..., 8001 : ..., .... : ....}
     void lb_to_admin(int admin_port)
     {
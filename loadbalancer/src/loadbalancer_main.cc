@@ -3,13 +3,61 @@
 // main method that run load balancer
 int main(int argc, char **argv)
 {
-    if (argc < 2)
+    const std::string usage = std::string("Usage: ") + argv[0] + " [-x] [-P random|least|wrr|p2c] [-W <port>:<weight>,...] <number_of_servers>";
+
+    int opt;
+    while ((opt = getopt(argc, argv, "xP:W:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'x':
+            LoadBalancer::proxy_mode = true; // forward requests to front end servers instead of redirecting clients
+            break;
+        case 'P':
+        {
+            // balancing policy
+            std::string policy = optarg;
+            if (policy == "random")
+                LoadBalancer::balancingPolicy = LoadBalancer::Policy::RANDOM;
+            else if (policy == "least")
+                LoadBalancer::balancingPolicy = LoadBalancer::Policy::LEAST_OUTSTANDING;
+            else if (policy == "wrr")
+                LoadBalancer::balancingPolicy = LoadBalancer::Policy::WEIGHTED_ROUND_ROBIN;
+            else if (policy == "p2c")
+                LoadBalancer::balancingPolicy = LoadBalancer::Policy::POWER_OF_TWO_CHOICES;
+            else
+            {
+                std::cerr << usage << std::endl;
+                return 1;
+            }
+            break;
+        }
+        case 'W':
+            // server weights for weighted round robin (servers not listed have a weight of 1)
+            for (const std::string &server_weight : Utils::split(optarg, ","))
+            {
+                std::vector<std::string> port_weight = Utils::split(server_weight, ":");
+                if (port_weight.size() != 2 || std::stoi(port_weight[1]) <= 0)
+                {
+                    std::cerr << usage << std::endl;
+                    return 1;
+                }
+                LoadBalancer::serverWeights[std::stoi(port_weight[0])] = std::stoi(port_weight[1]);
+            }
+            break;
+        default: // '?' is returned by getopt for unrecognized option
+            std::cerr << usage << std::endl;
+            return 1;
+        }
+    }
+
+    if (optind >= argc)
     {
-        std::cerr << "Usage: " << argv[0] << " <number_of_servers>" << std::endl;
+        std::cerr << usage << std::endl;
         return 1;
     }
 
-    int numServers = std::stoi(argv[1]);
+    int numServers = std::stoi(argv[optind]);
     int startingPort = 8000; // Default starting port
 
     // 1. Populate map of servers and server mutexes
@@ -18,7 +66,16 @@ int main(int argc, char **argv)
     LoadBalancer::lb_to_admin(8080);
 
     // 2. Register GET route to “/” using HttpServer
-    HttpServer::get("*", LoadBalancer::client_handler); // register handler
+    if (LoadBalancer::proxy_mode)
+    {
+        // every request is forwarded, so POST requests are routed through the LB as well
+        HttpServer::get("*", LoadBalancer::proxy_handler);
+        HttpServer::post("*", LoadBalancer::proxy_handler);
+    }
+    else
+    {
+        HttpServer::get("*", LoadBalancer::client_handler); // register handler
+    }
 
     LoadBalancer::client_listen_port = 7500; // Port for client connections
     LoadBalancer::server_listen_port = 4000; // Port for server heartbeats and registration
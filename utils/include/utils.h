@@ -6,6 +6,14 @@
 #include <sys/time.h>
 #include <vector>
 #include <string>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstdio>       // fwrite, snprintf
+#include <ctime>        // gmtime_r
+#include <cstdlib>      // atexit
+#include <cstring>      // memchr, memcmp
 
 // logger levels
 constexpr int LOGGER_DEBUG=10;
@@ -14,13 +22,44 @@ constexpr int LOGGER_WARN=30;
 constexpr int LOGGER_ERROR=40;
 constexpr int LOGGER_CRITICAL=50;
 
+// minimum level compiled into binaries - messages logged with LOGGER_LOG below this level are removed at compile time (e.g. -DLOGGER_COMPILE_MIN_LEVEL=30)
+#ifndef LOGGER_COMPILE_MIN_LEVEL
+#define LOGGER_COMPILE_MIN_LEVEL LOGGER_DEBUG
+#endif
+
+// log message only if level is enabled - the message expression isn't evaluated (no string is built) for filtered levels
+#define LOGGER_LOG(logger, level, message)        \
+    do                                            \
+    {                                             \
+        if (Logger::enabled(level))               \
+        {                                         \
+            (logger).log((message), (level));     \
+        }                                         \
+    } while (0)
+
 namespace Utils
 {
     // split string on all occurrences of delimiter, with repeated instances of delimiter
-    std::vector<std::string> split(std::string s, std::string delimiter);
+    std::vector<std::string> split(const std::string &s, const std::string &delimiter);
 
     // split string only on first occurrence of delimiter
-    std::vector<std::string> split_on_first_delim(std::string s, std::string delimiter);
+    std::vector<std::string> split_on_first_delim(const std::string &s, const std::string &delimiter);
+
+    // iterates over the tokens split would return, without copying them into strings
+    // each token points into s, so s must outlive the tokenizer and must not be modified while tokens are in use
+    class Tokenizer
+    {
+    public:
+        Tokenizer(const std::string &s, const std::string &delimiter);
+
+        // get next non-empty token. Returns false once every token has been returned.
+        bool next(const char *&token, size_t &token_len);
+
+    private:
+        const char *pos;       // start of unread part of string
+        const char *end;       // end of string
+        std::string delimiter; // delimiter separating tokens
+    };
 
     // trim whitespace from left side of string
     std::string l_trim(std::string s);
@@ -42,6 +81,8 @@ namespace Utils
 }
 
 // class that logs messages at various levels
+// messages are queued in a lock-free ring buffer owned by the logging thread and written to stderr in batches by a background thread
+// if a thread logs faster than messages can be written, its ring fills and further messages are dropped (and counted) rather than blocking the thread - errors are never dropped
 class Logger
 {
 // fields
@@ -49,6 +90,9 @@ public:
     // name of this logger instance
     std::string name; 
 
+    // messages below this level are discarded before they're formatted - may be changed at runtime
+    static std::atomic<int> min_level;
+
 // methods
 public:
     // logger initialized with an associated name
@@ -62,7 +106,16 @@ public:
     }  
 
     // output logging message
-    void log(std::string message, int level); 
+    void log(const std::string &message, int level); 
+
+    // checks if messages at level are logged (compile-time and runtime minimum levels)
+    static bool enabled(int level)
+    {
+        return level >= LOGGER_COMPILE_MIN_LEVEL && level >= min_level.load(std::memory_order_relaxed);
+    }
+
+    // write every message queued before the call - called automatically at exit, and after every CRITICAL message
+    static void flush();
 };
 
 #endif
\ No newline at end of file
@@ -1,53 +1,85 @@
 #include "../include/utils.h"
 
-// ! test this for something like GET   some_path HTTP/1.1 (with trailing spaces)  
-// ! maybe add a method for single delimiter split and repeat delimiter
-std::vector<std::string> Utils::split(std::string s, std::string delimiter) 
+// locate the first occurrence of delimiter in [begin, end) - returns end if there is none
+// memchr finds candidates for the delimiter's first byte a word at a time, so single character delimiters are never compared byte by byte
+static const char *find_delimiter(const char *begin, const char *end, const std::string &delimiter)
 {
-    std::vector<std::string> lines;
-    size_t pos = 0;
-    std::string line;
+    size_t delim_len = delimiter.length();
+    if (delim_len == 0) {
+        return end;
+    }
+    while (static_cast<size_t>(end - begin) >= delim_len) {
+        const char *candidate = static_cast<const char *>(std::memchr(begin, delimiter[0], end - begin - delim_len + 1));
+        if (candidate == nullptr) {
+            return end;
+        }
+        if (std::memcmp(candidate + 1, delimiter.data() + 1, delim_len - 1) == 0) {
+            return candidate;
+        }
+        begin = candidate + 1;
+    }
+    return end;
+}
+
+
+Utils::Tokenizer::Tokenizer(const std::string &s, const std::string &delimiter)
+    : pos(s.data()), end(s.data() + s.size()), delimiter(delimiter)
+{
+}
+
+
+bool Utils::Tokenizer::next(const char *&token, size_t &token_len)
+{
+    while (pos < end) {
+        const char *delim_pos = find_delimiter(pos, end, delimiter);
+        token = pos;
+        token_len = delim_pos - pos;
+        pos = delim_pos == end ? end : delim_pos + delimiter.length();
 
-    // process lines according to delimiter 
-    while ((pos = s.find(delimiter)) != std::string::npos) {
-        line = s.substr(0, pos);
         // should handle consecutive delimiters
-        if (line.length() != 0) {
-            lines.push_back(line);
+        if (token_len != 0) {
+            return true;
         }
-        s.erase(0, pos + delimiter.length());
     }
+    return false;
+}
 
-    // Push the remaining part of the string as the last element
-    if (!s.empty()) {
-        lines.push_back(s);
-    }
 
+// scans the string once (each token is copied out as it's found, instead of erasing it from the front of the string)
+std::vector<std::string> Utils::split(const std::string &s, const std::string &delimiter) 
+{
+    std::vector<std::string> lines;
+    Tokenizer tokens(s, delimiter);
+    const char *token;
+    size_t token_len;
+    while (tokens.next(token, token_len)) {
+        lines.emplace_back(token, token_len);
+    }
     return lines;
 }
 
 
-std::vector<std::string> Utils::split_on_first_delim(std::string s, std::string delimiter) 
+std::vector<std::string> Utils::split_on_first_delim(const std::string &s, const std::string &delimiter) 
 {
     std::vector<std::string> tokens;
 
     // find position of delimiter in string
     size_t pos = s.find(delimiter);
+    size_t rest_start = 0;
     // delimiter not found in string
     if (pos != std::string::npos) {
-        std::string token = s.substr(0, pos);
-        if (!token.empty()) {
-            tokens.push_back(token);
+        if (pos != 0) {
+            tokens.push_back(s.substr(0, pos));
         }
-        // erase the portion of the string before the delimiter and the delimiter itself
-        s.erase(0, pos + delimiter.length());
+        // skip the portion of the string before the delimiter and the delimiter itself
+        rest_start = pos + delimiter.length();
     }
 
     // Push the remaining part of the string as the last element
     // if the delimiter was not found in the string, the string is just returned as the first index in the string
     // If the delimiter was at the start or end, the string will be returned with the delimiter removed
-    if (!s.empty()) {
-        tokens.push_back(s);
+    if (rest_start < s.length()) {
+        tokens.push_back(s.substr(rest_start));
     }
 
     return tokens;
@@ -113,36 +145,213 @@ std::string Utils::get_utc_time()
   return utc_time;
 }
 
-Logger::Logger(std::string name): name(name) {}
+// *********************************************
+// LOGGING BACKEND
+// *********************************************
+
+std::atomic<int> Logger::min_level(LOGGER_DEBUG);
 
-void Logger::log(std::string message, int level)
+namespace
 {
-    // set time and info
-    std::string output = "[" + Logger::name + " - " + Utils::get_utc_time() + "] ";
-    
-    // set logging severity level
-    if (level == LOGGER_DEBUG) 
+    // message waiting to be written - formatted by the writer thread, not the logging thread
+    struct LogRecord
+    {
+        struct timeval time;
+        int level;
+        std::string name;
+        std::string message;
+    };
+
+    // single-producer single-consumer ring of records - the owning thread pushes, the writer thread pops
+    struct LogRing
+    {
+        static const size_t capacity = 1024; // records per ring (power of 2)
+
+        LogRecord records[capacity];
+        std::atomic<size_t> head{0};             // next record to pop (written by writer only)
+        char head_padding[64];                   // keeps head and tail on separate cache lines (writer and owner don't invalidate each other's line)
+        std::atomic<size_t> tail{0};             // next record to push (written by owner only)
+        std::atomic<uint64_t> dropped{0};        // records dropped because the ring was full
+        bool retired = false;                    // owning thread exited - ring can be claimed by a new thread (guarded by rings lock)
+    };
+
+    // allocated once and never destroyed, since the writer thread and exiting threads may still use them while static objects are destroyed at exit
+    std::vector<LogRing *> &rings = *new std::vector<LogRing *>(); // every ring ever created (rings are reused, never freed)
+    std::mutex &rings_lock = *new std::mutex();                     // lock for rings and their retired flags (only taken when a thread first logs or exits)
+    std::mutex &drain_lock = *new std::mutex();                     // makes writer thread and flush the only consumer of rings at any time
+
+    // returns a retired ring to the pool when its owning thread exits
+    struct RingHolder
+    {
+        LogRing *ring = nullptr;
+
+        ~RingHolder()
+        {
+            if (ring != nullptr)
+            {
+                std::lock_guard<std::mutex> lock(rings_lock);
+                ring->retired = true;
+            }
+        }
+    };
+
+    void start_writer_thread();
+
+    // ring owned by calling thread (claimed or created on first use)
+    LogRing *thread_ring()
     {
-        output += "DEBUG: ";
+        static thread_local RingHolder holder;
+        if (holder.ring != nullptr)
+        {
+            return holder.ring;
+        }
+
+        static std::once_flag writer_started;
+        std::call_once(writer_started, start_writer_thread);
+
+        std::lock_guard<std::mutex> lock(rings_lock);
+        for (LogRing *ring : rings)
+        {
+            if (ring->retired)
+            {
+                ring->retired = false;
+                holder.ring = ring;
+                return ring;
+            }
+        }
+        holder.ring = new LogRing();
+        rings.push_back(holder.ring);
+        return holder.ring;
+    }
+
+    const char *level_name(int level)
+    {
+        if (level == LOGGER_DEBUG)
+            return "DEBUG";
+        else if (level == LOGGER_INFO)
+            return "INFO";
+        else if (level == LOGGER_WARN)
+            return "WARNING";
+        else if (level == LOGGER_ERROR)
+            return "ERROR";
+        return "CRITICAL";
+    }
+
+    // format record as "[name - hh:mm:ss.uuuuuu] LEVEL: message" and append it to batch
+    void format_record(const LogRecord &record, std::string &batch)
+    {
+        struct tm utc;
+        gmtime_r(&record.time.tv_sec, &utc);
+        char time_str[32];
+        snprintf(time_str, sizeof(time_str), "%02d:%02d:%02d.%06ld", utc.tm_hour, utc.tm_min, utc.tm_sec, static_cast<long>(record.time.tv_usec));
+
+        batch += "[";
+        batch += record.name;
+        batch += " - ";
+        batch += time_str;
+        batch += "] ";
+        batch += level_name(record.level);
+        batch += ": ";
+        batch += record.message;
+        batch += "\n";
+    }
+
+    // pop every queued record from every ring and write them with one write per batch. Returns number of records written.
+    size_t drain_rings()
+    {
+        std::lock_guard<std::mutex> drain(drain_lock);
+        std::vector<LogRing *> current_rings;
+        {
+            std::lock_guard<std::mutex> lock(rings_lock);
+            current_rings = rings;
+        }
+
+        std::string batch;
+        size_t records_written = 0;
+        for (LogRing *ring : current_rings)
+        {
+            size_t head = ring->head.load(std::memory_order_relaxed);
+            size_t tail = ring->tail.load(std::memory_order_acquire);
+            for (; head != tail; head++)
+            {
+                LogRecord &record = ring->records[head & (LogRing::capacity - 1)];
+                format_record(record, batch);
+                record.message.clear();
+                records_written++;
+            }
+            ring->head.store(head, std::memory_order_release);
+
+            uint64_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+            if (dropped > 0)
+            {
+                batch += "[Logger] WARNING: dropped " + std::to_string(dropped) + " messages (logging faster than they could be written)\n";
+            }
+        }
+
+        if (!batch.empty())
+        {
+            fwrite(batch.data(), 1, batch.size(), stderr);
+            fflush(stderr);
+        }
+        return records_written;
     }
-    else if (level == LOGGER_INFO) 
+
+    void start_writer_thread()
     {
-        output += "INFO: ";
+        // queued messages are written when the process exits normally
+        atexit(Logger::flush);
+        std::thread([]()
+                    {
+            while (true) {
+                // sleep only once rings are empty, so a burst is written in back-to-back batches
+                if (drain_rings() == 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                }
+            } })
+            .detach();
     }
-    else if (level == LOGGER_WARN) 
+}
+
+Logger::Logger(std::string name): name(name) {}
+
+void Logger::log(const std::string &message, int level)
+{
+    // filtered messages are discarded before any formatting
+    if (!enabled(level))
     {
-        output += "WARNING: ";
+        return;
     }
-    else if (level == LOGGER_ERROR) 
+
+    LogRing *ring = thread_ring();
+    size_t tail = ring->tail.load(std::memory_order_relaxed);
+    if (tail - ring->head.load(std::memory_order_acquire) == LogRing::capacity)
     {
-        output += "ERROR: ";
+        // ring is full - drop message rather than block the logging thread, unless it's an error (the thread then writes queued messages itself)
+        if (level < LOGGER_ERROR)
+        {
+            ring->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        flush();
     }
-    else 
+
+    LogRecord &record = ring->records[tail & (LogRing::capacity - 1)];
+    gettimeofday(&record.time, NULL);
+    record.level = level;
+    record.name = name;
+    record.message = message;
+    ring->tail.store(tail + 1, std::memory_order_release);
+
+    // critical messages are written before returning in case the process is about to die
+    if (level >= LOGGER_CRITICAL)
     {
-        output += "CRITICAL: ";
+        flush();
     }
+}
 
-    // add logging message and output log message
-    output += message;
-    std::cerr << output << std::endl;
-}
\ No newline at end of file
+void Logger::flush()
+{
+    // one pass is enough - each ring is drained up to the tail it had when the pass reached it, which covers every message queued before
+    // flush was called. Looping until the rings are empty could livelock while other threads keep logging.
+    drain_rings();
+}